@@ -0,0 +1,309 @@
+/*
+ * File: microbench.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Google Benchmark suite for message, clock, store and queue hot paths
+*/
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/message.hpp"
+#include "../src/kv_store.hpp"
+#include "../src/lamport.hpp"
+#include "../src/hlc.hpp"
+#include "../src/network.hpp"
+
+// Heap allocations made by the current thread; every benchmark reports the
+// count per iteration as allocs_per_op
+static thread_local uint64_t thread_allocs = 0;
+
+void* operator new(size_t size)
+{
+    ++thread_allocs;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+// The replaced operator new allocates with malloc, so free() is the match
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+#pragma GCC diagnostic pop
+
+class AllocCounter
+{
+public:
+    AllocCounter() : start_(thread_allocs) {}
+
+    void report(benchmark::State& state) const
+    {
+        state.counters["allocs_per_op"] = benchmark::Counter(static_cast<double>(thread_allocs - start_),
+                                                             benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    uint64_t start_;
+};
+
+static Message make_put(size_t value_size, size_t entries = 0)
+{
+    Message msg;
+    msg.type = MessageType::MULTICAST_OP;
+    msg.op = entries ? MessageType::MULTI_PUT_REQUEST : MessageType::PUT_REQUEST;
+    msg.key = "user000000000042";
+    msg.value = std::string(value_size, 'v');
+    msg.timestamp = HybridLogicalClock::make(1746000000000ULL, 7);
+    msg.client_id = "client1";
+    msg.replica_id = "A";
+    msg.op_id = "A:" + std::to_string(msg.timestamp);
+    msg.seq = 1746000000000000ULL;
+    for (size_t i = 0; i < entries; ++i)
+    {
+        msg.entries.emplace_back("user" + std::to_string(1000000 + i), std::string(value_size, 'e'));
+    }
+    return msg;
+}
+
+static std::string key_name(uint64_t i)
+{
+    return "user" + std::to_string(1000000000 + i);
+}
+
+// ---- Message ----
+
+static void BM_MessageSerialize(benchmark::State& state)
+{
+    Message msg = make_put(state.range(0), state.range(1));
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        std::string wire = msg.serialize();
+        benchmark::DoNotOptimize(wire);
+    }
+    allocs.report(state);
+    state.SetBytesProcessed(state.iterations() * msg.serialize().size());
+}
+BENCHMARK(BM_MessageSerialize)->ArgNames({"value", "entries"})
+    ->Args({16, 0})->Args({256, 0})->Args({4096, 0})->Args({64, 16});
+
+static void BM_MessageDeserialize(benchmark::State& state)
+{
+    std::string wire = make_put(state.range(0), state.range(1)).serialize();
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        Message msg = Message::deserialize(wire);
+        benchmark::DoNotOptimize(msg);
+    }
+    allocs.report(state);
+    state.SetBytesProcessed(state.iterations() * wire.size());
+}
+BENCHMARK(BM_MessageDeserialize)->ArgNames({"value", "entries"})
+    ->Args({16, 0})->Args({256, 0})->Args({4096, 0})->Args({64, 16});
+
+// ---- KVStore ----
+
+// Fill a store with table_size committed keys
+static void populate(KVStore& store, uint64_t table_size, size_t value_size)
+{
+    Message msg = make_put(value_size);
+    for (uint64_t i = 0; i < table_size; ++i)
+    {
+        msg.key = key_name(i);
+        msg.op_id = "load:" + std::to_string(i);
+        msg.timestamp = i + 1;
+        store.apply(msg);
+        store.commit(msg.op_id);
+    }
+}
+
+// One replicated PUT: apply (pending) then commit, as every replica does
+static void BM_KVStoreApplyCommit(benchmark::State& state)
+{
+    const uint64_t table_size = state.range(0);
+    const size_t value_size = state.range(1);
+    KVStore store;
+    populate(store, table_size, value_size);
+    // Pre-built ops over existing keys; committed op_ids can be reused
+    std::mt19937_64 rng(1);
+    std::vector<Message> ops(4096, make_put(value_size));
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        ops[i].key = key_name(rng() % table_size);
+        ops[i].op_id = "A:" + std::to_string(i);
+    }
+    size_t i = 0;
+    uint64_t ts = table_size + 1;
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        Message& op = ops[i++ & (ops.size() - 1)];
+        op.timestamp = ts++;
+        store.apply(op);
+        OpResult result = store.commit(op.op_id);
+        benchmark::DoNotOptimize(result);
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_KVStoreApplyCommit)->ArgNames({"keys", "value"})
+    ->Args({1 << 10, 16})->Args({1 << 10, 1024})->Args({1 << 17, 16})->Args({1 << 17, 1024});
+
+static void BM_KVStoreGet(benchmark::State& state)
+{
+    const uint64_t table_size = state.range(0);
+    KVStore store;
+    populate(store, table_size, state.range(1));
+    std::mt19937_64 rng(1);
+    std::vector<std::string> keys(4096);
+    for (auto& key : keys)
+    {
+        key = key_name(rng() % table_size);
+    }
+    size_t i = 0;
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        std::string value = store.get(keys[i++ & (keys.size() - 1)]);
+        benchmark::DoNotOptimize(value);
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_KVStoreGet)->ArgNames({"keys", "value"})
+    ->Args({1 << 10, 16})->Args({1 << 10, 1024})->Args({1 << 17, 16})->Args({1 << 17, 1024});
+
+// ---- Clocks ----
+
+// Contended tick()/update() on one shared clock
+template <typename Clock>
+static void BM_ClockTickUpdate(benchmark::State& state)
+{
+    static Clock clock;
+    uint64_t received = 0;
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        received = clock.tick();
+        benchmark::DoNotOptimize(clock.update(received));
+    }
+    allocs.report(state);
+}
+BENCHMARK_TEMPLATE(BM_ClockTickUpdate, LamportClock)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ClockTickUpdate, HybridLogicalClock)->ThreadRange(1, 8)->UseRealTime();
+
+// ---- Network queue ----
+
+// Node listening on loopback for the queue benchmarks; sends go to itself
+static std::string loopback_addr()
+{
+    static std::string addr = []
+    {
+        const char* path = "/tmp/kv_microbench_config.txt";
+        std::ofstream(path) << "bench 127.0.0.1 5098\n";
+        std::vector<std::string> peers;
+        int port;
+        network::init("bench", path, peers, port);
+        std::remove(path);
+        return network::get_addr("bench");
+    }();
+    return addr;
+}
+
+// send_message -> socket -> listener parse -> inbound queue -> receive_message,
+// with batch messages queued before the receiver drains them. Only the
+// calling thread's allocations count; the listener thread's parse is not.
+static void BM_NetworkLoopback(benchmark::State& state)
+{
+    std::string addr = loopback_addr();
+    const int batch = state.range(0);
+    Message msg = make_put(state.range(1));
+    Message in;
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        for (int i = 0; i < batch; ++i)
+        {
+            network::send_message(addr, msg);
+        }
+        for (int i = 0; i < batch; ++i)
+        {
+            if (!network::receive_message(in, /*timeout_ms=*/1000))
+            {
+                state.SkipWithError("message lost on loopback");
+                return;
+            }
+        }
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_NetworkLoopback)->ArgNames({"batch", "value"})->Args({1, 64})->Args({64, 64})->Args({64, 1024});
+
+// As BM_NetworkLoopback, with each burst of sends inside a send batch, so
+// it leaves in one scatter-gather write instead of one write per message
+static void BM_NetworkLoopbackCoalesced(benchmark::State& state)
+{
+    std::string addr = loopback_addr();
+    const int batch = state.range(0);
+    Message msg = make_put(state.range(1));
+    Message in;
+    AllocCounter allocs;
+    for (auto _ : state)
+    {
+        network::begin_batch();
+        for (int i = 0; i < batch; ++i)
+        {
+            network::send_message(addr, msg);
+        }
+        network::end_batch();
+        for (int i = 0; i < batch; ++i)
+        {
+            if (!network::receive_message(in, /*timeout_ms=*/1000))
+            {
+                state.SkipWithError("message lost on loopback");
+                return;
+            }
+        }
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_NetworkLoopbackCoalesced)->ArgNames({"batch", "value"})->Args({64, 64})->Args({64, 1024});
+
+int main(int argc, char** argv)
+{
+    // --io-backend=epoll|io_uring picks the listener of BM_NetworkLoopback
+    int kept = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        network::IoBackend backend;
+        if (arg.rfind("--io-backend=", 0) == 0 && network::parse_io_backend(arg.substr(13), backend))
+        {
+            network::set_io_backend(backend);
+            continue;
+        }
+        argv[kept++] = argv[i];
+    }
+    argc = kept;
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    network::shutdown();
+    return 0;
+}
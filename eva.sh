@@ -7,9 +7,12 @@ set -euo pipefail
 CONFIG="client_config.txt"
 CLIENT="./client"
 NODE="./node"
+BENCH="./kvbench"
 LOGDIR="logs"
 BENCHDIR="benchmarks"
 OPS=1000                # for the micro‐benchmark
+WORKLOAD=A              # YCSB workload for kvbench (A-F)
+INFLIGHT=8              # outstanding ops per kvbench thread
 NODES=(A B C)           # replica IDs
 
 # ---------------------------------------
@@ -97,12 +100,11 @@ done
 sleep 1
 
 # ---------------------------------------
-# 4) Micro‐Benchmarking PUT throughput
+# 4) Micro‐Benchmarking with kvbench (YCSB workload)
 # ---------------------------------------
-echo -e "\n=== MICRO‐BENCHMARK: $OPS PUTs ==="
-echo "mode,ops,total_us,throughput_ops_per_sec" >"$BENCHDIR/put_throughput.csv"
+echo -e "\n=== MICRO‐BENCHMARK: $OPS ops, YCSB workload $WORKLOAD ==="
 
-bench_puts(){
+bench_kv(){
   local mode=$1 down=$2
   if [ -n "$down" ]; then
     echo "--- Killing $down for failure benchmark ---"
@@ -110,32 +112,23 @@ bench_puts(){
     sleep 1
   fi
 
-  echo "--- Mode: $mode; sending $OPS PUTs ---"
-  cmds=""
-  for i in $(seq 1 $OPS); do
-    cmds+="put k$i v$i"$'\n'
-  done
-  cmds+="exit"$'\n'
-
-  start=$(date +%s%6N)
-  printf "%s" "$cmds" | $CLIENT client1 "$CONFIG" >/dev/null 2>&1
-  end=$(date +%s%6N)
-
-  dtus=$(( end - start ))
-  throughput=$(awk -v ops=$OPS -v dt=$dtus 'BEGIN{ printf "%.2f", ops/(dt/1e6) }')
-  echo "  $mode: ${dtus}µs, ${throughput} ops/s"
-  echo "$mode,$OPS,$dtus,$throughput" >>"$BENCHDIR/put_throughput.csv"
+  echo "--- Mode: $mode; running kvbench ---"
+  $BENCH client1 "$CONFIG" --workload="$WORKLOAD" --ops="$OPS" --inflight="$INFLIGHT" \
+    --label="$mode" --format=csv --out="$BENCHDIR/kvbench_${mode}.csv" \
+    --hist-prefix="$BENCHDIR/kvbench_${mode}" 2>>"$LOGDIR/kvbench.log"
+  column -s, -t <"$BENCHDIR/kvbench_${mode}.csv" 2>/dev/null || cat "$BENCHDIR/kvbench_${mode}.csv"
 }
 
-bench_puts "healthy" ""
-bench_puts "one-down" "B"
+bench_kv "healthy" ""
+bench_kv "one-down" "B"
 
 # ---------------------------------------
 # 5) Final Results
 # ---------------------------------------
 echo -e "\n=== RESULTS ==="
 echo "Logs directory:       $LOGDIR/"
-echo "Benchmark CSV file:   $BENCHDIR/put_throughput.csv"
+echo "Benchmark CSV files:  $BENCHDIR/kvbench_{healthy,one-down}.csv"
+echo "Latency histograms:   $BENCHDIR/kvbench_{healthy,one-down}.<OP>.hgrm (merge with $BENCH --merge)"
 
 # Exit non-zero if any smoke-test failed
 exit $(( total_count - pass_count ))
@@ -0,0 +1,124 @@
+#include "admin_server.hpp"
+#include <sstream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+namespace admin
+{
+    static const MetricsRegistry* metrics = nullptr;
+    static int listen_sock = -1;
+    static int wake_pipe[2] = {-1, -1};
+    static std::thread server_thread;
+
+    // Read the request head (bounded, with a short timeout so a stalled
+    // scraper cannot hold the listener) and return its request line
+    static std::string read_request_line(int fd)
+    {
+        std::string head;
+        char buf[1024];
+        while (head.find("\r\n\r\n") == std::string::npos && head.size() < 8192)
+        {
+            pollfd p{fd, POLLIN, 0};
+            if (poll(&p, 1, 1000) <= 0) break;
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) break;
+            head.append(buf, n);
+        }
+        return head.substr(0, head.find("\r\n"));
+    }
+
+    static void respond(int fd, const std::string& status, const std::string& type, const std::string& body)
+    {
+        std::ostringstream out;
+        out << "HTTP/1.1 " << status << "\r\n"
+            << "Content-Type: " << type << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n\r\n"
+            << body;
+        std::string data = out.str();
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return;
+            sent += n;
+        }
+    }
+
+    // One connection at a time: scrapes are rare and small
+    static void serve_loop()
+    {
+        while (true)
+        {
+            pollfd fds[2] = {{listen_sock, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR) continue;
+                perror("poll");
+                return;
+            }
+            if (fds[1].revents) return; // stop requested
+            int fd = accept(listen_sock, nullptr, nullptr);
+            if (fd < 0) continue;
+            std::string line = read_request_line(fd);
+            if (line.rfind("GET /metrics", 0) == 0)
+            {
+                std::ostringstream body;
+                metrics->write_prometheus(body);
+                respond(fd, "200 OK", "text/plain; version=0.0.4", body.str());
+            }
+            else
+            {
+                respond(fd, "404 Not Found", "text/plain", "try /metrics\n");
+            }
+            close(fd);
+        }
+    }
+
+    bool start(int port, const MetricsRegistry& registry)
+    {
+        metrics = &registry;
+        listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_sock < 0)
+        {
+            perror("socket");
+            return false;
+        }
+        int opt = 1;
+        setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+        if (bind(listen_sock, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_sock, 16) < 0
+            || pipe(wake_pipe) < 0)
+        {
+            perror("admin listener");
+            close(listen_sock);
+            listen_sock = -1;
+            return false;
+        }
+        server_thread = std::thread(serve_loop);
+        return true;
+    }
+
+    void stop()
+    {
+        if (wake_pipe[1] >= 0 && write(wake_pipe[1], "x", 1) < 0) perror("write");
+        if (server_thread.joinable()) server_thread.join();
+        if (listen_sock >= 0) close(listen_sock);
+        for (int& fd : wake_pipe)
+        {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+        listen_sock = -1;
+    }
+} // namespace admin
@@ -0,0 +1,26 @@
+// admin_server.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef ADMIN_SERVER_HPP
+#define ADMIN_SERVER_HPP
+
+#include "metrics.hpp"
+
+// Minimal HTTP listener for operators: serves GET /metrics in Prometheus
+// text format from its own thread, so scrapes only read metric atomics and
+// never enter the replica's main loop
+namespace admin
+{
+    /**
+     * Start serving the registry on 0.0.0.0:port (returns false if the port
+     * cannot be bound). The registry must outlive stop().
+     */
+    bool start(int port, const MetricsRegistry& registry);
+
+    /**
+     * Stop the listener thread and close its socket.
+     */
+    void stop();
+} // namespace admin
+
+#endif // ADMIN_SERVER_HPP
@@ -12,12 +12,9 @@
 #include <vector>
 #include <csignal>
 #include <cstdint>
-#include "message.hpp"
-#include "network.hpp"
+#include "kv_client.hpp"
 
 static bool running = true;
-static uint64_t get_counter = 0;
-static uint64_t put_counter = 0;
 
 void handle_sigint(int) { running = false; }
 
@@ -31,13 +28,16 @@ int main(int argc, char* argv[])
     std::string client_id = argv[1];
     std::string config_file = argv[2];
 
-    // Bind client listener and load all replica addresses
-    std::vector<std::string> peers;
-    int listen_port;
-    network::init(client_id, config_file, peers, listen_port);
+    // Bind client listener and load all replica addresses; requests fail
+    // over between replicas and retries are deduplicated by the replicas
+    KVClient kv(client_id, config_file);
 
     std::signal(SIGINT, handle_sigint);
-    std::cout << "Commands: put <key> <value> | get <key> | exit\n";
+    std::cout << "Commands: put <key> <value> | get <key> | "
+        "mput <key> <value> [<key> <value> ...] | mget <key> [<key> ...] | "
+        "cas <key> <expected> <value> | casv <key> <version> <value> | "
+        "incr <key> [delta] | append <key> <suffix> | "
+        "sget <key> <max_staleness_ms> [min_ts] | watch <key> | watchp <prefix> | exit\n";
 
     while (running)
     {
@@ -60,90 +60,150 @@ int main(int argc, char* argv[])
                 std::cerr << "Usage: put <key> <value>\n";
                 continue;
             }
-
-            // Construct the PUT request
-            Message msg;
-            msg.type = MessageType::PUT_REQUEST;
-            msg.key = key;
-            msg.value = value;
-            msg.client_id = client_id;
-            msg.op_id = client_id + ":" + std::to_string(++put_counter);
-
-            // Sequential fail-over: try one replica at a time
-            bool sent = false;
-            for (auto& peer : peers)
+            if (!kv.async_put(key, value).get().answered)
+            {
+                std::cerr << "PUT failed: no live replicas\n";
+                continue;
+            }
+            std::cout << "PUT request broadcast: (" << key << ", " << value << ")\n";
+        }
+        else if (cmd == "get" || cmd == "sget")
+        {
+            // ---- GET branch; sget lets any replica within the bound serve it ----
+            std::string key;
+            uint64_t max_staleness_ms = 0, min_ts = 0;
+            iss >> key;
+            if (cmd == "sget" && !(iss >> max_staleness_ms))
             {
-                if (network::send_message(peer, msg))
-                {
-                    std::cout << "PUT request broadcast: (" << key << ", " << value << ")\n";
-                    sent = true;
-                    break;
-                }
-                // on connect failure, try next peer
+                key.clear();
             }
-            if (!sent)
+            iss >> min_ts; // optional; bounded reads default to read-your-writes
+            if (key.empty())
             {
-                std::cerr << "PUT failed: no live replicas\n";
+                std::cerr << (cmd == "get" ? "Usage: get <key>\n"
+                                           : "Usage: sget <key> <max_staleness_ms> [min_ts]\n");
                 continue;
             }
-
-            // Wait for exactly one COMMIT for our op_id
-            while (running)
+            KVResult r = kv.async_get(key, max_staleness_ms, min_ts).get();
+            if (!r.answered)
             {
-                Message resp;
-                if (network::receive_message(resp, /*timeout_ms=*/5000)
-                    && resp.type == MessageType::COMMIT
-                    && resp.op_id == msg.op_id)
-                {
-                    break;
-                }
+                std::cerr << "GET failed: no live replicas\n";
+                continue;
             }
+            if (!r.ok)
+            {
+                std::cerr << "GET failed: no replica within bound\n";
+                continue;
+            }
+            std::cout << "GET response: " << r.value << "\n";
         }
-        else if (cmd == "get")
+        else if (cmd == "mput")
         {
-            // ---- GET branch ----
+            // ---- MULTI_PUT branch: all pairs in one frame, committed as a unit ----
+            std::vector<std::pair<std::string, std::string>> entries;
+            std::string key, value;
+            while (iss >> key >> value)
+            {
+                entries.emplace_back(key, value);
+            }
+            if (entries.empty())
+            {
+                std::cerr << "Usage: mput <key> <value> [<key> <value> ...]\n";
+                continue;
+            }
+            KVResult r = kv.async_multi_put(entries).get();
+            if (!r.answered)
+            {
+                std::cerr << "MPUT failed: no live replicas\n";
+                continue;
+            }
+            if (!r.error.empty())
+            {
+                std::cerr << "MPUT refused: " << r.error << "\n";
+                continue;
+            }
+            std::cout << "MPUT request broadcast: " << entries.size() << " keys\n";
+        }
+        else if (cmd == "mget")
+        {
+            // ---- MULTI_GET branch: one round trip for every key ----
+            std::vector<std::string> keys;
             std::string key;
-            iss >> key;
-            if (key.empty())
+            while (iss >> key)
+            {
+                keys.push_back(key);
+            }
+            if (keys.empty())
             {
-                std::cerr << "Usage: get <key>\n";
+                std::cerr << "Usage: mget <key> [<key> ...]\n";
                 continue;
             }
-            // Construct the GET request
-            Message msg;
-            msg.type = MessageType::GET_REQUEST;
-            msg.key = key;
-            msg.client_id = client_id;
-            msg.op_id = client_id + ":" + std::to_string(++get_counter);
-
-            // Sequential fail-over: one replica at a time
-            bool sent = false;
-            for (auto& peer : peers)
+            KVResult r = kv.async_multi_get(keys).get();
+            if (!r.answered)
             {
-                if (network::send_message(peer, msg))
-                {
-                    sent = true;
-                    break;
-                }
+                std::cerr << "MGET failed: no live replicas\n";
+                continue;
             }
-            if (!sent)
+            for (const auto& [k, v] : r.entries)
             {
-                std::cerr << "GET failed: no live replicas\n";
+                std::cout << "MGET response: " << k << " = " << v << "\n";
+            }
+        }
+        else if (cmd == "cas" || cmd == "casv" || cmd == "incr" || cmd == "append")
+        {
+            // ---- Read-modify-write branch: evaluated at the replica in one round trip ----
+            std::string key, expected, value;
+            uint64_t version = 0;
+            std::future<KVResult> fut;
+            if (cmd == "cas" && iss >> key >> expected >> value)
+            {
+                fut = kv.async_cas(key, expected, value);
+            }
+            else if (cmd == "casv" && iss >> key >> version >> value)
+            {
+                fut = kv.async_cas_version(key, version, value);
+            }
+            else if (cmd == "incr" && iss >> key)
+            {
+                int64_t delta = 1;
+                iss >> delta;
+                fut = kv.async_incr(key, delta);
+            }
+            else if (cmd == "append" && iss >> key >> value)
+            {
+                fut = kv.async_append(key, value);
+            }
+            if (!fut.valid())
+            {
+                std::cerr << "Usage: cas <key> <expected> <value> | casv <key> <version> <value> | "
+                    "incr <key> [delta] | append <key> <suffix>\n";
                 continue;
             }
-
-            // Wait for exactly one GET_RESPONSE for our op_id
-            while (running)
-            {
-                Message resp;
-                if (network::receive_message(resp, /*timeout_ms=*/5000)
-                    && resp.type == MessageType::GET_RESPONSE
-                    && resp.op_id == msg.op_id)
-                {
-                    std::cout << "GET response: " << resp.value << "\n";
-                    break;
-                }
+            KVResult r = fut.get();
+            if (!r.answered)
+            {
+                std::cerr << "Request failed: no live replicas\n";
+                continue;
             }
+            std::cout << (r.ok ? "Committed: " : "Rejected: ") << r.key << " = "
+                << r.value << " (version " << r.version << ")\n";
+        }
+        else if (cmd == "watch" || cmd == "watchp")
+        {
+            // ---- Watch branch: changes are printed as they commit ----
+            std::string key;
+            if (!(iss >> key) && cmd == "watch")
+            {
+                std::cerr << "Usage: watch <key> | watchp <prefix>\n";
+                continue;
+            }
+            auto print = [](const KVResult& r)
+            {
+                std::cout << "\nWATCH: " << r.key << " = " << r.value << " (version " << r.version << ")\n";
+            };
+            if (cmd == "watch") kv.watch(key, print);
+            else kv.watch_prefix(key, print);
+            std::cout << "Watching " << (cmd == "watch" ? "key " : "prefix ") << "'" << key << "'\n";
         }
         else if (cmd == "exit")
         {
@@ -155,7 +215,7 @@ int main(int argc, char* argv[])
         }
     }
 
-    network::shutdown();
+    kv.shutdown();
     std::cout << "Client shutting down.\n";
     return 0;
 }
@@ -0,0 +1,124 @@
+#include "failure_detector.hpp"
+#include <algorithm>
+#include <cmath>
+
+FailureDetector::FailureDetector(const std::vector<std::string>& peers, Options options)
+    : options_(options), peers_(peers)
+{
+    for (const auto& peer : peers_)
+    {
+        table_[peer] = std::make_unique<Peer>();
+    }
+}
+
+FailureDetector::Peer* FailureDetector::find(const std::string& peer) const
+{
+    auto it = table_.find(peer);
+    return it == table_.end() ? nullptr : it->second.get();
+}
+
+void FailureDetector::heard(const std::string& peer, uint64_t now_ms)
+{
+    Peer* p = find(peer);
+    if (!p) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (p->state.load(std::memory_order_relaxed) == State::DOWN)
+    {
+        // Back from the dead: the outage is not a gap to learn from
+        p->gaps.clear();
+        p->gap_sum = 0;
+    }
+    else if (p->heard_any && now_ms > p->last_ms)
+    {
+        p->gaps.push_back(now_ms - p->last_ms);
+        p->gap_sum += p->gaps.back();
+        if (p->gaps.size() > options_.window)
+        {
+            p->gap_sum -= p->gaps.front();
+            p->gaps.pop_front();
+        }
+    }
+    p->heard_any = true;
+    p->heard_ever.store(true, std::memory_order_relaxed);
+    p->failed = false;
+    p->last_ms = now_ms;
+    p->state.store(State::UP, std::memory_order_relaxed);
+}
+
+void FailureDetector::send_failed(const std::string& peer)
+{
+    Peer* p = find(peer);
+    if (!p) return;
+    std::lock_guard<std::mutex> lock(mtx_);
+    p->failed = true;
+    p->state.store(State::DOWN, std::memory_order_relaxed);
+}
+
+double FailureDetector::phi_locked(const Peer& p, uint64_t now_ms) const
+{
+    if (now_ms <= p.last_ms) return 0.0;
+    double mean = p.gaps.empty() ? options_.interval_ms : static_cast<double>(p.gap_sum) / p.gaps.size();
+    // Gaps never look more regular than the heartbeat period itself
+    mean = std::max(mean, static_cast<double>(options_.interval_ms));
+    // -log10(exp(-t / mean))
+    return (now_ms - p.last_ms) / (mean * std::log(10.0));
+}
+
+double FailureDetector::phi(const std::string& peer, uint64_t now_ms) const
+{
+    Peer* p = find(peer);
+    if (!p) return 0.0;
+    std::lock_guard<std::mutex> lock(mtx_);
+    return phi_locked(*p, now_ms);
+}
+
+std::vector<std::pair<std::string, FailureDetector::State>> FailureDetector::tick(uint64_t now_ms)
+{
+    std::vector<std::pair<std::string, State>> changed;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& peer : peers_)
+    {
+        Peer& p = *table_[peer];
+        // Peers never heard from are timed from the first tick
+        if (!started_ && !p.heard_any) p.last_ms = now_ms;
+        State next = State::DOWN;
+        if (!p.failed)
+        {
+            double phi = phi_locked(p, now_ms);
+            next = phi >= options_.down_phi ? State::DOWN : phi >= options_.suspect_phi ? State::SUSPECT : State::UP;
+        }
+        p.state.store(next, std::memory_order_relaxed);
+        if (next != p.reported)
+        {
+            p.reported = next;
+            changed.emplace_back(peer, next);
+        }
+    }
+    started_ = true;
+    return changed;
+}
+
+FailureDetector::State FailureDetector::state(const std::string& peer) const
+{
+    Peer* p = find(peer);
+    return p ? p->state.load(std::memory_order_relaxed) : State::UP;
+}
+
+bool FailureDetector::heard_from(const std::string& peer) const
+{
+    Peer* p = find(peer);
+    return p && p->heard_ever.load(std::memory_order_relaxed);
+}
+
+const char* FailureDetector::state_name(State state)
+{
+    switch (state)
+    {
+    case State::UP:
+        return "up";
+    case State::SUSPECT:
+        return "suspect";
+    default:
+        return "down";
+    }
+}
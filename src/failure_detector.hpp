@@ -0,0 +1,93 @@
+// failure_detector.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef FAILURE_DETECTOR_HPP
+#define FAILURE_DETECTOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Phi-accrual failure detector over peer heartbeats. For each peer it keeps
+// a window of heartbeat inter-arrival gaps and turns the silence since the
+// last heartbeat into phi = -log10(P(gap at least this long)), modelling
+// gaps as exponential with the window's mean. SUSPECT and DOWN are phi
+// thresholds, so how fast a peer is declared dead follows how regular its
+// heartbeats have actually been.
+//
+// A failed send is stronger evidence than silence: it marks the peer DOWN
+// at once, and only a heartbeat from it brings it back. state() is
+// lock-free and may be read from any thread; the other calls lock.
+class FailureDetector
+{
+public:
+    enum class State : uint8_t
+    {
+        UP,
+        SUSPECT, // late, but still sent to and counted
+        DOWN // skipped by write fan-out until heard from again
+    };
+
+    struct Options
+    {
+        uint64_t interval_ms = 100; // heartbeat period; assumed mean gap until measured
+        double suspect_phi = 3.0; // exponential gaps: ~7 periods of silence
+        double down_phi = 8.0; // ~18 periods
+        size_t window = 100; // gaps remembered per peer
+    };
+
+    FailureDetector(const std::vector<std::string>& peers, Options options);
+
+    // A heartbeat from peer arrived (unknown peers are ignored)
+    void heard(const std::string& peer, uint64_t now_ms);
+
+    // Sending to peer failed outright (e.g. connection refused)
+    void send_failed(const std::string& peer);
+
+    /**
+     * Re-evaluate every peer's state from its phi; call about once per
+     * interval. Returns the peers whose state changed (including changes
+     * made by heard()/send_failed() since the last tick).
+     */
+    std::vector<std::pair<std::string, State>> tick(uint64_t now_ms);
+
+    State state(const std::string& peer) const;
+
+    // Peer has sent a heartbeat at some point, so it is a replica (clients
+    // are in the peer list too, but never send heartbeats). Lock-free.
+    bool heard_from(const std::string& peer) const;
+    double phi(const std::string& peer, uint64_t now_ms) const;
+    const std::vector<std::string>& peers() const { return peers_; }
+
+    static const char* state_name(State state);
+
+private:
+    struct Peer
+    {
+        std::atomic<State> state{State::UP};
+        std::atomic<bool> heard_ever{false}; // heard_any, readable without the lock
+        State reported = State::UP; // last state returned by tick()
+        bool heard_any = false;
+        bool failed = false; // DOWN from a failed send; held until heard from
+        uint64_t last_ms = 0; // last heartbeat (or when watching began)
+        std::deque<uint64_t> gaps;
+        uint64_t gap_sum = 0;
+    };
+
+    double phi_locked(const Peer& p, uint64_t now_ms) const;
+    Peer* find(const std::string& peer) const;
+
+    Options options_;
+    std::vector<std::string> peers_;
+    std::unordered_map<std::string, std::unique_ptr<Peer>> table_; // fixed after construction
+    bool started_ = false; // first tick() seen
+    mutable std::mutex mtx_;
+};
+
+#endif // FAILURE_DETECTOR_HPP
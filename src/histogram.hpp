@@ -0,0 +1,160 @@
+/*
+ * File: histogram.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: HDR-style latency histogram
+*/
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include <limits>
+
+// Log-bucketed latency histogram in the style of HdrHistogram. Values below
+// 2^sub_bucket_bits are counted exactly; above that, every power-of-two range
+// is split into 2^(sub_bucket_bits-1) linear sub-buckets, so the relative
+// error of any reported value stays under 2^-(sub_bucket_bits-1). Recording
+// is O(1) and histograms with the same layout merge by adding counts.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : LatencyHistogram(10, uint64_t{1} << 40) {}
+
+    LatencyHistogram(int sub_bucket_bits, uint64_t max_value)
+        : bits_(sub_bucket_bits), max_value_(max_value), counts_(index_of(max_value) + 1, 0)
+    {
+    }
+
+    // Record one value (values above max_value are clamped to it)
+    void record(uint64_t value, uint64_t count = 1)
+    {
+        if (value > max_value_) value = max_value_;
+        counts_[index_of(value)] += count;
+        total_ += count;
+        sum_ += value * count;
+        if (value < min_) min_ = value;
+        if (value > max_) max_ = value;
+    }
+
+    // Add another histogram's counts; false if the layouts differ
+    bool merge(const LatencyHistogram& other)
+    {
+        if (other.bits_ != bits_ || other.max_value_ != max_value_) return false;
+        for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        sum_ += other.sum_;
+        if (other.min_ < min_) min_ = other.min_;
+        if (other.max_ > max_) max_ = other.max_;
+        return true;
+    }
+
+    void reset()
+    {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        sum_ = 0;
+        min_ = std::numeric_limits<uint64_t>::max();
+        max_ = 0;
+    }
+
+    // Smallest recorded value v such that percentile% of samples are <= v,
+    // reported as the highest value equivalent to its bucket (capped at max)
+    uint64_t percentile(double percentile) const
+    {
+        if (total_ == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(percentile / 100.0 * total_ + 0.5);
+        if (target < 1) target = 1;
+        if (target > total_) target = total_;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i)
+        {
+            seen += counts_[i];
+            if (seen >= target)
+            {
+                uint64_t v = highest_equivalent(i);
+                return (v < max_ ? v : max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const { return total_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0; }
+
+    // Text form: a header, then "<bucket index> <count>" for non-empty buckets
+    void save(std::ostream& os) const
+    {
+        os << "hist v1 " << bits_ << ' ' << max_value_ << ' ' << total_ << ' ' << sum_ << ' '
+            << min() << ' ' << max_ << '\n';
+        for (size_t i = 0; i < counts_.size(); ++i)
+        {
+            if (counts_[i]) os << i << ' ' << counts_[i] << '\n';
+        }
+    }
+
+    // Parse the form written by save(); false on malformed input
+    static bool load(std::istream& is, LatencyHistogram& out)
+    {
+        std::string magic, version;
+        int bits;
+        uint64_t max_value, total, sum, min, max;
+        if (!(is >> magic >> version >> bits >> max_value >> total >> sum >> min >> max)
+            || magic != "hist" || version != "v1" || bits < 2 || bits > 20)
+        {
+            return false;
+        }
+        LatencyHistogram h(bits, max_value);
+        size_t index;
+        uint64_t count;
+        while (is >> index >> count)
+        {
+            if (index >= h.counts_.size()) return false;
+            h.counts_[index] += count;
+        }
+        h.total_ = total;
+        h.sum_ = sum;
+        h.min_ = (total ? min : std::numeric_limits<uint64_t>::max());
+        h.max_ = max;
+        out = std::move(h);
+        return true;
+    }
+
+private:
+    size_t index_of(uint64_t v) const
+    {
+        const uint64_t sub_count = uint64_t{1} << bits_;
+        if (v < sub_count) return v;
+        const uint64_t half = sub_count >> 1;
+        int shift = (63 - __builtin_clzll(v)) - (bits_ - 1); // >= 1
+        uint64_t sub = v >> shift; // in [half, sub_count)
+        return sub_count + (shift - 1) * half + (sub - half);
+    }
+
+    uint64_t highest_equivalent(size_t index) const
+    {
+        const uint64_t sub_count = uint64_t{1} << bits_;
+        if (index < sub_count) return index;
+        const uint64_t half = sub_count >> 1;
+        uint64_t shift = (index - sub_count) / half + 1;
+        uint64_t sub = (index - sub_count) % half + half;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    int bits_;
+    uint64_t max_value_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+};
+
+#endif // HISTOGRAM_HPP
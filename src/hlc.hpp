@@ -0,0 +1,102 @@
+/*
+ * File: hlc.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Hybrid logical clock
+*/
+#ifndef HLC_HPP
+#define HLC_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Thread-safe hybrid logical clock. A timestamp packs wall-clock milliseconds
+// in the upper 48 bits and a logical counter in the lower 16 bits, so it fits
+// the existing Message::timestamp field and orders like a Lamport clock while
+// staying close to physical time. Updates are a lock-free CAS-based max.
+class HybridLogicalClock
+{
+public:
+    static constexpr int LOGICAL_BITS = 16;
+    static constexpr uint64_t LOGICAL_MASK = (uint64_t{1} << LOGICAL_BITS) - 1;
+
+    using PhysicalClock = uint64_t (*)();
+
+    explicit HybridLogicalClock(PhysicalClock physical = system_ms) : physical_(physical), state_(0)
+    {
+    }
+
+    // Get the next timestamp for a local event
+    uint64_t tick()
+    {
+        return advance(0);
+    }
+
+    // Update the clock based on a received timestamp and return the new time
+    uint64_t update(uint64_t received)
+    {
+        return advance(received);
+    }
+
+    // Peek at the current clock value
+    uint64_t read() const
+    {
+        return state_.load();
+    }
+
+    // Current physical time in milliseconds as seen by this clock
+    uint64_t physical_now() const
+    {
+        return physical_();
+    }
+
+    // Timestamp with the given physical part and logical counter
+    static constexpr uint64_t make(uint64_t ms, uint64_t logical = 0)
+    {
+        return (ms << LOGICAL_BITS) | (logical & LOGICAL_MASK);
+    }
+
+    // Physical milliseconds of a timestamp
+    static constexpr uint64_t physical_ms(uint64_t ts)
+    {
+        return ts >> LOGICAL_BITS;
+    }
+
+    // Logical counter of a timestamp
+    static constexpr uint64_t logical(uint64_t ts)
+    {
+        return ts & LOGICAL_MASK;
+    }
+
+    static uint64_t system_ms()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    // new = max(current + 1, received + 1, physical now). A logical counter
+    // overflow simply carries into the millisecond field, which keeps the
+    // clock monotonic at the cost of running briefly ahead of wall time.
+    uint64_t advance(uint64_t received)
+    {
+        uint64_t pt = make(physical_());
+        uint64_t current = state_.load();
+        uint64_t next;
+        do
+        {
+            next = current + 1;
+            if (received >= next) next = received + 1;
+            if (pt > next) next = pt;
+        }
+        while (!state_.compare_exchange_weak(current, next));
+        return next;
+    }
+
+    PhysicalClock physical_;
+    std::atomic<uint64_t> state_;
+};
+
+#endif // HLC_HPP
@@ -0,0 +1,167 @@
+#include "hot_keys.hpp"
+#include <algorithm>
+#include <atomic>
+#include "logger.hpp"
+
+void SpaceSaving::add(const std::string& key)
+{
+    ++total_;
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+        bump(it->second);
+        return;
+    }
+    if (slots_.size() < capacity_)
+    {
+        // A new smallest counter, at 0 until bumped
+        slots_.push_back(Slot{key, Counter()});
+        run_start_.emplace(0, slots_.size() - 1);
+        index_.emplace(key, slots_.size() - 1);
+        bump(slots_.size() - 1);
+        return;
+    }
+    // Take over the smallest counter, inheriting its count as error
+    size_t last = slots_.size() - 1;
+    Slot& min = slots_[last];
+    index_.erase(min.key);
+    min.key = key;
+    min.counter.error = min.counter.count;
+    index_.emplace(key, last);
+    bump(last);
+}
+
+void SpaceSaving::bump(size_t i)
+{
+    uint64_t count = slots_[i].counter.count;
+    auto run = run_start_.find(count);
+    size_t first = run->second;
+    swap_slots(i, first);
+    // first leaves its run for the end of the next larger one
+    if (first + 1 < slots_.size() && slots_[first + 1].counter.count == count) ++run->second;
+    else run_start_.erase(run);
+    ++slots_[first].counter.count;
+    run_start_.emplace(count + 1, first);
+}
+
+void SpaceSaving::swap_slots(size_t a, size_t b)
+{
+    if (a == b) return;
+    std::swap(slots_[a], slots_[b]);
+    index_[slots_[a].key] = a;
+    index_[slots_[b].key] = b;
+}
+
+std::vector<std::pair<std::string, SpaceSaving::Counter>> SpaceSaving::top(size_t n) const
+{
+    std::vector<std::pair<std::string, Counter>> out;
+    out.reserve(slots_.size());
+    for (const auto& slot : slots_) out.emplace_back(slot.key, slot.counter);
+    auto guaranteed = [](const auto& a, const auto& b)
+    {
+        return a.second.count - a.second.error > b.second.count - b.second.error;
+    };
+    n = std::min(n, out.size());
+    std::partial_sort(out.begin(), out.begin() + n, out.end(), guaranteed);
+    out.resize(n);
+    return out;
+}
+
+HotKeys::HotKeys(MetricsRegistry& registry, Options options)
+    : options_(options),
+      hot_gauge_(registry.gauge("kv_hot_keys", "Keys currently read-hot")),
+      detections_(registry.counter("kv_hot_key_detections_total", "Keys that turned read-hot"))
+{
+    for (size_t rank = 1; rank <= options_.ranks; ++rank)
+    {
+        rank_rates_.push_back(&registry.gauge("kv_top_key_reads_per_second",
+                                              "Read rate of the most read keys, by rank (names in the log)",
+                                              "rank=\"" + std::to_string(rank) + "\""));
+    }
+    for (size_t i = 0; i < std::max<size_t>(options_.stripes, 1); ++i)
+    {
+        stripes_.push_back(std::make_unique<Stripe>(options_.capacity));
+    }
+}
+
+HotKeys::Stripe& HotKeys::stripe()
+{
+    static std::atomic<size_t> threads{0};
+    thread_local size_t mine = threads.fetch_add(1);
+    return *stripes_[mine % stripes_.size()];
+}
+
+bool HotKeys::record(const std::string& key)
+{
+    Stripe& s = stripe();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    s.sketch.add(key);
+    return s.hot.count(key) > 0;
+}
+
+void HotKeys::tick(uint64_t now_ms)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    // Close every stripe's window; a key's guaranteed counts add up
+    std::unordered_map<std::string, uint64_t> reads;
+    for (auto& s : stripes_)
+    {
+        std::lock_guard<std::mutex> stripe_lock(s->mtx);
+        for (const auto& [key, counter] : s->sketch.top(options_.capacity))
+        {
+            reads[key] += counter.count - counter.error;
+        }
+        s->sketch.clear();
+    }
+    if (!started_ || now_ms <= window_start_ms_)
+    {
+        started_ = true;
+        window_start_ms_ = now_ms;
+        return;
+    }
+    double seconds = (now_ms - window_start_ms_) / 1000.0;
+    std::vector<std::pair<std::string, uint64_t>> top(reads.begin(), reads.end());
+    std::sort(top.begin(), top.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    for (size_t rank = 0; rank < rank_rates_.size(); ++rank)
+    {
+        double rate = (rank < top.size() ? top[rank].second / seconds : 0);
+        rank_rates_[rank]->set(static_cast<int64_t>(rate));
+    }
+    std::unordered_set<std::string> hot;
+    for (const auto& [key, count] : top)
+    {
+        double rate = count / seconds;
+        // Largest first: nothing after a key below the lower (cooling) bar is hot
+        if (rate < options_.hot_rate / 2.0) break;
+        bool was_hot = hot_.count(key) > 0;
+        if (!was_hot && rate < options_.hot_rate) continue;
+        hot.insert(key);
+        if (was_hot) continue;
+        detections_.inc();
+        KV_LOG(INFO, "hot_key_detected", {"key", key}, {"reads_per_s", static_cast<uint64_t>(rate)});
+    }
+    for (const auto& key : hot_)
+    {
+        if (!hot.count(key)) KV_LOG(INFO, "hot_key_cooled", {"key", key});
+    }
+    hot_.swap(hot);
+    hot_gauge_.set(static_cast<int64_t>(hot_.size()));
+    for (auto& s : stripes_)
+    {
+        std::lock_guard<std::mutex> stripe_lock(s->mtx);
+        s->hot = hot_;
+    }
+    window_start_ms_ = now_ms;
+}
+
+bool HotKeys::hot(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return hot_.count(key) > 0;
+}
+
+std::vector<std::string> HotKeys::hot_keys() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return std::vector<std::string>(hot_.begin(), hot_.end());
+}
@@ -0,0 +1,127 @@
+// hot_keys.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef HOT_KEYS_HPP
+#define HOT_KEYS_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "metrics.hpp"
+
+// Space-Saving heavy-hitters sketch: at most capacity counters; a key not
+// counted yet takes over the smallest counter and inherits its count as
+// error. Any key seen more than total/capacity times is guaranteed to hold
+// a counter, and count - error never overestimates it. Not thread-safe.
+//
+// Counters are kept sorted by count, largest first, with the first slot of
+// every count indexed: counts only ever grow by one, so add() moves a key
+// to the front of its run and the smallest counter is always the last slot.
+// Both a hit and a takeover are O(1).
+class SpaceSaving
+{
+public:
+    struct Counter
+    {
+        uint64_t count = 0;
+        uint64_t error = 0; // count may exceed the key's true count by this much
+    };
+
+    explicit SpaceSaving(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    void add(const std::string& key);
+
+    // Counted keys, largest guaranteed count (count - error) first
+    std::vector<std::pair<std::string, Counter>> top(size_t n) const;
+
+    uint64_t total() const { return total_; }
+    void clear()
+    {
+        slots_.clear();
+        index_.clear();
+        run_start_.clear();
+        total_ = 0;
+    }
+
+private:
+    struct Slot
+    {
+        std::string key;
+        Counter counter;
+    };
+
+    // Add one to the count of slots_[i], keeping the order
+    void bump(size_t i);
+    void swap_slots(size_t a, size_t b);
+
+    size_t capacity_;
+    std::vector<Slot> slots_; // by count, largest first
+    std::unordered_map<std::string, size_t> index_; // key -> its slot
+    std::unordered_map<uint64_t, size_t> run_start_; // count -> first slot holding it
+    uint64_t total_ = 0;
+};
+
+// Read-hot keys of one node. Every GET (and each key of a MULTI_GET) is
+// counted in a SpaceSaving sketch; tick() closes the window once a second
+// and marks a key hot when its guaranteed read rate over the window
+// reaches hot_rate. It stays hot until that falls below half of hot_rate,
+// so a key on the threshold does not flap. Replicas mark GET replies for
+// hot keys, and clients then cache them under a lease and spread their
+// reads over every replica.
+//
+// record() runs on the shard and reader threads. Each thread counts into a
+// stripe of its own (threads are spread over the stripes in the order they
+// first record), with its own lock and copy of the hot set, so reads on
+// different threads never contend; tick() merges the stripes' counters,
+// summing their guaranteed counts.
+class HotKeys
+{
+public:
+    struct Options
+    {
+        size_t capacity = 128; // sketch counters, per stripe
+        uint64_t hot_rate = 1000; // reads/s at which a key turns hot
+        size_t ranks = 5; // top keys exported as kv_top_key_reads_per_second
+        size_t stripes = 16; // sketches the recording threads are spread over
+    };
+
+    HotKeys(MetricsRegistry& registry, Options options);
+
+    // Count a read of key; true if key is hot as of the last tick
+    bool record(const std::string& key);
+
+    // Close the window: recompute the hot set and the gauges
+    void tick(uint64_t now_ms);
+
+    bool hot(const std::string& key) const;
+    std::vector<std::string> hot_keys() const;
+
+private:
+    struct alignas(64) Stripe
+    {
+        explicit Stripe(size_t capacity) : sketch(capacity) {}
+
+        std::mutex mtx;
+        SpaceSaving sketch;
+        std::unordered_set<std::string> hot; // as of the last tick
+    };
+
+    Stripe& stripe();
+
+    Options options_;
+    std::vector<std::unique_ptr<Stripe>> stripes_;
+    mutable std::mutex mtx_; // guards the fields below
+    std::unordered_set<std::string> hot_;
+    uint64_t window_start_ms_ = 0;
+    bool started_ = false;
+    Gauge& hot_gauge_;
+    Counter& detections_;
+    std::vector<Gauge*> rank_rates_;
+};
+
+#endif // HOT_KEYS_HPP
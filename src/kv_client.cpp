@@ -0,0 +1,641 @@
+/*
+ * File: kv_client.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Asynchronous pipelined client library
+*/
+#include "kv_client.hpp"
+#include <algorithm>
+#include <memory>
+#include "network.hpp"
+
+KVClient::KVClient(const std::string& client_id, const std::string& config_file)
+    : KVClient(client_id, config_file, Options())
+{
+}
+
+KVClient::KVClient(const std::string& client_id, const std::string& config_file, Options options)
+    : client_id_(client_id), options_(options), window_(std::max(1, options.max_in_flight)),
+      cache_(options.near_cache_capacity, options.near_cache_ttl_ms)
+{
+    // Sequence numbers must not repeat across restarts of the same client_id,
+    // or replicas would answer new writes from their dedup tables. Starting
+    // from the wall clock in microseconds keeps every incarnation ahead of
+    // the last one.
+    next_seq_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int listen_port;
+    network::init(client_id_, config_file, peers_, listen_port);
+    running_ = true;
+    dispatcher_ = std::thread(&KVClient::dispatch_loop, this);
+    writer_ = std::thread(&KVClient::writer_loop, this);
+}
+
+KVClient::~KVClient()
+{
+    shutdown();
+}
+
+void KVClient::shutdown()
+{
+    if (!running_.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        outbox_cv_.notify_all();
+    }
+    if (writer_.joinable()) writer_.join();
+    if (dispatcher_.joinable()) dispatcher_.join();
+    std::unordered_map<std::string, Pending> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        abandoned.swap(pending_);
+    }
+    for (auto& kv : abandoned) complete(kv.second, nullptr);
+    network::shutdown();
+}
+
+size_t KVClient::in_flight() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return pending_.size();
+}
+
+// ---- Watches ----
+
+uint64_t KVClient::watch(const std::string& key, Callback cb, uint64_t from_version)
+{
+    Watch w;
+    w.key = key;
+    w.cb = std::move(cb);
+    w.seen[key] = from_version;
+    return add_watch(std::move(w));
+}
+
+uint64_t KVClient::watch_prefix(const std::string& prefix, Callback cb)
+{
+    Watch w;
+    w.key = prefix;
+    w.prefix = true;
+    w.cb = std::move(cb);
+    return add_watch(std::move(w));
+}
+
+uint64_t KVClient::add_watch(Watch w)
+{
+    w.renew_at = Clock::now() + std::chrono::milliseconds(options_.watch_renew_ms);
+    std::unique_lock<std::mutex> lock(mtx_);
+    uint64_t id = ++next_watch_;
+    Message request = make_watch(MessageType::WATCH_REQUEST, w);
+    watches_.emplace(id, std::move(w));
+    lock.unlock();
+    // Not registered (no replica answered): the next renewal tries again
+    submit(std::move(request), MessageType::WATCH_RESPONSE, nullptr);
+    return id;
+}
+
+void KVClient::unwatch(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = watches_.find(id);
+    if (it == watches_.end()) return;
+    Message request = make_watch(MessageType::UNWATCH_REQUEST, it->second);
+    watches_.erase(it);
+    lock.unlock();
+    submit(std::move(request), MessageType::WATCH_RESPONSE, nullptr);
+}
+
+Message KVClient::make_watch(MessageType type, const Watch& w)
+{
+    Message msg = with_key(make_request(type, false), w.key, w.prefix ? "prefix" : "");
+    // A key watch resumes after the last version delivered; a replica new
+    // to a prefix watch sends every key again, and on_watch_event drops the
+    // versions already seen
+    if (!w.prefix) msg.version = w.seen.at(w.key);
+    return msg;
+}
+
+void KVClient::on_watch_event(const Message& event)
+{
+    KVResult r;
+    r.answered = true;
+    r.ok = true;
+    r.key = event.key;
+    r.value = event.value;
+    r.version = event.version;
+    r.timestamp = event.timestamp;
+    std::vector<Callback> targets;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto& [id, w] : watches_)
+        {
+            bool match = (w.prefix ? event.key.compare(0, w.key.size(), w.key) == 0 : event.key == w.key);
+            if (!match) continue;
+            // Duplicates (e.g. a commit racing registration) and versions
+            // older than one already delivered are dropped
+            uint64_t& seen = w.seen[event.key];
+            if (event.version <= seen) continue;
+            seen = event.version;
+            targets.push_back(w.cb);
+        }
+    }
+    for (const auto& cb : targets) cb(r);
+}
+
+void KVClient::renew_watches()
+{
+    std::vector<Message> due;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto now = Clock::now();
+        for (auto& [id, w] : watches_)
+        {
+            if (w.renew_at > now) continue;
+            w.renew_at = now + std::chrono::milliseconds(options_.watch_renew_ms);
+            due.push_back(make_watch(MessageType::WATCH_REQUEST, w));
+        }
+    }
+    for (auto& request : due) submit(std::move(request), MessageType::WATCH_RESPONSE, nullptr);
+}
+
+// ---- Request construction ----
+
+Message KVClient::make_request(MessageType type, bool is_write)
+{
+    Message msg;
+    msg.type = type;
+    msg.client_id = client_id_;
+    uint64_t seq = ++next_seq_;
+    // Writes carry seq so replicas can deduplicate retries
+    if (is_write) msg.seq = seq;
+    msg.op_id = client_id_ + ":" + std::to_string(seq);
+    return msg;
+}
+
+Message KVClient::with_key(Message msg, const std::string& key, const std::string& value)
+{
+    msg.key = key;
+    msg.value = value;
+    return msg;
+}
+
+Message KVClient::make_get(const std::string& key, uint64_t max_staleness_ms, uint64_t min_ts)
+{
+    Message msg = with_key(make_request(MessageType::GET_REQUEST, false), key, std::string());
+    msg.max_staleness_ms = max_staleness_ms;
+    // Bounded reads default to read-your-writes
+    msg.timestamp = (max_staleness_ms != 0 && min_ts == 0 ? last_commit_ts() : min_ts);
+    return msg;
+}
+
+std::future<KVResult> KVClient::async_put(const std::string& key, const std::string& value)
+{
+    return submit(with_key(make_request(MessageType::PUT_REQUEST, true), key, value), MessageType::COMMIT);
+}
+
+std::future<KVResult> KVClient::async_get(const std::string& key, uint64_t max_staleness_ms, uint64_t min_ts)
+{
+    return submit(make_get(key, max_staleness_ms, min_ts), MessageType::GET_RESPONSE);
+}
+
+std::future<KVResult> KVClient::async_multi_put(const std::vector<std::pair<std::string, std::string>>& entries)
+{
+    Message msg = make_request(MessageType::MULTI_PUT_REQUEST, true);
+    msg.entries = entries;
+    return submit(std::move(msg), MessageType::COMMIT);
+}
+
+std::future<KVResult> KVClient::async_multi_get(const std::vector<std::string>& keys)
+{
+    Message msg = make_request(MessageType::MULTI_GET_REQUEST, false);
+    for (const auto& key : keys) msg.entries.emplace_back(key, std::string());
+    return submit(std::move(msg), MessageType::MULTI_GET_RESPONSE);
+}
+
+std::future<KVResult> KVClient::async_cas(const std::string& key, const std::string& expected,
+                                          const std::string& value)
+{
+    Message msg = with_key(make_request(MessageType::CAS_REQUEST, true), key, value);
+    msg.expected = expected;
+    return submit(std::move(msg), MessageType::COMMIT);
+}
+
+std::future<KVResult> KVClient::async_cas_version(const std::string& key, uint64_t version,
+                                                  const std::string& value)
+{
+    Message msg = with_key(make_request(MessageType::CAS_REQUEST, true), key, value);
+    msg.version = version;
+    return submit(std::move(msg), MessageType::COMMIT);
+}
+
+std::future<KVResult> KVClient::async_incr(const std::string& key, int64_t delta)
+{
+    return submit(with_key(make_request(MessageType::INCR_REQUEST, true), key, std::to_string(delta)),
+                  MessageType::COMMIT);
+}
+
+std::future<KVResult> KVClient::async_append(const std::string& key, const std::string& suffix)
+{
+    return submit(with_key(make_request(MessageType::APPEND_REQUEST, true), key, suffix), MessageType::COMMIT);
+}
+
+void KVClient::async_put(const std::string& key, const std::string& value, Callback cb)
+{
+    submit(with_key(make_request(MessageType::PUT_REQUEST, true), key, value), MessageType::COMMIT, std::move(cb));
+}
+
+void KVClient::async_get(const std::string& key, Callback cb, uint64_t max_staleness_ms, uint64_t min_ts)
+{
+    submit(make_get(key, max_staleness_ms, min_ts), MessageType::GET_RESPONSE, std::move(cb));
+}
+
+void KVClient::async_multi_put(const std::vector<std::pair<std::string, std::string>>& entries, Callback cb)
+{
+    Message msg = make_request(MessageType::MULTI_PUT_REQUEST, true);
+    msg.entries = entries;
+    submit(std::move(msg), MessageType::COMMIT, std::move(cb));
+}
+
+void KVClient::async_multi_get(const std::vector<std::string>& keys, Callback cb)
+{
+    Message msg = make_request(MessageType::MULTI_GET_REQUEST, false);
+    for (const auto& key : keys) msg.entries.emplace_back(key, std::string());
+    submit(std::move(msg), MessageType::MULTI_GET_RESPONSE, std::move(cb));
+}
+
+void KVClient::async_cas(const std::string& key, const std::string& expected, const std::string& value,
+                         Callback cb)
+{
+    Message msg = with_key(make_request(MessageType::CAS_REQUEST, true), key, value);
+    msg.expected = expected;
+    submit(std::move(msg), MessageType::COMMIT, std::move(cb));
+}
+
+void KVClient::async_incr(const std::string& key, int64_t delta, Callback cb)
+{
+    submit(with_key(make_request(MessageType::INCR_REQUEST, true), key, std::to_string(delta)),
+           MessageType::COMMIT, std::move(cb));
+}
+
+void KVClient::async_append(const std::string& key, const std::string& suffix, Callback cb)
+{
+    submit(with_key(make_request(MessageType::APPEND_REQUEST, true), key, suffix), MessageType::COMMIT,
+           std::move(cb));
+}
+
+// ---- Submission and dispatch ----
+
+std::future<KVResult> KVClient::submit(Message msg, MessageType expect)
+{
+    auto promise = std::make_shared<std::promise<KVResult>>();
+    std::future<KVResult> fut = promise->get_future();
+    submit(std::move(msg), expect, [promise](const KVResult& r) { promise->set_value(r); });
+    return fut;
+}
+
+void KVClient::submit(Message msg, MessageType expect, Callback cb)
+{
+    if ((options_.near_cache || options_.hot_keys) && through_cache(msg, cb)) return;
+    Pending p;
+    p.expect = expect;
+    p.cb = std::move(cb);
+    p.bounded = (msg.type == MessageType::GET_REQUEST && msg.max_staleness_ms != 0);
+    p.spread = (msg.type == MessageType::GET_REQUEST && !p.bounded && options_.hot_keys && cache_.hot(msg.key));
+    p.request = std::move(msg);
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (peers_.empty() || !running_)
+    {
+        lock.unlock();
+        complete(p, nullptr);
+        return;
+    }
+    p.replica = (p.bounded || p.spread ? read_cursor_++ : preferred_) % peers_.size();
+    std::string op_id = p.request.op_id;
+    auto it = pending_.emplace(op_id, std::move(p)).first;
+    if (!dispatch(it->second, op_id))
+    {
+        Pending failed = std::move(it->second);
+        pending_.erase(it);
+        lock.unlock();
+        complete(failed, nullptr);
+    }
+}
+
+bool KVClient::send_attempt(Pending& p)
+{
+    int budget = options_.retry_rounds * static_cast<int>(peers_.size());
+    if (p.attempts >= budget) return false;
+    ++p.attempts;
+    p.attempt_id = ++next_attempt_id_;
+    // Reads carry no seq; a bounded read's carries the attempt, echoed in
+    // the reply, so a late decline of an earlier attempt is told apart
+    if (p.bounded) p.request.seq = p.attempt_id;
+    p.deadline = Clock::now() + std::chrono::milliseconds(options_.request_timeout_ms);
+    outbox_.push_back(Outbound{p.request.op_id, p.attempt_id, p.replica, p.request});
+    outbox_cv_.notify_one();
+    return true;
+}
+
+void KVClient::writer_loop()
+{
+    std::deque<Outbound> batch;
+    while (running_)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            outbox_cv_.wait(lock, [this] { return !outbox_.empty() || !running_; });
+            batch.swap(outbox_);
+        }
+        std::vector<Pending> failed;
+        for (auto& out : batch)
+        {
+            // A blocking connect stalls only this thread
+            if (network::send_message(peers_[out.replica], out.request)) continue;
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = pending_.find(out.op_id);
+            // Completed, or superseded by a later attempt
+            if (it == pending_.end() || it->second.attempt_id != out.attempt_id) continue;
+            // Unreachable: fail over, and steer later writes away from it too
+            Pending& p = it->second;
+            p.replica = (out.replica + 1) % peers_.size();
+            if (!p.bounded && !p.spread) preferred_ = p.replica;
+            if (send_attempt(p))
+            {
+                deadlines_.emplace(p.deadline, out.op_id);
+                continue;
+            }
+            failed.push_back(std::move(p));
+            pending_.erase(it);
+            --on_wire_;
+            release_held(failed);
+        }
+        batch.clear();
+        for (auto& p : failed) complete(p, nullptr);
+    }
+}
+
+bool KVClient::dispatch(Pending& p, const std::string& op_id)
+{
+    if (on_wire_ >= window_)
+    {
+        p.held = true;
+        held_.push_back(op_id);
+        return true;
+    }
+    if (!send_attempt(p)) return false;
+    ++on_wire_;
+    p.epoch = ++sends_;
+    deadlines_.emplace(p.deadline, op_id);
+    return true;
+}
+
+void KVClient::release_held(std::vector<Pending>& failed)
+{
+    while (on_wire_ < window_ && !held_.empty())
+    {
+        std::string op_id = std::move(held_.front());
+        held_.pop_front();
+        auto it = pending_.find(op_id);
+        if (it == pending_.end() || !it->second.held) continue;
+        it->second.held = false;
+        if (!dispatch(it->second, op_id))
+        {
+            failed.push_back(std::move(it->second));
+            pending_.erase(it);
+        }
+    }
+}
+
+bool KVClient::back_off(Pending& p, const std::string& op_id)
+{
+    --on_wire_;
+    // Halve the window once per round of sends: the rest of a flood of
+    // BUSY replies answers requests sent before the cut
+    if (p.epoch > window_cut_at_)
+    {
+        window_ = std::max(1.0, window_ / 2);
+        window_cut_at_ = sends_;
+    }
+    if (++p.busy > options_.busy_retries) return false;
+    // The replica answered, so this attempt does not count toward failover
+    --p.attempts;
+    // Every attempt so far was refused, so the write was never applied
+    // anywhere: retry it under a new seq. Replicas keep only a window of
+    // recent seqs per client, and by the time the backoff ends the old one
+    // may have fallen out of it behind this client's later writes.
+    if (p.request.seq != 0 && !p.timed_out) p.request.seq = ++next_seq_;
+    int shift = std::min(p.busy - 1, 20);
+    int64_t cap = std::min<int64_t>(static_cast<int64_t>(options_.busy_backoff_ms) << shift,
+                                    options_.busy_backoff_max_ms);
+    // Full jitter over the upper half, so rejected clients do not return in step
+    int64_t wait_us = cap * 500 + static_cast<int64_t>(jitter_() % (cap * 500 + 1));
+    p.backing_off = true;
+    p.deadline = Clock::now() + std::chrono::microseconds(wait_us);
+    deadlines_.emplace(p.deadline, op_id);
+    return true;
+}
+
+static uint64_t steady_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool KVClient::through_cache(Message& msg, const Callback& cb)
+{
+    switch (msg.type)
+    {
+    case MessageType::GET_REQUEST:
+        {
+            // Bounded and at-least-version reads need a replica's watermark
+            if (msg.max_staleness_ms != 0 || msg.timestamp != 0) return false;
+            // Without near_cache only hot keys are cached; ask for a lease
+            // in case this one has just turned hot
+            if (!options_.near_cache && !cache_.hot(msg.key))
+            {
+                msg.value = "hot";
+                return false;
+            }
+            KVResult r;
+            if (cache_.get(msg.key, steady_ms(), r.value, r.version))
+            {
+                r.answered = r.ok = true;
+                r.key = msg.key;
+                if (cb) cb(r);
+                return true;
+            }
+            msg.value = "lease";
+            return false;
+        }
+    case MessageType::MULTI_PUT_REQUEST:
+        for (const auto& entry : msg.entries) cache_.invalidate(entry.first, 0);
+        return false;
+    case MessageType::PUT_REQUEST:
+    case MessageType::CAS_REQUEST:
+    case MessageType::INCR_REQUEST:
+    case MessageType::APPEND_REQUEST:
+        cache_.invalidate(msg.key, 0);
+        return false;
+    default:
+        return false;
+    }
+}
+
+void KVClient::complete(Pending& p, const Message* resp)
+{
+    KVResult r;
+    r.busy = (!resp && p.busy > options_.busy_retries);
+    if (resp)
+    {
+        r.answered = true;
+        r.ok = resp->ok;
+        r.error = resp->error;
+        r.key = resp->key;
+        r.value = resp->value;
+        r.version = resp->version;
+        r.timestamp = resp->timestamp;
+        r.entries = resp->entries;
+        // Leased read: cacheable until the replica says otherwise. Own
+        // write: no reply from before it may be cached.
+        if (resp->type == MessageType::GET_RESPONSE && resp->ok && (resp->max_staleness_ms != 0 || resp->hot))
+        {
+            cache_.fill(resp->key, resp->value, resp->version, resp->max_staleness_ms, steady_ms(), resp->hot);
+        }
+        else if (options_.hot_keys && resp->type == MessageType::GET_RESPONSE && resp->ok)
+        {
+            cache_.cool(resp->key);
+        }
+        if ((options_.near_cache || options_.hot_keys) && resp->type == MessageType::COMMIT && resp->ok)
+        {
+            cache_.invalidate(resp->key, resp->version);
+        }
+        if (resp->type == MessageType::COMMIT)
+        {
+            uint64_t seen = last_commit_ts_.load();
+            while (resp->timestamp > seen && !last_commit_ts_.compare_exchange_weak(seen, resp->timestamp))
+            {
+            }
+        }
+    }
+    if (p.cb) p.cb(r);
+}
+
+void KVClient::dispatch_loop()
+{
+    while (running_)
+    {
+        std::vector<Pending> failed;
+        Message resp;
+        bool received = network::receive_message(resp, /*timeout_ms=*/10);
+        if (received && resp.type == MessageType::WATCH_EVENT)
+        {
+            on_watch_event(resp);
+        }
+        else if (received && resp.type == MessageType::CACHE_INVALIDATE)
+        {
+            cache_.invalidate(resp.key, resp.version);
+        }
+        else if (received)
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            auto it = pending_.find(resp.op_id);
+            bool found = (it != pending_.end());
+            // Sent and counted in the window (not held or backing off)
+            bool on_wire = found && !it->second.held && !it->second.backing_off;
+            if (on_wire && resp.type == MessageType::BUSY)
+            {
+                // Fall through to the deadline scan: BUSY replies come in
+                // floods and must not hold back due resends
+                if (!back_off(it->second, resp.op_id))
+                {
+                    failed.push_back(std::move(it->second));
+                    pending_.erase(it);
+                }
+            }
+            else if (found && it->second.expect == resp.type)
+            {
+                Pending& p = it->second;
+                // A replica behind a bounded read's bound declines; ask the next
+                // one. Once all have declined, give their watermarks time to
+                // advance (closed timestamps) before the next pass.
+                if (p.bounded && !resp.ok)
+                {
+                    // Only the attempt on the wire now may move the request
+                    // on (and out of the window); an earlier one's decline
+                    // arriving late is dropped
+                    if (!on_wire || resp.seq != p.attempt_id) continue;
+                    p.replica = (p.replica + 1) % peers_.size();
+                    int budget = options_.retry_rounds * static_cast<int>(peers_.size());
+                    if (p.attempts % peers_.size() == 0 && p.attempts < budget)
+                    {
+                        --on_wire_;
+                        p.backing_off = true;
+                        p.deadline = Clock::now() + std::chrono::milliseconds(options_.declined_pause_ms);
+                        deadlines_.emplace(p.deadline, resp.op_id);
+                        continue;
+                    }
+                    if (send_attempt(p))
+                    {
+                        deadlines_.emplace(p.deadline, resp.op_id);
+                        continue;
+                    }
+                }
+                Pending done = std::move(p);
+                pending_.erase(it);
+                if (on_wire)
+                {
+                    --on_wire_;
+                    // Additive increase: about one more request per window of replies
+                    window_ = std::min(static_cast<double>(options_.max_in_flight), window_ + 1 / window_);
+                    release_held(failed);
+                }
+                lock.unlock();
+                complete(done, &resp);
+            }
+        }
+
+        // Fail over requests whose reply is overdue; resend backed-off ones
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto now = Clock::now();
+            while (!deadlines_.empty() && deadlines_.top().first <= now)
+            {
+                std::string op_id = deadlines_.top().second;
+                auto due = deadlines_.top().first;
+                deadlines_.pop();
+                auto it = pending_.find(op_id);
+                // Skip completed ops and deadlines superseded by a later attempt
+                if (it == pending_.end() || it->second.deadline != due) continue;
+                Pending& p = it->second;
+                bool ok;
+                if (p.backing_off)
+                {
+                    // Back to the replica that was busy (the others are no
+                    // less loaded, and writes keep their coordinator), or on
+                    // to the next pass of a declined read, once the window
+                    // has room
+                    p.backing_off = false;
+                    ok = dispatch(p, op_id);
+                }
+                else
+                {
+                    p.timed_out = true;
+                    p.replica = (p.replica + 1) % peers_.size();
+                    if (!p.bounded && !p.spread) preferred_ = p.replica;
+                    ok = send_attempt(p);
+                    if (ok) deadlines_.emplace(p.deadline, op_id);
+                    else --on_wire_;
+                }
+                if (!ok)
+                {
+                    failed.push_back(std::move(p));
+                    pending_.erase(it);
+                }
+            }
+            release_held(failed);
+        }
+        for (auto& p : failed) complete(p, nullptr);
+        renew_watches();
+    }
+}
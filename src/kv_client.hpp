@@ -0,0 +1,264 @@
+/*
+ * File: kv_client.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Asynchronous pipelined client library
+*/
+#ifndef KV_CLIENT_HPP
+#define KV_CLIENT_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <queue>
+#include <deque>
+#include <map>
+#include <random>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include "message.hpp"
+#include "near_cache.hpp"
+
+// Result of a client operation
+struct KVResult
+{
+    bool answered = false; // a replica replied (false: every attempt failed or timed out)
+    bool ok = false; // outcome: false for a rejected CAS/INCR or an unmet read bound
+    bool busy = false; // not answered because replicas kept replying BUSY (overload)
+    std::string error; // why the replica refused the request outright (ok = false):
+                       // "cross_shard", or "stale_retry" (a retry too old to deduplicate)
+    std::string key;
+    std::string value;
+    uint64_t version = 0; // key version after a write / at read time
+    uint64_t timestamp = 0; // commit token for writes, replica watermark for reads
+    std::vector<std::pair<std::string, std::string>> entries; // MULTI_GET results
+};
+
+// Asynchronous, pipelined client for the replicated store (libkvclient).
+// Any number of requests may be in flight at once; responses are matched
+// to requests by op_id on a dispatcher thread, which also fails requests
+// over to the next replica when a reply times out. A replica too loaded to
+// admit a request replies BUSY; the request is then resent to it after an
+// exponential, jittered backoff, and the client halves the number of
+// requests it keeps on the wire (growing it back by about one per round of
+// replies), holding the rest until there is room. Connections to replicas
+// are reused across requests (see network::send_message), and all sends
+// happen on a writer thread, so a replica slow to accept a connection
+// holds up neither callers nor reply matching.
+//
+// Watches are registered with the replica writes go to and renewed every
+// watch_renew_ms; a renewal that fails over re-registers the watch with the
+// next replica, which first sends what changed since the versions already
+// delivered.
+//
+// With Options::near_cache, plain GETs (no staleness bound or min_ts) are
+// answered from an in-process cache when they can be. A miss asks the
+// replica for a lease on the key; the replica sends an invalidation on the
+// key's next commit, and an entry is trusted for at most near_cache_ttl_ms
+// in case the invalidation is lost. This client's own writes invalidate
+// the keys they write before they are sent.
+//
+// With Options::hot_keys, GETs ask the replica to lease the key if it is
+// read-hot, and hot keys are cached the same way even without near_cache,
+// under the lease the replica grants them; their cache misses go to every
+// replica in turn rather than to the preferred one.
+//
+// The network layer is process-wide, so a process hosts one KVClient.
+class KVClient
+{
+public:
+    using Callback = std::function<void(const KVResult&)>;
+
+    struct Options
+    {
+        int request_timeout_ms = 3000; // per-attempt wait before failing over
+        int retry_rounds = 2; // passes over the replica list before giving up
+        int declined_pause_ms = 20; // bounded read declined by every replica: wait before the next pass
+        int busy_backoff_ms = 2; // wait after the first BUSY; doubles per BUSY after that
+        int busy_backoff_max_ms = 500;
+        int busy_retries = 10; // BUSY replies to one request before giving up on it
+        int max_in_flight = 4096; // requests on the wire at once; later ones wait their turn
+        int watch_renew_ms = 3000; // resend each watch this often (replicas drop it after 10 s)
+        bool near_cache = false; // serve repeated GETs from leased, invalidated local copies
+        size_t near_cache_capacity = 10000; // keys; least recently used are evicted
+        uint64_t near_cache_ttl_ms = 1000; // longest a cached value is served (bounds staleness)
+        bool hot_keys = false; // cache keys replicas report read-hot and spread their reads
+    };
+
+    KVClient(const std::string& client_id, const std::string& config_file);
+    KVClient(const std::string& client_id, const std::string& config_file, Options options);
+    ~KVClient();
+
+    KVClient(const KVClient&) = delete;
+    KVClient& operator=(const KVClient&) = delete;
+
+    // Futures API. Keys and values may hold any bytes, '|' and '\n'
+    // included: the wire format escapes them
+    std::future<KVResult> async_put(const std::string& key, const std::string& value);
+    std::future<KVResult> async_get(const std::string& key, uint64_t max_staleness_ms = 0, uint64_t min_ts = 0);
+    // All entries commit as one unit, so on a sharded cluster (node
+    // --shards > 1) they must all live in one shard: otherwise the write is
+    // refused with ok = false and error "cross_shard", and nothing commits
+    std::future<KVResult> async_multi_put(const std::vector<std::pair<std::string, std::string>>& entries);
+    std::future<KVResult> async_multi_get(const std::vector<std::string>& keys);
+    std::future<KVResult> async_cas(const std::string& key, const std::string& expected, const std::string& value);
+    std::future<KVResult> async_cas_version(const std::string& key, uint64_t version, const std::string& value);
+    std::future<KVResult> async_incr(const std::string& key, int64_t delta = 1);
+    std::future<KVResult> async_append(const std::string& key, const std::string& suffix);
+
+    // Callback API: cb runs on the dispatcher thread (on the calling thread
+    // for a near-cache hit) and must not block
+    void async_put(const std::string& key, const std::string& value, Callback cb);
+    void async_get(const std::string& key, Callback cb, uint64_t max_staleness_ms = 0, uint64_t min_ts = 0);
+    void async_multi_put(const std::vector<std::pair<std::string, std::string>>& entries, Callback cb);
+    void async_multi_get(const std::vector<std::string>& keys, Callback cb);
+    void async_cas(const std::string& key, const std::string& expected, const std::string& value, Callback cb);
+    void async_incr(const std::string& key, int64_t delta, Callback cb);
+    void async_append(const std::string& key, const std::string& suffix, Callback cb);
+
+    /**
+     * Watch API: cb runs on the dispatcher thread, must not block, and is
+     * called for each change to a watched key with its key, value, version
+     * and the commit's timestamp (0 for current values sent on
+     * registration). Each key's versions arrive in increasing order, at most
+     * once each, whichever replica sends them; versions in between may be
+     * skipped if the watch moved replicas. Returns the id for unwatch().
+     *
+     * watch() first reports key's current value if its version is above
+     * from_version (pass the last version seen to resume); watch_prefix()
+     * first reports every key that starts with prefix.
+     */
+    uint64_t watch(const std::string& key, Callback cb, uint64_t from_version = 0);
+    uint64_t watch_prefix(const std::string& prefix, Callback cb);
+    // Stop delivering a watch's changes; the replica forgets it on request
+    // or when its lease runs out
+    void unwatch(uint64_t id);
+
+    // Near-cache hit/miss/invalidation counts (hot keys only without near_cache)
+    NearCache::Stats cache_stats() const { return cache_.stats(); }
+
+    // Requests submitted and not yet completed (including any held back)
+    size_t in_flight() const;
+
+    // Timestamp of the newest committed write; bounded reads default to at
+    // least this so a client always sees its own writes
+    uint64_t last_commit_ts() const { return last_commit_ts_.load(); }
+
+    // Fail every outstanding request and stop the dispatcher
+    void shutdown();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending
+    {
+        Message request;
+        MessageType expect; // response type that completes it
+        Callback cb;
+        size_t replica; // index into peers_ of the current attempt
+        int attempts = 0; // sends made so far
+        int busy = 0; // BUSY replies so far
+        bool bounded = false; // bounded read: a declining replica means "try the next one"
+        bool spread = false; // read of a hot key: sent round robin, does not move preferred_
+        bool backing_off = false; // deadline is when to resend after a BUSY, not a reply timeout
+        bool timed_out = false; // some attempt went unanswered (and may yet be applied)
+        bool held = false; // waiting in held_ for room in the window, not yet sent
+        uint64_t epoch = 0; // sends_ when last dispatched
+        uint64_t attempt_id = 0; // latest attempt handed to the writer
+        Clock::time_point deadline;
+    };
+
+    // One send for the writer thread
+    struct Outbound
+    {
+        std::string op_id;
+        uint64_t attempt_id;
+        size_t replica;
+        Message request;
+    };
+
+    struct Watch
+    {
+        std::string key; // the key, or the prefix
+        bool prefix = false;
+        Callback cb;
+        std::unordered_map<std::string, uint64_t> seen; // newest version delivered, per key
+        Clock::time_point renew_at;
+    };
+
+    Message make_request(MessageType type, bool is_write);
+    Message make_get(const std::string& key, uint64_t max_staleness_ms, uint64_t min_ts);
+    static Message with_key(Message msg, const std::string& key, const std::string& value);
+
+    std::future<KVResult> submit(Message msg, MessageType expect);
+    void submit(Message msg, MessageType expect, Callback cb);
+
+    // Queue p.request for p.replica on the writer thread (which fails over
+    // if the replica is unreachable); false when the attempt budget is
+    // exhausted. Called with mtx_ held.
+    bool send_attempt(Pending& p);
+    // Send queued attempts without holding mtx_
+    void writer_loop();
+    // Send p (counting it against the window) or hold it until there is
+    // room; false when it cannot be sent. Called with mtx_ held.
+    bool dispatch(Pending& p, const std::string& op_id);
+    // Send held requests while the window has room; requests that cannot be
+    // sent are moved to failed. Called with mtx_ held.
+    void release_held(std::vector<Pending>& failed);
+    // Take p off the wire after a BUSY reply, shrink the window and
+    // schedule a resend; false when out of BUSY retries. Called with mtx_ held.
+    bool back_off(Pending& p, const std::string& op_id);
+    uint64_t add_watch(Watch w);
+    // WATCH_REQUEST (resuming from the versions seen) or UNWATCH_REQUEST for w
+    Message make_watch(MessageType type, const Watch& w);
+    void on_watch_event(const Message& event);
+    // Resend the watches due for renewal
+    void renew_watches();
+    void dispatch_loop();
+    void complete(Pending& p, const Message* resp);
+    // Answer msg from the near cache, or lease it on its way out (a GET) /
+    // invalidate the keys it writes; true if cb was answered
+    bool through_cache(Message& msg, const Callback& cb);
+
+    std::string client_id_;
+    Options options_;
+    std::vector<std::string> peers_;
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, Pending> pending_; // op_id -> request
+    // Retry deadlines, earliest first; entries for completed ops are skipped
+    std::priority_queue<std::pair<Clock::time_point, std::string>,
+                        std::vector<std::pair<Clock::time_point, std::string>>,
+                        std::greater<>> deadlines_;
+
+    std::atomic<uint64_t> next_seq_{0};
+    std::atomic<uint64_t> last_commit_ts_{0};
+    size_t preferred_ = 0; // replica writes go to first (keeps one coordinator)
+    size_t read_cursor_ = 0; // rotates bounded and hot-key reads across replicas
+    std::minstd_rand jitter_{std::random_device{}()}; // backoff jitter; guarded by mtx_
+    // Congestion window (AIMD on BUSY replies); guarded by mtx_
+    double window_; // starts at max_in_flight
+    size_t on_wire_ = 0; // sent, awaiting a reply (not held or backing off)
+    std::deque<std::string> held_; // op_ids waiting for room, oldest first
+    uint64_t sends_ = 0; // dispatches so far
+    uint64_t window_cut_at_ = 0; // sends_ at the last halving
+    NearCache cache_; // locks itself
+    std::map<uint64_t, Watch> watches_; // by id; guarded by mtx_
+    uint64_t next_watch_ = 0; // guarded by mtx_
+    std::deque<Outbound> outbox_; // attempts for the writer, in order; guarded by mtx_
+    std::condition_variable outbox_cv_;
+    uint64_t next_attempt_id_ = 0; // guarded by mtx_
+    std::atomic<bool> running_{false};
+    std::thread dispatcher_;
+    std::thread writer_;
+};
+
+#endif // KV_CLIENT_HPP
@@ -8,11 +8,41 @@
 #ifndef KV_STORE_HPP
 #define KV_STORE_HPP
 
+#include <algorithm>
 #include <string>
+#include <set>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <charconv>
 #include "message.hpp"
 
-// In-memory key-value store with operation logging and commit semantics
+// Outcome of committing an operation
+struct OpResult
+{
+    bool found = false; // op_id was pending
+    bool ok = false; // write took effect (false for a failed CAS/INCR)
+    std::string key; // key the op targeted (first key for multi-key ops)
+    std::string value; // value of the key after the op
+    uint64_t version = 0; // version of the key after the op
+    uint64_t timestamp = 0; // timestamp the op was replicated with
+};
+
+// A committed key as returned by KVStore::scan
+struct KeyState
+{
+    std::string key;
+    std::string value;
+    uint64_t version = 0;
+};
+
+// In-memory key-value store with operation logging and commit semantics.
+// One thread applies and commits; any number of others may call the read
+// methods (get, version, get_versioned, multi_get, scan, watermark) at the same
+// time, as a node's reader threads do.
 class KVStore
 {
 public:
@@ -21,38 +51,252 @@ public:
     // Apply an operation (store it pending commit)
     void apply(const Message& msg)
     {
-        // Only apply PUT operations
-        if (msg.type == MessageType::MULTICAST_OP)
+        // Only apply replicated operations
+        if (msg.type == MessageType::MULTICAST_OP && pending_.emplace(msg.op_id, msg).second)
         {
-            pending_[msg.op_id] = msg;
+            std::unique_lock<std::shared_mutex> lock(mtx_);
+            pending_ts_.insert(msg.timestamp);
         }
     }
 
-    // Commit a previously applied operation by op_id
-    void commit(const std::string& op_id)
+    // Commit a previously applied operation by op_id. Conditional operations
+    // (CAS, INCR, APPEND) are evaluated here, against the committed state, so
+    // every replica committing in the same order reaches the same result
+    // (Replica sends all of a shard's writes through one sequencer so that
+    // they do).
+    OpResult commit(const std::string& op_id)
     {
+        OpResult result;
         auto it = pending_.find(op_id);
-        if (it != pending_.end())
+        if (it == pending_.end())
+        {
+            return result;
+        }
+        const Message& op = it->second;
+        result.found = true;
+        result.key = op.entries.empty() ? op.key : op.entries.front().first;
+        // Readers see the op's writes and the watermark move together
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+
+        switch (op.op)
         {
-            // Update the actual store
-            data_[it->second.key] = it->second.value;
-            // Remove from pending log
-            pending_.erase(it);
+        case MessageType::CAS_REQUEST:
+            {
+                const Entry& cur = lookup(op.key);
+                result.ok = (op.version != 0 ? cur.version == op.version : cur.value == op.expected);
+                if (result.ok) write(op.key, op.value);
+                break;
+            }
+        case MessageType::INCR_REQUEST:
+            {
+                int64_t base = 0, delta = 1, sum = 0;
+                // Overflow fails the INCR like a non-integer value does
+                result.ok = parse_int(lookup(op.key).value, base) && parse_int(op.value, delta, 1) &&
+                    !__builtin_add_overflow(base, delta, &sum);
+                if (result.ok) write(op.key, std::to_string(sum));
+                break;
+            }
+        case MessageType::APPEND_REQUEST:
+            {
+                result.ok = true;
+                write(op.key, lookup(op.key).value + op.value);
+                break;
+            }
+        default:
+            {
+                // Plain PUT / MULTI_PUT; a multi-key op lands as one unit
+                result.ok = true;
+                if (op.entries.empty())
+                {
+                    write(op.key, op.value);
+                }
+                for (const auto& [k, v] : op.entries)
+                {
+                    write(k, v);
+                }
+            }
         }
+
+        const Entry& after = lookup(result.key);
+        result.value = after.value;
+        result.version = after.version;
+        result.timestamp = op.timestamp;
+        // Remove from pending log
+        pending_ts_.erase(pending_ts_.find(op.timestamp));
+        lock.unlock();
+        pending_.erase(it);
+        return result;
+    }
+
+    // Operation awaiting commit under op_id (nullptr if none)
+    const Message* pending(const std::string& op_id) const
+    {
+        auto it = pending_.find(op_id);
+        return (it != pending_.end() ? &it->second : nullptr);
+    }
+
+    // Number of operations awaiting commit
+    size_t pending_count() const
+    {
+        return pending_.size();
+    }
+
+    // Number of keys ever written
+    size_t size() const
+    {
+        return data_.size();
+    }
+
+    // Order-independent hash of the committed keys, values and versions;
+    // replicas that committed the same writes have equal fingerprints
+    uint64_t fingerprint() const
+    {
+        uint64_t sum = 0;
+        for (const auto& [key, e] : data_)
+        {
+            // FNV-1a over key, value and version, then summed across keys
+            uint64_t h = 1469598103934665603ULL;
+            auto mix = [&h](const std::string& s)
+            {
+                for (unsigned char c : s) h = (h ^ c) * 1099511628211ULL;
+                h = (h ^ 0xff) * 1099511628211ULL;
+            };
+            mix(key);
+            mix(e.value);
+            h = (h ^ e.version) * 1099511628211ULL;
+            sum += h;
+        }
+        return sum;
     }
 
     // Read a value for a given key (empty string if not found)
     std::string get(const std::string& key) const
     {
-        auto it = data_.find(key);
-        return (it != data_.end() ? it->second : std::string());
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        return lookup(key).value;
+    }
+
+    // Version of a key: number of committed writes to it (0 if not found)
+    uint64_t version(const std::string& key) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        return lookup(key).version;
+    }
+
+    // Value and version of a key as of the same commit
+    std::pair<std::string, uint64_t> get_versioned(const std::string& key) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        const Entry& e = lookup(key);
+        return {e.value, e.version};
+    }
+
+    // Read several keys in one pass, as of the same commit (empty value for
+    // keys not found)
+    std::vector<std::pair<std::string, std::string>> multi_get(const std::vector<std::string>& keys) const
+    {
+        std::vector<std::pair<std::string, std::string>> out;
+        out.reserve(keys.size());
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        for (const auto& key : keys)
+        {
+            out.emplace_back(key, lookup(key).value);
+        }
+        return out;
+    }
+
+    // Keys starting with prefix whose version is above after_version, as of
+    // the same commit. A full pass over the store: for catching up watches,
+    // not for the request path.
+    std::vector<KeyState> scan(const std::string& prefix, uint64_t after_version) const
+    {
+        std::vector<KeyState> out;
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        for (const auto& [key, e] : data_)
+        {
+            if (e.version > after_version && key.compare(0, prefix.size(), prefix) == 0)
+            {
+                out.push_back({key, e.value, e.version});
+            }
+        }
+        return out;
+    }
+
+    // Applied watermark: every operation with a timestamp at or below it is
+    // committed here. closed_ts is the caller's guarantee that no operation
+    // at or below it is still to arrive; pending operations hold the
+    // watermark below the oldest of them.
+    uint64_t watermark(uint64_t closed_ts) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        if (pending_ts_.empty())
+        {
+            return closed_ts;
+        }
+        uint64_t oldest = *pending_ts_.begin();
+        uint64_t below = (oldest > 0 ? oldest - 1 : 0);
+        return (below < closed_ts ? below : closed_ts);
+    }
+
+    // Pending operations whose op_id starts with prefix and whose timestamp
+    // is at most max_ts, oldest first
+    std::vector<std::string> pending_through(const std::string& prefix, uint64_t max_ts) const
+    {
+        std::vector<std::pair<uint64_t, std::string>> found;
+        if (pending_ts_.empty() || *pending_ts_.begin() > max_ts) return {};
+        for (const auto& [op_id, op] : pending_)
+        {
+            if (op.timestamp <= max_ts && op_id.compare(0, prefix.size(), prefix) == 0)
+                found.emplace_back(op.timestamp, op_id);
+        }
+        std::sort(found.begin(), found.end());
+        std::vector<std::string> out;
+        for (auto& entry : found) out.push_back(std::move(entry.second));
+        return out;
     }
 
 private:
+    struct Entry
+    {
+        std::string value;
+        uint64_t version = 0;
+    };
+
+    const Entry& lookup(const std::string& key) const
+    {
+        static const Entry missing;
+        auto it = data_.find(key);
+        return (it != data_.end() ? it->second : missing);
+    }
+
+    void write(const std::string& key, const std::string& value)
+    {
+        Entry& e = data_[key];
+        e.value = value;
+        ++e.version;
+    }
+
+    // Parse a signed integer; an empty string yields fallback
+    static bool parse_int(const std::string& s, int64_t& out, int64_t fallback = 0)
+    {
+        if (s.empty())
+        {
+            out = fallback;
+            return true;
+        }
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return ec == std::errc() && ptr == s.data() + s.size();
+    }
+
     // Committed key-value data
-    std::unordered_map<std::string, std::string> data_;
+    std::unordered_map<std::string, Entry> data_;
     // Operations received but awaiting commit
     std::unordered_map<std::string, Message> pending_;
+    // Timestamps of pending operations, oldest first
+    std::multiset<uint64_t> pending_ts_;
+    // Held shared by readers, exclusively by the writer while it changes
+    // data_ or pending_ts_ (pending_ is the writer's alone)
+    mutable std::shared_mutex mtx_;
 };
 
 #endif // KV_STORE_HPP
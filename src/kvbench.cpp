@@ -0,0 +1,462 @@
+/*
+ * File: kvbench.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: YCSB-style multi-threaded load generator
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cctype>
+#include "kv_client.hpp"
+#include "ycsb.hpp"
+#include "histogram.hpp"
+
+using BenchClock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string client_id;
+    std::string config_file;
+    char workload = 'A';
+    uint64_t records = 1000; // records loaded before the run
+    uint64_t ops = 10000; // operations in the run (ignored when duration_s is set)
+    double duration_s = 0; // run for a fixed time instead of a fixed op count
+    int threads = 1;
+    int inflight = 1; // outstanding ops per thread (closed loop)
+    size_t value_size = 100;
+    bool distribution_set = false;
+    ycsb::Distribution distribution = ycsb::Distribution::ZIPFIAN;
+    bool open_loop = false;
+    double rate = 1000; // target ops/s across all threads (open loop)
+    int scan_max = 100; // longest scan (workload E)
+    bool load = true;
+    uint64_t seed = 1;
+    std::string format = "csv";
+    std::string out; // results file (stdout if empty)
+    std::string label = "healthy"; // tags result rows, e.g. healthy / one-down
+    std::string hist_prefix; // write each op type's histogram to <prefix>.<OP>.hgrm
+    bool near_cache = false; // serve repeated GETs from libkvclient's near cache
+    bool hot_keys = false; // cache and spread reads of keys the replicas report hot
+};
+
+// Per-operation-type latency histograms, shared by every issuing thread.
+// "latency" is measured from when the op was meant to be issued and
+// "service" from when it actually was; they differ only in open loop, where
+// a stalled issuer would otherwise hide the queueing its backlog suffered
+// (coordinated omission).
+class Recorder
+{
+public:
+    struct Stats
+    {
+        uint64_t errors = 0;
+        LatencyHistogram latency; // microseconds, from the intended issue time
+        LatencyHistogram service; // microseconds, from the actual issue time
+    };
+
+    void record(ycsb::OpKind op, BenchClock::time_point intended, BenchClock::time_point start, bool ok)
+    {
+        auto now = BenchClock::now();
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats& s = stats_[static_cast<int>(op)];
+        if (!ok)
+        {
+            ++s.errors;
+            return;
+        }
+        s.latency.record(micros(now - intended));
+        s.service.record(micros(now - start));
+    }
+
+    const Stats& stats(ycsb::OpKind op) const { return stats_[static_cast<int>(op)]; }
+
+private:
+    static uint64_t micros(BenchClock::duration d)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    std::mutex mtx_;
+    std::array<Stats, static_cast<int>(ycsb::OpKind::COUNT)> stats_;
+};
+
+static void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " <client_id> <config_file> [options]\n"
+        "       " << prog << " --merge <file.hgrm> [<file.hgrm> ...]\n"
+        "  --workload=A..F          YCSB core workload (default A)\n"
+        "  --records=N              records loaded before the run (default 1000)\n"
+        "  --ops=N                  operations to run (default 10000)\n"
+        "  --duration=S             run for S seconds instead of --ops\n"
+        "  --threads=N              issuing threads (default 1)\n"
+        "  --inflight=M             outstanding ops per thread, closed loop (default 1)\n"
+        "  --value-size=B           value size in bytes (default 100)\n"
+        "  --distribution=D         uniform | zipfian | latest (default: workload's)\n"
+        "  --mode=closed|open       closed loop, or open loop at --rate\n"
+        "  --rate=R                 target ops/s across all threads, open loop (default 1000)\n"
+        "  --scan-max=L             longest scan for workload E (default 100)\n"
+        "  --no-load                skip the load phase\n"
+        "  --seed=S                 random seed (default 1)\n"
+        "  --format=csv|json        results format (default csv)\n"
+        "  --out=PATH               write results to PATH instead of stdout\n"
+        "  --label=NAME             tag results with NAME, e.g. one-down (default healthy)\n"
+        "  --hist-prefix=P          save per-op latency histograms as P.<OP>.hgrm\n"
+        "  --near-cache             enable the client near cache for reads\n"
+        "  --hot-keys               cache and spread reads of keys the replicas report hot\n"
+        "  --merge                  merge saved histograms and print their percentiles\n";
+}
+
+static bool parse_args(int argc, char* argv[], Options& opt)
+{
+    if (argc < 3) return false;
+    opt.client_id = argv[1];
+    opt.config_file = argv[2];
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string val = (eq == std::string::npos ? std::string() : arg.substr(eq + 1));
+        try
+        {
+            if (name == "--workload" && val.size() == 1) opt.workload = static_cast<char>(std::toupper(val[0]));
+            else if (name == "--records") opt.records = std::stoull(val);
+            else if (name == "--ops") opt.ops = std::stoull(val);
+            else if (name == "--duration") opt.duration_s = std::stod(val);
+            else if (name == "--threads") opt.threads = std::stoi(val);
+            else if (name == "--inflight") opt.inflight = std::stoi(val);
+            else if (name == "--value-size") opt.value_size = std::stoull(val);
+            else if (name == "--distribution")
+            {
+                if (!ycsb::parse_distribution(val, opt.distribution)) return false;
+                opt.distribution_set = true;
+            }
+            else if (name == "--mode" && (val == "open" || val == "closed")) opt.open_loop = (val == "open");
+            else if (name == "--rate") opt.rate = std::stod(val);
+            else if (name == "--scan-max") opt.scan_max = std::stoi(val);
+            else if (name == "--no-load") opt.load = false;
+            else if (name == "--near-cache") opt.near_cache = true;
+            else if (name == "--hot-keys") opt.hot_keys = true;
+            else if (name == "--seed") opt.seed = std::stoull(val);
+            else if (name == "--format" && (val == "csv" || val == "json")) opt.format = val;
+            else if (name == "--out") opt.out = val;
+            else if (name == "--label" && !val.empty()) opt.label = val;
+            else if (name == "--hist-prefix" && !val.empty()) opt.hist_prefix = val;
+            else return false;
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+    return opt.threads > 0 && opt.inflight > 0 && opt.records > 0 && opt.rate > 0 && opt.scan_max > 0;
+}
+
+static std::string make_value(size_t size, uint64_t salt)
+{
+    return std::string(size, static_cast<char>('a' + salt % 26));
+}
+
+// Insert every record with batched MULTI_PUTs, a few batches in flight. A
+// sharded cluster refuses batches that span shards; those go key by key.
+static void load(KVClient& kv, const Options& opt)
+{
+    using Entries = std::vector<std::pair<std::string, std::string>>;
+    const uint64_t batch = 100;
+    const size_t window = 16;
+    std::vector<std::pair<Entries, std::future<KVResult>>> inflight;
+    auto drain = [&kv, &inflight]()
+    {
+        std::vector<std::future<KVResult>> singles;
+        for (auto& [entries, f] : inflight)
+        {
+            if (f.get().error != "cross_shard") continue;
+            for (const auto& [k, v] : entries) singles.push_back(kv.async_put(k, v));
+        }
+        for (auto& f : singles) f.get();
+        inflight.clear();
+    };
+    for (uint64_t start = 0; start < opt.records; start += batch)
+    {
+        Entries entries;
+        for (uint64_t i = start; i < start + batch && i < opt.records; ++i)
+        {
+            entries.emplace_back(ycsb::key_name(i), make_value(opt.value_size, i));
+        }
+        std::future<KVResult> f = kv.async_multi_put(entries);
+        inflight.emplace_back(std::move(entries), std::move(f));
+        if (inflight.size() >= window) drain();
+    }
+    drain();
+}
+
+// One issuing thread: closed loop keeps opt.inflight ops outstanding; open
+// loop issues on a fixed schedule regardless of completions
+static void run_thread(int idx, const Options& opt, const ycsb::Workload& w, KVClient& kv,
+                       ycsb::KeyChooser& keys, Recorder& rec, std::atomic<int64_t>& budget,
+                       BenchClock::time_point end)
+{
+    std::mt19937_64 rng(opt.seed * 7919 + idx);
+    std::mutex mtx;
+    std::condition_variable cv;
+    int outstanding = 0;
+
+    auto finish = [&](ycsb::OpKind op, BenchClock::time_point intended, BenchClock::time_point start, bool ok)
+    {
+        rec.record(op, intended, start, ok);
+        std::lock_guard<std::mutex> lock(mtx);
+        --outstanding;
+        cv.notify_one();
+    };
+
+    auto interval = std::chrono::duration_cast<BenchClock::duration>(
+        std::chrono::duration<double>(opt.threads / opt.rate));
+    auto next_issue = BenchClock::now();
+
+    while (true)
+    {
+        if (opt.duration_s > 0 ? BenchClock::now() >= end : budget.fetch_sub(1) <= 0) break;
+        auto intended = next_issue;
+        if (opt.open_loop)
+        {
+            // A late issuer does not move the schedule: ops it issues late
+            // are charged from their slot
+            std::this_thread::sleep_until(intended);
+            next_issue += interval;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (!opt.open_loop) cv.wait(lock, [&] { return outstanding < opt.inflight; });
+            ++outstanding;
+        }
+
+        ycsb::OpKind op = ycsb::choose_op(w, rng);
+        auto start = BenchClock::now();
+        if (!opt.open_loop) intended = start;
+        switch (op)
+        {
+        case ycsb::OpKind::READ:
+            kv.async_get(ycsb::key_name(keys.next(rng)),
+                         [&, op, intended, start](const KVResult& r) { finish(op, intended, start, r.answered); });
+            break;
+        case ycsb::OpKind::UPDATE:
+            kv.async_put(ycsb::key_name(keys.next(rng)), make_value(opt.value_size, rng()),
+                         [&, op, intended, start](const KVResult& r) { finish(op, intended, start, r.answered); });
+            break;
+        case ycsb::OpKind::INSERT:
+            kv.async_put(ycsb::key_name(keys.next_insert()), make_value(opt.value_size, rng()),
+                         [&, op, intended, start](const KVResult& r) { finish(op, intended, start, r.answered); });
+            break;
+        case ycsb::OpKind::SCAN:
+            {
+                uint64_t first = keys.next(rng);
+                int len = std::uniform_int_distribution<int>(1, opt.scan_max)(rng);
+                std::vector<std::string> names;
+                for (int i = 0; i < len; ++i) names.push_back(ycsb::key_name(first + i));
+                kv.async_multi_get(names, [&, op, intended, start](const KVResult& r) { finish(op, intended, start, r.answered); });
+                break;
+            }
+        case ycsb::OpKind::RMW:
+        default:
+            {
+                std::string key = ycsb::key_name(keys.next(rng));
+                std::string value = make_value(opt.value_size, rng());
+                kv.async_get(key, [&, op, intended, start, key, value](const KVResult& r)
+                {
+                    if (!r.answered)
+                    {
+                        finish(op, intended, start, false);
+                        return;
+                    }
+                    kv.async_put(key, value, [&, op, intended, start](const KVResult& w2)
+                    {
+                        finish(op, intended, start, w2.answered);
+                    });
+                });
+                break;
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return outstanding == 0; });
+}
+
+// Percentiles every report carries, as (column suffix, percentile)
+static const std::array<std::pair<const char*, double>, 4> REPORTED = {{
+    {"p50", 50.0}, {"p99", 99.0}, {"p999", 99.9}, {"p9999", 99.99}
+}};
+
+static void write_results(std::ostream& os, const Options& opt, const ycsb::Workload& w,
+                          const Recorder& rec, double elapsed_s)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < static_cast<int>(ycsb::OpKind::COUNT); ++i)
+    {
+        total += rec.stats(static_cast<ycsb::OpKind>(i)).latency.count();
+    }
+    double throughput = total / elapsed_s;
+    const char* mode = opt.open_loop ? "open" : "closed";
+
+    if (opt.format == "json")
+    {
+        os << "{\"label\":\"" << opt.label << "\",\"workload\":\"" << w.name << "\",\"distribution\":\""
+            << ycsb::distribution_name(opt.distribution) << "\",\"mode\":\"" << mode << "\",\"threads\":"
+            << opt.threads << ",\"inflight\":" << opt.inflight << ",\"value_size\":" << opt.value_size
+            << ",\"records\":" << opt.records << ",\"duration_s\":" << elapsed_s << ",\"ops\":" << total
+            << ",\"throughput_ops_per_sec\":" << throughput << ",\"operations\":{";
+        bool first = true;
+        for (int i = 0; i < static_cast<int>(ycsb::OpKind::COUNT); ++i)
+        {
+            const auto& s = rec.stats(static_cast<ycsb::OpKind>(i));
+            if (s.latency.count() == 0 && s.errors == 0) continue;
+            os << (first ? "" : ",") << "\"" << ycsb::op_name(static_cast<ycsb::OpKind>(i)) << "\":{"
+                << "\"count\":" << s.latency.count() << ",\"errors\":" << s.errors
+                << ",\"avg_us\":" << s.latency.mean();
+            for (const auto& [name, p] : REPORTED) os << ",\"" << name << "_us\":" << s.latency.percentile(p);
+            os << ",\"max_us\":" << s.latency.max() << ",\"uncorrected_p99_us\":" << s.service.percentile(99.0)
+                << "}";
+            first = false;
+        }
+        os << "}}\n";
+        return;
+    }
+
+    os << "label,workload,distribution,mode,threads,inflight,value_size,records,op,count,errors,"
+        "duration_s,throughput_ops_per_sec,avg_us,p50_us,p99_us,p999_us,p9999_us,max_us,uncorrected_p99_us\n";
+    for (int i = 0; i < static_cast<int>(ycsb::OpKind::COUNT); ++i)
+    {
+        const auto& s = rec.stats(static_cast<ycsb::OpKind>(i));
+        if (s.latency.count() == 0 && s.errors == 0) continue;
+        os << opt.label << ',' << w.name << ',' << ycsb::distribution_name(opt.distribution) << ',' << mode << ','
+            << opt.threads << ',' << opt.inflight << ',' << opt.value_size << ',' << opt.records << ','
+            << ycsb::op_name(static_cast<ycsb::OpKind>(i)) << ',' << s.latency.count() << ',' << s.errors << ','
+            << elapsed_s << ',' << s.latency.count() / elapsed_s << ',' << s.latency.mean();
+        for (const auto& entry : REPORTED) os << ',' << s.latency.percentile(entry.second);
+        os << ',' << s.latency.max() << ',' << s.service.percentile(99.0) << '\n';
+    }
+}
+
+// Save each op type's (corrected) histogram so runs can be merged later
+static bool write_histograms(const Options& opt, const Recorder& rec)
+{
+    for (int i = 0; i < static_cast<int>(ycsb::OpKind::COUNT); ++i)
+    {
+        const auto& s = rec.stats(static_cast<ycsb::OpKind>(i));
+        if (s.latency.count() == 0) continue;
+        std::string path = opt.hist_prefix + "." + ycsb::op_name(static_cast<ycsb::OpKind>(i)) + ".hgrm";
+        std::ofstream ofs(path);
+        s.latency.save(ofs);
+        if (!ofs)
+        {
+            std::cerr << "Failed to write " << path << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// --merge: combine histograms saved by earlier runs (e.g. one per client
+// process) and print the percentiles of the union
+static int merge_histograms(int argc, char* argv[])
+{
+    LatencyHistogram merged;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::ifstream ifs(argv[i]);
+        LatencyHistogram h;
+        if (!ifs || !LatencyHistogram::load(ifs, h) || !merged.merge(h))
+        {
+            std::cerr << "Cannot merge histogram: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    std::cout << "files,count,avg_us,p50_us,p99_us,p999_us,p9999_us,max_us\n"
+        << argc - 2 << ',' << merged.count() << ',' << merged.mean();
+    for (const auto& entry : REPORTED) std::cout << ',' << merged.percentile(entry.second);
+    std::cout << ',' << merged.max() << '\n';
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 3 && std::string(argv[1]) == "--merge") return merge_histograms(argc, argv);
+
+    Options opt;
+    if (!parse_args(argc, argv, opt))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    ycsb::Workload w;
+    if (!ycsb::workload(opt.workload, w))
+    {
+        std::cerr << "Unknown workload: " << opt.workload << "\n";
+        return 1;
+    }
+    if (!opt.distribution_set) opt.distribution = w.distribution;
+
+    KVClient::Options client_options;
+    client_options.near_cache = opt.near_cache;
+    client_options.hot_keys = opt.hot_keys;
+    KVClient kv(opt.client_id, opt.config_file, client_options);
+
+    if (opt.load)
+    {
+        auto t0 = BenchClock::now();
+        load(kv, opt);
+        std::cerr << "Loaded " << opt.records << " records in "
+            << std::chrono::duration<double>(BenchClock::now() - t0).count() << "s\n";
+    }
+
+    ycsb::KeyChooser keys(opt.distribution, opt.records);
+    Recorder rec;
+    std::atomic<int64_t> budget(static_cast<int64_t>(opt.ops));
+    auto start = BenchClock::now();
+    auto end = start + std::chrono::duration_cast<BenchClock::duration>(std::chrono::duration<double>(opt.duration_s));
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < opt.threads; ++t)
+    {
+        workers.emplace_back(run_thread, t, std::cref(opt), std::cref(w), std::ref(kv), std::ref(keys),
+                             std::ref(rec), std::ref(budget), end);
+    }
+    for (auto& t : workers) t.join();
+    double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+    if (opt.out.empty())
+    {
+        write_results(std::cout, opt, w, rec, elapsed);
+    }
+    else
+    {
+        std::ofstream ofs(opt.out);
+        write_results(ofs, opt, w, rec, elapsed);
+        std::cerr << "Results written to " << opt.out << "\n";
+    }
+    if (!opt.hist_prefix.empty() && write_histograms(opt, rec))
+    {
+        std::cerr << "Histograms written to " << opt.hist_prefix << ".<OP>.hgrm\n";
+    }
+    NearCache::Stats cache = kv.cache_stats();
+    if (cache.hits + cache.misses > 0)
+    {
+        std::cerr << (opt.near_cache ? "Near cache: " : "Hot-key cache: ") << cache.hits << " hits, "
+            << cache.misses << " misses, " << cache.invalidations << " invalidations\n";
+    }
+    kv.shutdown();
+    return 0;
+}
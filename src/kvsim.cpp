@@ -0,0 +1,146 @@
+/*
+ * File: kvsim.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Deterministic in-process cluster simulator
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include "sim.hpp"
+
+struct Options
+{
+    SimCluster::Options cluster;
+    uint64_t ops = 1000; // per client
+    std::string crash_id; // replica to crash, at crash_ms of virtual time
+    uint64_t crash_ms = 0;
+    std::string isolate_id; // replica to partition from everyone in [isolate_from_ms, isolate_to_ms)
+    uint64_t isolate_from_ms = 0;
+    uint64_t isolate_to_ms = 0;
+};
+
+static void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [options]\n"
+        "  --replicas=N             replicas r1..rN (default 3)\n"
+        "  --clients=N              closed-loop clients c1..cN (default 4)\n"
+        "  --ops=N                  requests per client (default 1000)\n"
+        "  --read-ratio=F           fraction of GETs, the rest PUTs (default 0.5)\n"
+        "  --cas-ratio=F            fraction of writes sent as CAS on the last version seen (default 0)\n"
+        "  --keys=N                 key space (default 100)\n"
+        "  --latency-us=U           one-way link latency (default 100)\n"
+        "  --jitter-us=U            uniform extra latency per message (default 0)\n"
+        "  --drop=F                 message loss probability (default 0)\n"
+        "  --timeout-us=U           client retry timeout (default 50000)\n"
+        "  --seed=S                 random seed (default 1)\n"
+        "  --crash=ID@MS            crash replica ID at MS of virtual time\n"
+        "  --isolate=ID@FROM-TO     partition replica ID from all others between FROM and TO ms\n";
+}
+
+static bool parse_args(int argc, char* argv[], Options& opt)
+{
+    opt.cluster.clients = 4;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string val = (eq == std::string::npos ? std::string() : arg.substr(eq + 1));
+        try
+        {
+            if (name == "--replicas") opt.cluster.replicas = std::stoi(val);
+            else if (name == "--clients") opt.cluster.clients = std::stoi(val);
+            else if (name == "--ops") opt.ops = std::stoull(val);
+            else if (name == "--read-ratio") opt.cluster.client.read_ratio = std::stod(val);
+            else if (name == "--cas-ratio") opt.cluster.client.cas_ratio = std::stod(val);
+            else if (name == "--keys") opt.cluster.client.key_space = std::stoull(val);
+            else if (name == "--latency-us") opt.cluster.link.latency_us = std::stoull(val);
+            else if (name == "--jitter-us") opt.cluster.link.jitter_us = std::stoull(val);
+            else if (name == "--drop") opt.cluster.link.drop_rate = std::stod(val);
+            else if (name == "--timeout-us") opt.cluster.client.timeout_us = std::stoull(val);
+            else if (name == "--seed") opt.cluster.seed = std::stoull(val);
+            else if (name == "--crash" && val.find('@') != std::string::npos)
+            {
+                opt.crash_id = val.substr(0, val.find('@'));
+                opt.crash_ms = std::stoull(val.substr(val.find('@') + 1));
+            }
+            else if (name == "--isolate" && val.find('@') != std::string::npos && val.find('-') != std::string::npos)
+            {
+                size_t at = val.find('@');
+                size_t dash = val.find('-', at);
+                opt.isolate_id = val.substr(0, at);
+                opt.isolate_from_ms = std::stoull(val.substr(at + 1, dash - at - 1));
+                opt.isolate_to_ms = std::stoull(val.substr(dash + 1));
+            }
+            else return false;
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+    return opt.cluster.replicas > 0 && opt.cluster.clients > 0 && opt.cluster.client.key_space > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!parse_args(argc, argv, opt))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SimCluster cluster(opt.cluster);
+    SimNetwork& net = cluster.network();
+    if (!opt.crash_id.empty())
+    {
+        std::string id = opt.crash_id;
+        net.schedule(opt.crash_ms * 1000, [&net, id] { net.crash(id); });
+    }
+    if (!opt.isolate_id.empty())
+    {
+        std::vector<std::string> others;
+        for (const auto& id : cluster.replica_ids())
+        {
+            if (id != opt.isolate_id) others.push_back(id);
+        }
+        std::vector<std::string> isolated{opt.isolate_id};
+        net.schedule(opt.isolate_from_ms * 1000, [&net, isolated, others] { net.partition(isolated, others); });
+        net.schedule(opt.isolate_to_ms * 1000, [&net] { net.heal(); });
+    }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    cluster.start(opt.ops);
+    uint64_t events = cluster.run();
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double virtual_s = net.now_us() / 1e6;
+
+    const SimNetwork::Stats& stats = net.stats();
+    std::cout << std::fixed << std::setprecision(1)
+              << "replicas=" << opt.cluster.replicas << " clients=" << opt.cluster.clients
+              << " seed=" << opt.cluster.seed << "\n"
+              << "completed: " << cluster.completed() << " requests, " << cluster.retries() << " retries, "
+              << cluster.cas_failed() << " failed CAS\n"
+              << "virtual time: " << net.now_us() / 1000.0 << " ms, "
+              << (virtual_s > 0 ? cluster.completed() / virtual_s : 0.0) << " requests/s simulated\n"
+              << "wall time: " << wall_s * 1000 << " ms, "
+              << (wall_s > 0 ? cluster.completed() / wall_s : 0.0) << " requests/s, "
+              << (wall_s > 0 ? events / wall_s : 0.0) << " events/s\n"
+              << "messages: " << stats.sent << " sent, " << stats.delivered << " delivered, "
+              << stats.dropped << " dropped, " << stats.refused << " refused\n";
+    for (size_t i = 0; i < cluster.replica_count(); ++i)
+    {
+        const Replica& r = cluster.replica(i);
+        std::cout << r.id() << (net.crashed(r.id()) ? " (crashed)" : "") << ": " << r.store().size()
+                  << " keys, " << r.store().pending_count() << " pending, fingerprint " << std::hex
+                  << r.store().fingerprint() << std::dec << "\n";
+    }
+    bool consistent = cluster.consistent();
+    std::cout << "replicas " << (consistent ? "consistent" : "DIVERGED") << "\n";
+    return (consistent && cluster.clients_done() ? 0 : 2);
+}
@@ -28,9 +28,14 @@ public:
     // Update the clock based on a received timestamp and return the new time
     uint64_t update(uint64_t received)
     {
+        // CAS loop so a concurrent tick() cannot be lost between load and store
         uint64_t current = counter.load();
-        uint64_t new_time = (received > current ? received : current) + 1;
-        counter.store(new_time);
+        uint64_t new_time;
+        do
+        {
+            new_time = (received > current ? received : current) + 1;
+        }
+        while (!counter.compare_exchange_weak(current, new_time));
         return new_time;
     }
 
@@ -0,0 +1,261 @@
+#include "logger.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace logging
+{
+    namespace detail
+    {
+        std::atomic<int> threshold{static_cast<int>(Level::INFO)};
+    }
+
+    static constexpr size_t MAX_FIELDS = 8;
+    static constexpr size_t TEXT_BYTES = 192; // string payloads of one record; longer values are cut
+    static constexpr size_t RING_RECORDS = 1024; // per thread, power of two
+
+    // Fixed-size binary record; strings are copied, formatting is deferred
+    struct Record
+    {
+        uint64_t wall_us;
+        const char* event;
+        uint64_t suppressed;
+        Level level;
+        uint8_t nfields;
+        uint16_t text_used;
+        struct
+        {
+            const char* key;
+            Field::Type type;
+            uint16_t off, len;
+            uint64_t num;
+        } fields[MAX_FIELDS];
+        char text[TEXT_BYTES];
+    };
+
+    // Single-producer (the owning thread), single-consumer (the writer) ring
+    struct Ring
+    {
+        std::unique_ptr<Record[]> records{new Record[RING_RECORDS]};
+        std::atomic<uint64_t> head{0}; // next record to write out
+        std::atomic<uint64_t> tail{0}; // next free slot
+        uint64_t thread_no = 0;
+    };
+
+    static std::mutex rings_mtx; // guards rings (registration and drain)
+    static std::vector<std::shared_ptr<Ring>> rings;
+    static std::atomic<uint64_t> dropped_records{0};
+
+    static std::mutex writer_mtx;
+    static std::condition_variable writer_cv;
+    static std::thread writer;
+    static bool writer_running = false;
+    static FILE* out = nullptr;
+    static std::string source_tag;
+
+    static Ring& thread_ring()
+    {
+        thread_local std::shared_ptr<Ring> ring;
+        if (!ring)
+        {
+            ring = std::make_shared<Ring>();
+            std::lock_guard<std::mutex> lock(rings_mtx);
+            ring->thread_no = rings.size();
+            rings.push_back(ring);
+        }
+        return *ring;
+    }
+
+    void write(Level level, const char* event, std::initializer_list<Field> fields, uint64_t suppressed)
+    {
+        Ring& ring = thread_ring();
+        uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+        if (tail - ring.head.load(std::memory_order_acquire) >= RING_RECORDS)
+        {
+            dropped_records.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& r = ring.records[tail & (RING_RECORDS - 1)];
+        r.wall_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        r.event = event;
+        r.suppressed = suppressed;
+        r.level = level;
+        r.nfields = 0;
+        r.text_used = 0;
+        for (const Field& f : fields)
+        {
+            if (r.nfields == MAX_FIELDS) break;
+            auto& rf = r.fields[r.nfields++];
+            rf.key = f.key;
+            rf.type = f.type;
+            if (f.type == Field::Type::STR)
+            {
+                size_t len = std::min(f.str.size(), TEXT_BYTES - r.text_used);
+                std::memcpy(r.text + r.text_used, f.str.data(), len);
+                rf.off = r.text_used;
+                rf.len = static_cast<uint16_t>(len);
+                r.text_used += len;
+            }
+            else
+            {
+                rf.num = (f.type == Field::Type::INT ? static_cast<uint64_t>(f.i) : f.u);
+            }
+        }
+        ring.tail.store(tail + 1, std::memory_order_release);
+    }
+
+    uint64_t dropped()
+    {
+        return dropped_records.load(std::memory_order_relaxed);
+    }
+
+    static const char* level_name(Level level)
+    {
+        static const char* names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+        return names[static_cast<int>(level)];
+    }
+
+    // logfmt-style line: time level [source] event key=value ...
+    static void format(std::string& line, const Record& r, uint64_t thread_no)
+    {
+        time_t secs = static_cast<time_t>(r.wall_us / 1000000);
+        tm parts;
+        localtime_r(&secs, &parts);
+        char stamp[64];
+        size_t n = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &parts);
+        std::snprintf(stamp + n, sizeof(stamp) - n, ".%06llu", static_cast<unsigned long long>(r.wall_us % 1000000));
+        line += stamp;
+        line += ' ';
+        line += level_name(r.level);
+        line += " [";
+        line += source_tag;
+        if (thread_no) line += "/" + std::to_string(thread_no);
+        line += "] ";
+        line += r.event;
+        for (uint8_t i = 0; i < r.nfields; ++i)
+        {
+            const auto& f = r.fields[i];
+            line += ' ';
+            line += f.key;
+            line += '=';
+            if (f.type == Field::Type::STR)
+            {
+                std::string_view v(r.text + f.off, f.len);
+                bool quote = v.empty() || v.find_first_of(" =\"") != std::string_view::npos;
+                if (quote) line += '"';
+                line += v;
+                if (quote) line += '"';
+            }
+            else if (f.type == Field::Type::INT)
+            {
+                line += std::to_string(static_cast<int64_t>(f.num));
+            }
+            else
+            {
+                line += std::to_string(f.num);
+            }
+        }
+        if (r.suppressed) line += " suppressed=" + std::to_string(r.suppressed);
+        line += '\n';
+    }
+
+    // Write out every ring's queued records; returns whether any were found
+    static bool drain()
+    {
+        std::string batch;
+        {
+            std::lock_guard<std::mutex> lock(rings_mtx);
+            for (auto& ring : rings)
+            {
+                uint64_t head = ring->head.load(std::memory_order_relaxed);
+                uint64_t tail = ring->tail.load(std::memory_order_acquire);
+                for (; head != tail; ++head)
+                {
+                    format(batch, ring->records[head & (RING_RECORDS - 1)], ring->thread_no);
+                }
+                ring->head.store(head, std::memory_order_release);
+            }
+        }
+        static uint64_t reported_drops = 0;
+        uint64_t drops = dropped();
+        if (drops != reported_drops)
+        {
+            batch += "log: " + std::to_string(drops - reported_drops) + " records dropped (ring full)\n";
+            reported_drops = drops;
+        }
+        if (batch.empty()) return false;
+        std::fwrite(batch.data(), 1, batch.size(), out);
+        std::fflush(out);
+        return true;
+    }
+
+    static void writer_loop()
+    {
+        std::unique_lock<std::mutex> lock(writer_mtx);
+        while (writer_running)
+        {
+            lock.unlock();
+            bool busy = drain();
+            lock.lock();
+            // Poll quickly while records keep arriving, lazily when idle
+            writer_cv.wait_for(lock, std::chrono::milliseconds(busy ? 1 : 20), [] { return !writer_running; });
+        }
+        lock.unlock();
+        drain();
+    }
+
+    bool init(const std::string& path, Level level, const std::string& source)
+    {
+        set_level(level);
+        source_tag = source;
+        out = (path.empty() ? stdout : std::fopen(path.c_str(), "a"));
+        if (!out)
+        {
+            std::perror("log file");
+            out = stdout;
+        }
+        std::lock_guard<std::mutex> lock(writer_mtx);
+        writer_running = true;
+        writer = std::thread(writer_loop);
+        return out != stdout || path.empty();
+    }
+
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(writer_mtx);
+            if (!writer_running) return;
+            writer_running = false;
+        }
+        writer_cv.notify_all();
+        if (writer.joinable()) writer.join();
+        if (out && out != stdout) std::fclose(out);
+        out = nullptr;
+    }
+
+    void set_level(Level level)
+    {
+        detail::threshold.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    bool parse_level(const std::string& name, Level& out_level)
+    {
+        static const char* names[] = {"trace", "debug", "info", "warn", "error", "off"};
+        for (int i = 0; i <= static_cast<int>(Level::OFF); ++i)
+        {
+            if (name == names[i])
+            {
+                out_level = static_cast<Level>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+} // namespace logging
@@ -0,0 +1,160 @@
+// logger.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <string>
+#include <string_view>
+#include <initializer_list>
+#include <type_traits>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Asynchronous structured logger. A log call copies its event name and
+// key=value fields into a fixed-size record in the calling thread's own
+// ring buffer (no locks, no formatting, never blocks: a full ring drops the
+// record and counts it); a background thread formats and writes the records.
+// A call below the current level costs one relaxed load and evaluates none
+// of its arguments.
+namespace logging
+{
+    enum class Level : int
+    {
+        TRACE = 0,
+        DEBUG,
+        INFO,
+        WARN,
+        ERROR,
+        OFF
+    };
+
+    // One key=value pair; keys must be string literals (stored by pointer)
+    struct Field
+    {
+        enum class Type : uint8_t
+        {
+            INT,
+            UINT,
+            STR
+        };
+
+        Field(const char* k, std::string_view v) : key(k), type(Type::STR), str(v) {}
+        Field(const char* k, const std::string& v) : key(k), type(Type::STR), str(v) {}
+        Field(const char* k, const char* v) : key(k), type(Type::STR), str(v ? v : "") {}
+
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+        Field(const char* k, T v) : key(k)
+        {
+            if constexpr (std::is_signed_v<T>)
+            {
+                type = Type::INT;
+                i = v;
+            }
+            else
+            {
+                type = Type::UINT;
+                u = v;
+            }
+        }
+
+        const char* key;
+        Type type;
+        union
+        {
+            int64_t i;
+            uint64_t u;
+        };
+        std::string_view str;
+    };
+
+    namespace detail
+    {
+        extern std::atomic<int> threshold;
+    }
+
+    /**
+     * Start the background writer. path "" writes to stdout; source tags
+     * every line (e.g. the replica id). Records logged before init() are kept
+     * in their rings and written once it runs.
+     */
+    bool init(const std::string& path, Level level, const std::string& source);
+
+    /**
+     * Write everything still buffered and stop the writer.
+     */
+    void shutdown();
+
+    void set_level(Level level);
+
+    // "trace" | "debug" | "info" | "warn" | "error" | "off"
+    bool parse_level(const std::string& name, Level& out);
+
+    inline bool enabled(Level level)
+    {
+        return static_cast<int>(level) >= detail::threshold.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Queue one record (use KV_LOG, which skips argument evaluation when the
+     * level is disabled). suppressed reports calls a rate limit dropped
+     * since the last record from the same call site.
+     */
+    void write(Level level, const char* event, std::initializer_list<Field> fields, uint64_t suppressed = 0);
+
+    // Records dropped because a thread's ring was full
+    uint64_t dropped();
+
+    // Per-call-site limit of per_second records; the rest are counted and
+    // reported on the next record that gets through
+    class RateLimiter
+    {
+    public:
+        explicit RateLimiter(uint64_t per_second) : per_second_(per_second) {}
+
+        bool allow(uint64_t& suppressed)
+        {
+            uint64_t now_s = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+            uint64_t window = window_.load(std::memory_order_relaxed);
+            if (now_s != window && window_.compare_exchange_strong(window, now_s, std::memory_order_relaxed))
+            {
+                count_.store(0, std::memory_order_relaxed);
+            }
+            if (count_.fetch_add(1, std::memory_order_relaxed) < per_second_)
+            {
+                suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+                return true;
+            }
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+    private:
+        uint64_t per_second_;
+        std::atomic<uint64_t> window_{0};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> suppressed_{0};
+    };
+} // namespace logging
+
+// KV_LOG(INFO, "event", {"key", value}, ...)
+#define KV_LOG(level, event, ...) \
+    do \
+    { \
+        if (logging::enabled(logging::Level::level)) \
+            logging::write(logging::Level::level, event, {__VA_ARGS__}); \
+    } while (0)
+
+// As KV_LOG, but at most per_second records per second from this call site
+#define KV_LOG_RATE(level, per_second, event, ...) \
+    do \
+    { \
+        static logging::RateLimiter kv_log_limiter_(per_second); \
+        uint64_t kv_log_suppressed_ = 0; \
+        if (logging::enabled(logging::Level::level) && kv_log_limiter_.allow(kv_log_suppressed_)) \
+            logging::write(logging::Level::level, event, {__VA_ARGS__}, kv_log_suppressed_); \
+    } while (0)
+
+#endif // LOGGER_HPP
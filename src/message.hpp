@@ -8,9 +8,13 @@
 #ifndef MESSAGE_HPP
 #define MESSAGE_HPP
 
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
 #include <string>
-#include <sstream>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 // Types of messages exchanged between client and replicas
 enum class MessageType
@@ -20,53 +24,223 @@ enum class MessageType
     MULTICAST_OP,
     ACK,
     COMMIT,
-    GET_RESPONSE
+    GET_RESPONSE,
+    MULTI_PUT_REQUEST,
+    MULTI_GET_REQUEST,
+    MULTI_GET_RESPONSE,
+    CAS_REQUEST,
+    INCR_REQUEST,
+    APPEND_REQUEST,
+    HEARTBEAT, // node liveness, consumed by the failure detector
+    BUSY, // overloaded replica did not admit the request (op_id); back off and retry
+    WATCH_REQUEST, // watch key (value "prefix": every key starting with key) for changes after version
+    UNWATCH_REQUEST, // drop the client's watch on key (and value) again
+    WATCH_RESPONSE, // watch registered, renewed or dropped (ok = false: refused)
+    WATCH_EVENT, // a watched key committed: key, value, version, timestamp (the commit's)
+    CACHE_INVALIDATE, // a key the client leased (GET with value "lease", or "hot" for a hot key) changed: key, new version
+    CLOSED, // coordinator op_id (its op prefix) has decided every op it stamped at or below timestamp;
+            // version: ops it has coordinated so far
+    COUNT // not a message: the number of types above; add new types before it
 };
 
+inline const char* message_type_name(MessageType type)
+{
+    static const char* names[] = {"PUT_REQUEST", "GET_REQUEST", "MULTICAST_OP", "ACK", "COMMIT",
+                                  "GET_RESPONSE", "MULTI_PUT_REQUEST", "MULTI_GET_REQUEST",
+                                  "MULTI_GET_RESPONSE", "CAS_REQUEST", "INCR_REQUEST", "APPEND_REQUEST",
+                                  "HEARTBEAT", "BUSY", "WATCH_REQUEST", "UNWATCH_REQUEST", "WATCH_RESPONSE",
+                                  "WATCH_EVENT", "CACHE_INVALIDATE", "CLOSED"};
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(MessageType::COUNT));
+    int i = static_cast<int>(type);
+    return (i >= 0 && i < static_cast<int>(sizeof(names) / sizeof(names[0])) ? names[i] : "UNKNOWN");
+}
+
 // Generic message struct with basic serialization/deserialization
 struct Message
 {
     MessageType type;
     std::string key;
     std::string value;
-    uint64_t timestamp; // Lamport timestamp or logical time
+    uint64_t timestamp = 0; // Hybrid logical timestamp (see hlc.hpp)
     std::string client_id; // Identifier for the client
     std::string replica_id; // Identifier for the replica (for ACKs)
     std::string op_id; // Unique operation ID
+    MessageType op = MessageType::PUT_REQUEST; // Client operation carried by a MULTICAST_OP
+    std::string expected; // CAS: value the key must currently hold
+    uint64_t version = 0; // CAS: version the key must hold (0 = compare value); key version in replies
+    bool ok = true; // Outcome of a conditional operation (or of a bounded read)
+    uint64_t max_staleness_ms = 0; // Bounded reads: oldest acceptable watermark age (0 = unbounded);
+                                   // in a GET_RESPONSE, the near-cache lease granted (ms)
+    uint64_t seq = 0; // Client write sequence number for retry deduplication (0 = untracked)
+    uint64_t trace_ns = 0; // Tracing: sender's monotonic stamp, echoed back in ACKs (0 = untraced)
+    uint64_t trace_hold_ns = 0; // Tracing: how long a follower held the op before ACKing
+    bool hot = false; // GET_RESPONSE: the key is read-hot on the replica (see HotKeys)
+    std::string error; // Replies: why the request was refused outright ("" = it was not)
+    // Key/value pairs for multi-key messages (keys only for MULTI_GET_REQUEST)
+    std::vector<std::pair<std::string, std::string>> entries;
+    uint64_t received_ns = 0; // Local monotonic arrival time, set by network (not serialized)
 
     // Serialize to a delimited string
     std::string serialize() const
     {
-        std::ostringstream oss;
-        oss << static_cast<int>(type) << '|' // message type
-            << key << '|' // key
-            << value << '|' // value
-            << timestamp << '|' // timestamp
-            << client_id << '|' // client ID
-            << replica_id << '|' // replica ID
-            << op_id; // operation ID
-        return oss.str();
+        std::string out;
+        write_fields(out);
+        return out;
+    }
+
+    // serialize() plus the newline that ends a frame on the wire, encoded
+    // in one buffer
+    std::string frame() const
+    {
+        std::string out;
+        write_fields(out);
+        out += '\n';
+        return out;
     }
 
-    // Deserialize from a delimited string
+    // Append the fields, '|'-delimited. Plain appends and to_chars: this
+    // runs for every message sent, and iostreams dominated its cost. String
+    // fields are escaped ('\\' as "\\\\", '|' as "\\p", '\n' as "\\n"), so they
+    // may hold any byte without splitting a field or a frame.
+    void write_fields(std::string& out) const
+    {
+        out.reserve(out.size() + 64 + key.size() + value.size() + client_id.size() + replica_id.size() +
+                    op_id.size() + expected.size() + error.size());
+        append_number(out, static_cast<int>(type)); // message type
+        append_field(out, key); // key
+        append_field(out, value); // value
+        append_number(out, timestamp); // timestamp
+        append_field(out, client_id); // client ID
+        append_field(out, replica_id); // replica ID
+        append_field(out, op_id); // operation ID
+        append_number(out, static_cast<int>(op)); // carried operation
+        append_field(out, expected); // CAS expected value
+        append_number(out, version); // version
+        append_number(out, ok ? 1 : 0); // outcome
+        append_number(out, max_staleness_ms); // staleness bound
+        append_number(out, seq); // client sequence number
+        append_number(out, trace_ns); // trace stamp
+        append_number(out, trace_hold_ns); // follower hold time
+        append_number(out, hot ? 1 : 0); // read-hot key
+        append_field(out, error); // refusal reason
+        append_number(out, entries.size(), false); // entry count
+        for (const auto& [k, v] : entries)
+        {
+            out += '|';
+            append_field(out, k, false); // entry key
+            out += '|';
+            append_field(out, v, false); // entry value
+        }
+    }
+
+    // Deserialize from a delimited string; throws std::invalid_argument on
+    // a malformed number or escape
     static Message deserialize(const std::string& data)
     {
         Message msg;
-        std::istringstream iss(data);
-        std::string token;
-
-        std::getline(iss, token, '|');
-        msg.type = static_cast<MessageType>(std::stoi(token));
-        std::getline(iss, msg.key, '|');
-        std::getline(iss, msg.value, '|');
-        std::getline(iss, token, '|');
-        msg.timestamp = std::stoull(token);
-        std::getline(iss, msg.client_id, '|');
-        std::getline(iss, msg.replica_id, '|');
-        std::getline(iss, msg.op_id, '|');
+        Reader in{data};
+
+        msg.type = static_cast<MessageType>(in.number<int>());
+        msg.key = in.field();
+        msg.value = in.field();
+        msg.timestamp = in.number<uint64_t>();
+        msg.client_id = in.field();
+        msg.replica_id = in.field();
+        msg.op_id = in.field();
+        msg.op = static_cast<MessageType>(in.number<int>());
+        msg.expected = in.field();
+        msg.version = in.number<uint64_t>();
+        msg.ok = (in.field() == "1");
+        msg.max_staleness_ms = in.number<uint64_t>();
+        msg.seq = in.number<uint64_t>();
+        msg.trace_ns = in.number<uint64_t>();
+        msg.trace_hold_ns = in.number<uint64_t>();
+        msg.hot = (in.field() == "1");
+        msg.error = in.field();
+        msg.entries.resize(in.number<size_t>());
+        for (auto& [k, v] : msg.entries)
+        {
+            k = in.field();
+            v = in.field();
+        }
 
         return msg;
     }
+
+private:
+    static void append_field(std::string& out, const std::string& field, bool delimit = true)
+    {
+        if (field.find_first_of("\\|\n") == std::string::npos)
+        {
+            out += field;
+        }
+        else
+        {
+            for (char c : field)
+            {
+                if (c == '\\') out += "\\\\";
+                else if (c == '|') out += "\\p";
+                else if (c == '\n') out += "\\n";
+                else out += c;
+            }
+        }
+        if (delimit) out += '|';
+    }
+
+    template <typename T>
+    static void append_number(std::string& out, T n, bool delimit = true)
+    {
+        char buf[24];
+        auto end = std::to_chars(buf, buf + sizeof(buf), n).ptr;
+        out.append(buf, end);
+        if (delimit) out += '|';
+    }
+
+    // Splits a serialized message at '|'; a missing field reads as empty
+    struct Reader
+    {
+        const std::string& data;
+        size_t pos = 0;
+
+        std::string field()
+        {
+            if (pos >= data.size()) return std::string();
+            size_t bar = data.find('|', pos);
+            if (bar == std::string::npos) bar = data.size();
+            std::string out = data.substr(pos, bar - pos);
+            pos = bar + 1;
+            if (out.find('\\') == std::string::npos) return out;
+            std::string plain;
+            plain.reserve(out.size());
+            for (size_t i = 0; i < out.size(); ++i)
+            {
+                if (out[i] != '\\')
+                {
+                    plain += out[i];
+                    continue;
+                }
+                char c = (++i < out.size() ? out[i] : '\0');
+                if (c == '\\') plain += '\\';
+                else if (c == 'p') plain += '|';
+                else if (c == 'n') plain += '\n';
+                else throw std::invalid_argument("message escape");
+            }
+            return plain;
+        }
+
+        template <typename T>
+        T number()
+        {
+            size_t begin = std::min(pos, data.size());
+            size_t bar = data.find('|', begin);
+            if (bar == std::string::npos) bar = data.size();
+            T n{};
+            auto [ptr, ec] = std::from_chars(data.data() + begin, data.data() + bar, n);
+            if (ec != std::errc() || ptr == data.data() + begin) throw std::invalid_argument("message field");
+            pos = bar + 1;
+            return n;
+        }
+    };
 };
 
 #endif // MESSAGE_HPP
@@ -0,0 +1,210 @@
+/*
+ * File: metrics.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Metrics registry with Prometheus text exposition
+*/
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+// Monotonic counter. Each thread increments its own cache-line-sized shard,
+// so hot-path increments are a single uncontended relaxed add; a scrape sums
+// the shards.
+class Counter
+{
+public:
+    void inc(uint64_t n = 1)
+    {
+        shards_[shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t sum = 0;
+        for (const auto& s : shards_) sum += s.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{0};
+    };
+
+    static size_t shard()
+    {
+        static std::atomic<size_t> next{0};
+        thread_local size_t mine = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return mine;
+    }
+
+    std::array<Shard, SHARDS> shards_;
+};
+
+// Point-in-time value (queue depths, table sizes), set by its owner
+class Gauge
+{
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t d) { value_.fetch_add(d, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Latency histogram with fixed power-of-two buckets from 10us to ~10.5s, as
+// Prometheus expects cumulative "le" buckets. Observations are relaxed
+// atomic adds, so it may be fed from any thread while being scraped.
+class MetricHistogram
+{
+public:
+    static constexpr size_t BUCKETS = 21; // upper bounds 10us << i
+
+    static uint64_t bound_us(size_t i) { return uint64_t{10} << i; }
+
+    void observe_us(uint64_t us)
+    {
+        size_t i = 0;
+        while (i < BUCKETS && us > bound_us(i)) ++i;
+        counts_[i].fetch_add(1, std::memory_order_relaxed); // counts_[BUCKETS] is +Inf
+        sum_us_.fetch_add(us, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+        uint64_t n = 0;
+        for (const auto& c : counts_) n += c.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    uint64_t bucket(size_t i) const { return counts_[i].load(std::memory_order_relaxed); }
+    uint64_t sum_us() const { return sum_us_.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS + 1> counts_{};
+    std::atomic<uint64_t> sum_us_{0};
+};
+
+// Named metrics of one process. Registration takes a lock and returns a
+// reference that stays valid for the registry's lifetime; updates through
+// that reference never touch the registry again. Series of one family share
+// a name and differ by their label string, e.g. type="PUT_REQUEST".
+class MetricsRegistry
+{
+public:
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "")
+    {
+        return add<Counter>(Kind::COUNTER, name, help, labels);
+    }
+
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "")
+    {
+        return add<Gauge>(Kind::GAUGE, name, help, labels);
+    }
+
+    // Latency histogram, exposed in seconds (name should end in _seconds)
+    MetricHistogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "")
+    {
+        return add<MetricHistogram>(Kind::HISTOGRAM, name, help, labels);
+    }
+
+    // Prometheus text exposition format, version 0.0.4
+    void write_prometheus(std::ostream& os) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::string family;
+        for (const auto& m : metrics_)
+        {
+            if (m->name != family)
+            {
+                family = m->name;
+                static const char* types[] = {"counter", "gauge", "histogram"};
+                os << "# HELP " << m->name << ' ' << m->help << '\n'
+                    << "# TYPE " << m->name << ' ' << types[static_cast<int>(m->kind)] << '\n';
+            }
+            std::string labels = (m->labels.empty() ? "" : "{" + m->labels + "}");
+            switch (m->kind)
+            {
+            case Kind::COUNTER:
+                os << m->name << labels << ' ' << static_cast<const Counter*>(m->metric.get())->value() << '\n';
+                break;
+            case Kind::GAUGE:
+                os << m->name << labels << ' ' << static_cast<const Gauge*>(m->metric.get())->value() << '\n';
+                break;
+            case Kind::HISTOGRAM:
+                write_histogram(os, *m, *static_cast<const MetricHistogram*>(m->metric.get()));
+                break;
+            }
+        }
+    }
+
+private:
+    enum class Kind
+    {
+        COUNTER = 0,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Entry
+    {
+        Kind kind;
+        std::string name, help, labels;
+        std::shared_ptr<void> metric;
+    };
+
+    template <typename T>
+    T& add(Kind kind, const std::string& name, const std::string& help, const std::string& labels)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto& m : metrics_)
+        {
+            if (m->name == name && m->labels == labels) return *static_cast<T*>(m->metric.get());
+        }
+        auto entry = std::make_unique<Entry>(Entry{kind, name, help, labels, std::make_shared<T>()});
+        T& metric = *static_cast<T*>(entry->metric.get());
+        // Keep each family's series together, as the exposition format requires
+        auto pos = metrics_.end();
+        for (auto it = metrics_.begin(); it != metrics_.end(); ++it)
+        {
+            if ((*it)->name == name) pos = it + 1;
+        }
+        metrics_.insert(pos, std::move(entry));
+        return metric;
+    }
+
+    static void write_histogram(std::ostream& os, const Entry& m, const MetricHistogram& h)
+    {
+        std::string prefix = (m.labels.empty() ? "" : m.labels + ",");
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < MetricHistogram::BUCKETS; ++i)
+        {
+            cumulative += h.bucket(i);
+            os << m.name << "_bucket{" << prefix << "le=\"" << MetricHistogram::bound_us(i) / 1e6 << "\"} "
+                << cumulative << '\n';
+        }
+        cumulative += h.bucket(MetricHistogram::BUCKETS);
+        std::string labels = (m.labels.empty() ? "" : "{" + m.labels + "}");
+        os << m.name << "_bucket{" << prefix << "le=\"+Inf\"} " << cumulative << '\n'
+            << m.name << "_sum" << labels << ' ' << h.sum_us() / 1e6 << '\n'
+            << m.name << "_count" << labels << ' ' << cumulative << '\n';
+    }
+
+    mutable std::mutex mtx_;
+    std::vector<std::unique_ptr<Entry>> metrics_;
+};
+
+#endif // METRICS_HPP
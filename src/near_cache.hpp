@@ -0,0 +1,163 @@
+/*
+ * File: near_cache.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Client-side cache of leased GET results
+*/
+#ifndef NEAR_CACHE_HPP
+#define NEAR_CACHE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// In-process LRU cache of GET results, kept fresh by the replicas'
+// invalidations (see WatchHub::lease). An entry is served until ttl_ms after
+// it was filled or until an invalidation for a newer version arrives,
+// whichever is first, so a lost invalidation costs at most ttl_ms of
+// staleness.
+//
+// Fills and invalidations race (a GET reply and the invalidation for the
+// commit after it come from different threads of the replica), so each key
+// remembers the lowest version it may be filled with: an invalidation raises
+// it, and a reply older than that is not cached. Thread-safe.
+class NearCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0; // entries dropped by a replica or a local write
+    };
+
+    NearCache(size_t capacity, uint64_t ttl_ms) : capacity_(std::max<size_t>(1, capacity)), ttl_ms_(ttl_ms) {}
+
+    // Cached value and version of key, if it is still fresh at now_ms
+    bool get(const std::string& key, uint64_t now_ms, std::string& value, uint64_t& version)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it == index_.end() || !it->second->valid || now_ms >= it->second->expires_ms)
+        {
+            ++stats_.misses;
+            return false;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        value = it->second->value;
+        version = it->second->version;
+        ++stats_.hits;
+        return true;
+    }
+
+    // A replica's reply, leased for lease_ms (the cache's ttl if shorter;
+    // 0: not cacheable, only hot is recorded)
+    void fill(const std::string& key, const std::string& value, uint64_t version, uint64_t lease_ms,
+              uint64_t now_ms, bool hot = false)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Entry& e = touch(key);
+        e.hot = hot;
+        if (version < e.min_version) return;
+        e.value = value;
+        e.version = version;
+        e.min_version = version;
+        e.valid = true;
+        e.expires_ms = now_ms + std::min(ttl_ms_, lease_ms);
+    }
+
+    // key changed to version (0: to some version newer than the cached one,
+    // as for this client's own writes before they commit)
+    void invalidate(const std::string& key, uint64_t version)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            // Remember the version in case a reply older than it is on its way
+            if (version == 0) return;
+            touch(key).min_version = version;
+            return;
+        }
+        Entry& e = *it->second;
+        // Already caching that version (the fill overtook the invalidation)
+        if (e.valid && version != 0 && e.version >= version) return;
+        if (e.valid) ++stats_.invalidations;
+        e.valid = false;
+        e.min_version = std::max(e.min_version, version != 0 ? version : e.version + 1);
+    }
+
+    // Whether the last reply for key said it is read-hot on the replicas
+    bool hot(const std::string& key) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        return it != index_.end() && it->second->hot;
+    }
+
+    // A reply for key no longer says it is hot
+    void cool(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = index_.find(key);
+        if (it != index_.end()) it->second->hot = false;
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return stats_;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return index_.size();
+    }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::string value;
+        uint64_t version = 0;
+        uint64_t min_version = 0; // replies older than this are not cached
+        uint64_t expires_ms = 0;
+        bool valid = false;
+        bool hot = false; // replicas reported the key read-hot
+    };
+
+    // The entry for key, most recently used, created (evicting the least
+    // recently used) if missing. Called with mtx_ held.
+    Entry& touch(const std::string& key)
+    {
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return *it->second;
+        }
+        if (index_.size() >= capacity_)
+        {
+            index_.erase(lru_.back().key);
+            lru_.pop_back();
+        }
+        lru_.push_front(Entry());
+        lru_.front().key = key;
+        index_[key] = lru_.begin();
+        return lru_.front();
+    }
+
+    size_t capacity_;
+    uint64_t ttl_ms_;
+    mutable std::mutex mtx_;
+    std::list<Entry> lru_; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    Stats stats_;
+};
+
+#endif // NEAR_CACHE_HPP
@@ -1,30 +1,196 @@
 #include "network.hpp"
+#include "trace.hpp"
+#include "uring.hpp"
+#include "shm_ring.hpp"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <climits>
+#include <iterator>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 
 namespace network
 {
     static std::unordered_map<std::string, std::string> id_addr_map;
     static int listen_sock = -1;
+    static std::string listen_path; // Unix domain socket we bound, removed on shutdown
     static std::vector<std::string> peers;
 
     static std::thread listener_thread;
     static std::mutex mtx;
     static std::condition_variable cv;
     static std::queue<Message> msg_queue;
-    static bool running = false;
+    static std::atomic<size_t> queued{0}; // msg_queue.size(), readable without mtx
+    static std::atomic<bool> running{false};
+    static InboundHandler inbound_handler; // set once; guarded by mtx
+    static std::mutex handler_mtx; // one inbound_handler call at a time
+    // Self-pipe that wakes the listener on shutdown
+    static int wake_pipe[2] = {-1, -1};
+
+    static IoBackend backend = IoBackend::EPOLL; // requested, then in use once init() returns
+    static std::unique_ptr<IoUring> uring;
+    static std::unique_ptr<UringBufferRing> uring_bufs;
+    static constexpr unsigned URING_ENTRIES = 256;
+    static constexpr unsigned URING_FILES = 1024; // direct descriptors, i.e. inbound connections
+    static constexpr unsigned URING_BUFFERS = 256; // power of two
+    static constexpr unsigned URING_BUFFER_BYTES = 16 * 1024;
+    static constexpr uint16_t URING_BUFFER_GROUP = 0;
+
+    // io_uring user_data: operation in the high word, fixed-file slot in the low
+    enum : uint64_t
+    {
+        OP_ACCEPT = 1,
+        OP_WAKE,
+        OP_RECV,
+        OP_CLOSE
+    };
+
+    static std::string self_addr;
+    static std::unordered_set<std::string> shm_addrs; // config entries marked "shm"
+    static std::atomic<uint64_t> shm_seq{0};
+    static std::atomic<size_t> shm_open{0};
+    // Control frame opening a shared-memory channel: "SHM <segment> <sender host:port>"
+    static const std::string SHM_HELLO = "SHM ";
+
+    class ShmChannel;
+
+    // Bytes read from one inbound connection (or shared-memory ring) that do
+    // not yet form a whole frame
+    struct Inbound
+    {
+        std::string buffered;
+        std::shared_ptr<ShmChannel> shm; // channel the peer opened over this connection
+        ~Inbound();
+    };
+
+    static void deliver(Inbound& in, const char* data, size_t len);
+
+    // Frames to and from a co-located peer through a ShmSegment. The TCP
+    // connection that carried the hello stays open: its closing tells the
+    // accepting side that the peer is gone. A thread per channel drains the
+    // inbound ring.
+    class ShmChannel
+    {
+    public:
+        explicit ShmChannel(std::unique_ptr<ShmSegment> segment) : segment_(std::move(segment))
+        {
+            ++shm_open;
+            reader_ = std::thread([this] { read_loop(); });
+        }
+
+        ~ShmChannel()
+        {
+            close();
+            reader_.join();
+            --shm_open;
+        }
+
+        bool attached() const { return segment_->attached(); }
+
+        // Peer attached and the channel not closed by either side
+        bool ready() const { return segment_->attached() && !segment_->closed(); }
+
+        /**
+         * Write frame, in pieces when it is larger than a ring slice, waiting
+         * as long as the ring stays full: a frame must not overtake earlier
+         * ones by going another way. False once the channel closes or gone()
+         * says the peer is; the peer never reads the rest then.
+         */
+        template <typename Gone>
+        bool send(const std::string& frame, Gone gone)
+        {
+            size_t off = 0;
+            while (off < frame.size())
+            {
+                size_t len = std::min(frame.size() - off, SLICE_BYTES);
+                if (segment_->write(frame.data() + off, len, /*timeout_ms=*/100))
+                {
+                    off += len;
+                    continue;
+                }
+                if (segment_->closed() || gone()) return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if (!stop_.exchange(true)) segment_->close_segment();
+        }
+
+    private:
+        void read_loop()
+        {
+            Inbound in;
+            std::string chunk;
+            while (!stop_)
+            {
+                if (segment_->read(chunk, /*timeout_ms=*/100) == 0)
+                {
+                    if (segment_->closed()) break;
+                    continue;
+                }
+                deliver(in, chunk.data(), chunk.size());
+                chunk.clear();
+            }
+        }
+
+        // Readers reassemble frames from the byte stream, so a frame may
+        // cross the ring in several writes
+        static constexpr size_t SLICE_BYTES = ShmSegment::RING_BYTES / 4;
+
+        std::unique_ptr<ShmSegment> segment_;
+        std::atomic<bool> stop_{false};
+        std::thread reader_;
+    };
+
+    Inbound::~Inbound()
+    {
+        if (shm) shm->close();
+    }
+
+    // Outbound connection to one destination, kept open and reused across sends
+    struct Connection
+    {
+        std::mutex mtx;
+        int fd = -1;
+        std::shared_ptr<ShmChannel> shm; // used instead of fd once ready; guarded by mtx
+        // Channel the destination opened to us, handed over by the listener
+        std::mutex offer_mtx;
+        std::shared_ptr<ShmChannel> offered;
+        std::atomic<bool> has_offer{false};
+    };
+    static std::mutex conn_mtx;
+    static std::unordered_map<std::string, std::unique_ptr<Connection>> connections;
+    // Outbound totals for send_stats()
+    static std::atomic<uint64_t> frames_sent{0};
+    static std::atomic<uint64_t> writes{0};
+    // Limits on what a send batch holds back for one destination
+    static constexpr size_t COALESCE_MAX_BYTES = 64 * 1024;
+    static constexpr auto COALESCE_MAX_DELAY = std::chrono::microseconds(200);
+    // How long a fresh connection waits for the peer to attach its offer
+    static constexpr auto SHM_ATTACH_WAIT = std::chrono::milliseconds(200);
 
     // Helper: split "host:port"
     static void split_host_port(const std::string& hp, std::string& host, int& port)
@@ -34,12 +200,384 @@ namespace network
         port = std::stoi(hp.substr(pos + 1));
     }
 
+    // Addresses of the form "unix:<path>" name a Unix domain socket
+    static const std::string UNIX_PREFIX = "unix:";
+
+    static bool is_unix(const std::string& addr)
+    {
+        return addr.rfind(UNIX_PREFIX, 0) == 0;
+    }
+
+    // False when the path does not fit in sun_path
+    static bool unix_sockaddr(const std::string& addr, sockaddr_un& out)
+    {
+        std::string path = addr.substr(UNIX_PREFIX.size());
+        if (path.empty() || path.size() >= sizeof(out.sun_path)) return false;
+        out = sockaddr_un{};
+        out.sun_family = AF_UNIX;
+        std::memcpy(out.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    static Connection* connection(const std::string& dest_addr)
+    {
+        std::lock_guard<std::mutex> lock(conn_mtx);
+        auto& slot = connections[dest_addr];
+        if (!slot) slot = std::make_unique<Connection>();
+        return slot.get();
+    }
+
+    // Attach the segment named in a hello and use it for our replies to the
+    // sender as well
+    static void accept_shm(Inbound& in, const std::string& hello)
+    {
+        std::istringstream iss(hello.substr(SHM_HELLO.size()));
+        std::string name, reply_addr;
+        iss >> name >> reply_addr;
+        if (name.rfind("/kvstore-", 0) != 0 || reply_addr.empty()) return;
+        auto segment = ShmSegment::attach(name);
+        if (!segment)
+        {
+            std::cerr << "Cannot attach shared memory " << name << " from " << reply_addr << "\n";
+            return;
+        }
+        in.shm = std::make_shared<ShmChannel>(std::move(segment));
+        Connection* conn = connection(reply_addr);
+        std::lock_guard<std::mutex> lock(conn->offer_mtx);
+        conn->offered = in.shm;
+        conn->has_offer.store(true, std::memory_order_release);
+    }
+
+    // Append bytes read from a connection and queue every complete
+    // newline-terminated frame; a trailing partial frame stays buffered
+    static void deliver(Inbound& in, const char* data, size_t len)
+    {
+        std::string& buffered = in.buffered;
+        buffered.append(data, len);
+        std::vector<Message> batch;
+        size_t start = 0, nl;
+        while ((nl = buffered.find('\n', start)) != std::string::npos)
+        {
+            if (buffered.compare(start, SHM_HELLO.size(), SHM_HELLO) == 0)
+            {
+                accept_shm(in, buffered.substr(start, nl - start));
+            }
+            else if (nl > start)
+            {
+                // A malformed frame is dropped; the frames around it are fine
+                try
+                {
+                    batch.push_back(Message::deserialize(buffered.substr(start, nl - start)));
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "Dropping malformed frame (" << nl - start << " bytes): " << e.what() << "\n";
+                }
+            }
+            start = nl + 1;
+        }
+        buffered.erase(0, start);
+        if (batch.empty()) return;
+        uint64_t now = PhaseTracer::now_ns();
+        for (auto& msg : batch) msg.received_ns = now;
+        std::unique_lock<std::mutex> lock(mtx);
+        if (inbound_handler)
+        {
+            // The handler is never replaced once set, so it runs without
+            // mtx; the listener and shared-memory readers take turns
+            lock.unlock();
+            std::lock_guard<std::mutex> turn(handler_mtx);
+            for (auto& msg : batch) inbound_handler(std::move(msg));
+            return;
+        }
+        for (auto& msg : batch) msg_queue.push(std::move(msg));
+        queued.store(msg_queue.size(), std::memory_order_relaxed);
+        lock.unlock();
+        cv.notify_all();
+    }
+
+    // Accept connections and read frames from all of them with one epoll loop.
+    // Senders keep their connections open, so each carries many messages.
+    static void epoll_listener_loop()
+    {
+        int ep = epoll_create1(EPOLL_CLOEXEC);
+        if (ep < 0)
+        {
+            perror("epoll_create1");
+            return;
+        }
+        auto watch = [ep](int fd)
+        {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) perror("epoll_ctl");
+        };
+        watch(listen_sock);
+        watch(wake_pipe[0]);
+        std::unordered_map<int, Inbound> inbound; // by fd
+        epoll_event events[64];
+        char buf[64 * 1024];
+        bool stop = false;
+        while (running && !stop)
+        {
+            int n = epoll_wait(ep, events, 64, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                perror("epoll_wait");
+                break;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == wake_pipe[0])
+                {
+                    stop = true; // shutdown requested
+                }
+                else if (fd == listen_sock)
+                {
+                    int client_fd = accept4(listen_sock, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (client_fd >= 0)
+                    {
+                        inbound[client_fd];
+                        watch(client_fd);
+                    }
+                    else if (running)
+                    {
+                        perror("accept");
+                    }
+                }
+                else
+                {
+                    ssize_t len = read(fd, buf, sizeof(buf));
+                    if (len <= 0)
+                    {
+                        close(fd); // also drops it from the epoll set
+                        inbound.erase(fd);
+                        continue;
+                    }
+                    deliver(inbound[fd], buf, len);
+                }
+            }
+        }
+        for (const auto& kv : inbound) close(kv.first);
+        close(ep);
+    }
+
+    // Ring, fixed-file table and receive buffers for the io_uring listener.
+    // Needs multishot accept and recv (Linux 6.0, the release that also
+    // added SEND_ZC, which is what we probe for); false means use epoll.
+    static bool uring_setup()
+    {
+        auto ring = std::make_unique<IoUring>();
+        if (!ring->init(URING_ENTRIES, IORING_SETUP_COOP_TASKRUN) && !ring->init(URING_ENTRIES)) return false;
+        if (!ring->supports(IORING_OP_SEND_ZC)) return false;
+        if (!ring->register_sparse_files(URING_FILES)) return false;
+        auto bufs = std::make_unique<UringBufferRing>();
+        if (!bufs->init(*ring, URING_BUFFER_GROUP, URING_BUFFERS, URING_BUFFER_BYTES)) return false;
+        uring = std::move(ring);
+        uring_bufs = std::move(bufs);
+        return true;
+    }
+
+    // Free SQE, flushing queued ones to the kernel if the ring is full
+    static io_uring_sqe* uring_sqe()
+    {
+        io_uring_sqe* sqe;
+        while (!(sqe = uring->get_sqe())) uring->submit_and_wait(0);
+        return sqe;
+    }
+
+    // One accept SQE keeps producing a CQE per connection; each new socket
+    // goes straight into the fixed-file table and never gets a regular fd
+    static void uring_arm_accept()
+    {
+        io_uring_sqe* sqe = uring_sqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listen_sock;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->file_index = IORING_FILE_INDEX_ALLOC; // direct descriptors are never inherited; no SOCK_CLOEXEC
+        sqe->user_data = OP_ACCEPT << 32;
+    }
+
+    // Multishot recv on a direct descriptor, into kernel-chosen buffers
+    static void uring_arm_recv(uint32_t slot)
+    {
+        io_uring_sqe* sqe = uring_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = static_cast<int>(slot);
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = uring_bufs->group();
+        sqe->user_data = OP_RECV << 32 | slot;
+    }
+
+    static void uring_close(uint32_t slot)
+    {
+        io_uring_sqe* sqe = uring_sqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->file_index = slot + 1;
+        sqe->user_data = OP_CLOSE << 32 | slot;
+    }
+
+    // Same job as the epoll loop, but the SQEs queued while handling one
+    // batch of completions go to the kernel with the wait for the next, in
+    // a single io_uring_enter()
+    static void uring_listener_loop()
+    {
+        std::unordered_map<uint32_t, Inbound> inbound; // by fixed-file slot
+        uring_arm_accept();
+        io_uring_sqe* wake = uring_sqe();
+        wake->opcode = IORING_OP_POLL_ADD;
+        wake->fd = wake_pipe[0];
+        wake->poll32_events = POLLIN;
+        wake->user_data = OP_WAKE << 32;
+        bool stop = false;
+        while (running && !stop)
+        {
+            int rc = uring->submit_and_wait(1);
+            if (rc < 0 && rc != -EBUSY)
+            {
+                errno = -rc;
+                perror("io_uring_enter");
+                break;
+            }
+            uring->drain([&](const io_uring_cqe& cqe)
+            {
+                uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+                bool more = cqe.flags & IORING_CQE_F_MORE;
+                switch (cqe.user_data >> 32)
+                {
+                case OP_WAKE:
+                    stop = true; // shutdown requested
+                    break;
+                case OP_ACCEPT:
+                    if (cqe.res >= 0)
+                    {
+                        inbound[cqe.res];
+                        uring_arm_recv(cqe.res);
+                    }
+                    else if (running)
+                    {
+                        errno = -cqe.res;
+                        perror("accept");
+                    }
+                    // EINVAL would come back on every retry
+                    if (!more && cqe.res != -EINVAL) uring_arm_accept();
+                    break;
+                case OP_RECV:
+                    if (cqe.res > 0)
+                    {
+                        uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                        deliver(inbound[slot], uring_bufs->data(bid), cqe.res);
+                        uring_bufs->recycle(bid);
+                        if (!more) uring_arm_recv(slot);
+                    }
+                    else if (cqe.res == -ENOBUFS)
+                    {
+                        uring_arm_recv(slot); // buffers were recycled above
+                    }
+                    else
+                    {
+                        inbound.erase(slot);
+                        uring_close(slot);
+                    }
+                    break;
+                default:
+                    break;
+                }
+            });
+        }
+        // Closing the ring (in shutdown) cancels what is in flight and
+        // closes every direct descriptor
+    }
+
+    // Socket address of one destination, resolved once and reused by every
+    // connect; only a failed connect makes it eligible for re-resolution,
+    // at most once per RESOLVE_RETRY, so a dead or misnamed peer cannot
+    // turn retries into a resolver storm
+    struct Endpoint
+    {
+        sockaddr_storage addr{};
+        socklen_t len = 0; // 0: not resolved (yet)
+        bool stale = false;
+        std::chrono::steady_clock::time_point resolved_at;
+    };
+    static std::mutex endpoint_mtx;
+    static std::unordered_map<std::string, Endpoint> endpoints; // by "host:port" / "unix:<path>"
+    static constexpr auto RESOLVE_RETRY = std::chrono::seconds(1);
+
+    static bool resolve(const std::string& dest_addr, Endpoint& out)
+    {
+        out.resolved_at = std::chrono::steady_clock::now();
+        out.stale = false;
+        out.len = 0;
+        if (is_unix(dest_addr))
+        {
+            sockaddr_un& sun = reinterpret_cast<sockaddr_un&>(out.addr);
+            if (!unix_sockaddr(dest_addr, sun))
+            {
+                std::cerr << "Bad Unix socket path: " << dest_addr << "\n";
+                return false;
+            }
+            out.len = sizeof(sun);
+            return true;
+        }
+        std::string host;
+        int port;
+        split_host_port(dest_addr, host, port);
+        addrinfo hints{}, *res;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+        if (rc != 0)
+        {
+            std::cerr << "getaddrinfo " << host << ": " << gai_strerror(rc) << "\n";
+            return false;
+        }
+        std::memcpy(&out.addr, res->ai_addr, res->ai_addrlen);
+        out.len = res->ai_addrlen;
+        freeaddrinfo(res);
+        return true;
+    }
+
+    // Cached address of dest_addr, resolving it first if never done or
+    // marked stale long enough ago; false if it does not resolve
+    static bool lookup_endpoint(const std::string& dest_addr, Endpoint& out)
+    {
+        {
+            std::lock_guard<std::mutex> lock(endpoint_mtx);
+            auto it = endpoints.find(dest_addr);
+            if (it != endpoints.end())
+            {
+                out = it->second;
+                bool retry = (out.stale || out.len == 0) &&
+                    std::chrono::steady_clock::now() - out.resolved_at >= RESOLVE_RETRY;
+                if (!retry) return out.len > 0;
+            }
+        }
+        // Resolve without the lock; a slow DNS answer holds up only this send
+        resolve(dest_addr, out);
+        std::lock_guard<std::mutex> lock(endpoint_mtx);
+        endpoints[dest_addr] = out;
+        return out.len > 0;
+    }
+
+    static void mark_stale(const std::string& dest_addr)
+    {
+        std::lock_guard<std::mutex> lock(endpoint_mtx);
+        auto it = endpoints.find(dest_addr);
+        if (it != endpoints.end()) it->second.stale = true;
+    }
+
     void init(const std::string& node_id,
               const std::string& config_file,
               std::vector<std::string>& out_peers,
               int& out_port)
     {
         id_addr_map.clear();
+        shm_addrs.clear();
         out_peers.clear();
 
         // Read config
@@ -54,11 +592,18 @@ namespace network
         {
             if (line.empty()) continue;
             std::istringstream iss(line);
-            std::string id, host;
-            int port;
-            iss >> id >> host >> port;
-            std::string addr = host + ":" + std::to_string(port);
+            std::string id, host, transport;
+            iss >> id >> host;
+            std::string addr = host;
+            if (!is_unix(host))
+            {
+                int port;
+                iss >> port;
+                addr = host + ":" + std::to_string(port);
+            }
+            iss >> transport;
             id_addr_map[id] = addr;
+            if (transport == "shm") shm_addrs.insert(addr);
         }
 
         // Determine self listen port
@@ -68,11 +613,12 @@ namespace network
             std::cerr << "Node ID not found in config: " << node_id << "\n";
             std::exit(1);
         }
+        self_addr = self_it->second;
+        out_port = 0;
+        if (!is_unix(self_addr))
         {
             std::string host_self;
-            int port_self;
-            split_host_port(self_it->second, host_self, port_self);
-            out_port = port_self;
+            split_host_port(self_addr, host_self, out_port);
         }
 
         // Populate peers (addresses) excluding self
@@ -83,64 +629,98 @@ namespace network
         }
         peers = out_peers;
 
+        // Resolve every address now so sends never wait on the resolver;
+        // failures are retried on first use
+        {
+            std::lock_guard<std::mutex> lock(endpoint_mtx);
+            endpoints.clear();
+        }
+        for (const auto& addr : out_peers)
+        {
+            Endpoint ep;
+            resolve(addr, ep);
+            std::lock_guard<std::mutex> lock(endpoint_mtx);
+            endpoints[addr] = ep;
+        }
+
         // Create listening socket
-        listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_storage addr{};
+        socklen_t addr_len;
+        if (is_unix(self_addr))
+        {
+            sockaddr_un& sun = reinterpret_cast<sockaddr_un&>(addr);
+            if (!unix_sockaddr(self_addr, sun))
+            {
+                std::cerr << "Bad Unix socket path: " << self_addr << "\n";
+                std::exit(1);
+            }
+            listen_path = sun.sun_path;
+            unlink(listen_path.c_str()); // left behind by an earlier run
+            addr_len = sizeof(sun);
+        }
+        else
+        {
+            sockaddr_in& sin = reinterpret_cast<sockaddr_in&>(addr);
+            sin.sin_family = AF_INET;
+            sin.sin_addr.s_addr = INADDR_ANY;
+            sin.sin_port = htons(out_port);
+            addr_len = sizeof(sin);
+        }
+        listen_sock = socket(addr.ss_family, SOCK_STREAM, 0);
         if (listen_sock < 0)
         {
             perror("socket");
             std::exit(1);
         }
         int opt = 1;
-        setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-
-        sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        addr.sin_port = htons(out_port);
+        if (addr.ss_family == AF_INET) setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
-        if (bind(listen_sock, (sockaddr*)&addr, sizeof(addr)) < 0)
+        if (bind(listen_sock, (sockaddr*)&addr, addr_len) < 0)
         {
             perror("bind");
             std::exit(1);
         }
-        if (listen(listen_sock, 10) < 0)
+        if (listen(listen_sock, SOMAXCONN) < 0)
         {
             perror("listen");
             std::exit(1);
         }
 
-        running = true;
-        listener_thread = std::thread([]()
+        if (pipe(wake_pipe) < 0)
         {
-            while (running)
-            {
-                sockaddr_in cli_addr;
-                socklen_t cli_len = sizeof(cli_addr);
-                int client_fd = accept(listen_sock, (sockaddr*)&cli_addr, &cli_len);
-                if (client_fd < 0)
-                {
-                    if (!running) break;
-                    perror("accept");
-                    continue;
-                }
-                std::string data;
-                char ch;
-                while (read(client_fd, &ch, 1) == 1)
-                {
-                    if (ch == '\n') break;
-                    data.push_back(ch);
-                }
-                close(client_fd);
-                if (!data.empty())
-                {
-                    Message msg = Message::deserialize(data);
-                    std::unique_lock<std::mutex> lock(mtx);
-                    msg_queue.push(msg);
-                    lock.unlock();
-                    cv.notify_one();
-                }
-            }
-        });
+            perror("pipe");
+            std::exit(1);
+        }
+        if (backend == IoBackend::IO_URING && !uring_setup())
+        {
+            std::cerr << "io_uring unavailable, using epoll\n";
+            backend = IoBackend::EPOLL;
+        }
+        running = true;
+        listener_thread = std::thread(backend == IoBackend::IO_URING ? uring_listener_loop : epoll_listener_loop);
+    }
+
+    void set_io_backend(IoBackend b)
+    {
+        backend = b;
+    }
+
+    IoBackend io_backend()
+    {
+        return backend;
+    }
+
+    const char* io_backend_name(IoBackend b)
+    {
+        return b == IoBackend::IO_URING ? "io_uring" : "epoll";
+    }
+
+    bool parse_io_backend(const std::string& name, IoBackend& out)
+    {
+        if (name == "epoll") out = IoBackend::EPOLL;
+        else if (name == "io_uring") out = IoBackend::IO_URING;
+        else return false;
+        return true;
     }
 
     std::string get_addr(const std::string& node_id)
@@ -149,45 +729,304 @@ namespace network
         return (it == id_addr_map.end() ? std::string() : it->second);
     }
 
-    bool send_message(const std::string& dest_addr, const Message& msg)
+    // Open a connection to "host:port" or "unix:<path>" (-1 on failure)
+    static int connect_to(const std::string& dest_addr)
     {
-        std::string host;
-        int port;
-        split_host_port(dest_addr, host, port);
-        addrinfo hints{}, *res;
-        hints.ai_family = AF_INET;
-        hints.ai_socktype = SOCK_STREAM;
-        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0)
-        {
-            perror("getaddrinfo");
-            return false;
-        }
-        int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        Endpoint ep;
+        if (!lookup_endpoint(dest_addr, ep)) return -1;
+        int sock = socket(ep.addr.ss_family, SOCK_STREAM, 0);
         if (sock < 0)
         {
             perror("socket");
-            freeaddrinfo(res);
-            return false;
+            return -1;
         }
-        if (connect(sock, res->ai_addr, res->ai_addrlen) < 0)
+        if (connect(sock, (sockaddr*)&ep.addr, ep.len) < 0)
         {
             perror("connect");
             close(sock);
-            freeaddrinfo(res);
-            return false;
+            mark_stale(dest_addr);
+            return -1;
         }
-        freeaddrinfo(res);
-        std::string out = msg.serialize() + "\n";
-        if (write(sock, out.c_str(), out.size()) < 0)
+        if (ep.addr.ss_family == AF_INET)
+        {
+            // Frames are small and latency-bound; do not let Nagle hold them back
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return sock;
+    }
+
+    // Receivers never write on our outbound connections, so any readable
+    // event means the peer closed it (e.g. the process died)
+    static bool peer_closed(int fd)
+    {
+        pollfd p{fd, POLLIN | POLLRDHUP, 0};
+        return poll(&p, 1, 0) > 0 && p.revents != 0;
+    }
+
+    static bool write_all(int fd, const std::string& data)
+    {
+        size_t off = 0;
+        while (off < data.size())
+        {
+            ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            off += n;
+        }
+        return true;
+    }
+
+    // Over a fresh TCP connection to a destination marked "shm", offer a
+    // shared-memory channel and wait for the peer to attach it, so that no
+    // frame goes over TCP after the hello: one could still be unread on the
+    // socket when a later one arrives through the ring. A peer that does not
+    // attach in time (on another host, it never can) keeps TCP for the
+    // connection's lifetime.
+    static void offer_shm(Connection& conn, const std::string& dest_addr)
+    {
+        if (conn.shm || !shm_addrs.count(dest_addr) || dest_addr == self_addr) return;
+        std::string name = "/kvstore-" + std::to_string(getpid()) + "-" + std::to_string(++shm_seq);
+        auto segment = ShmSegment::create(name);
+        if (!segment)
+        {
+            perror("shm_open");
+            return;
+        }
+        auto channel = std::make_shared<ShmChannel>(std::move(segment));
+        if (!write_all(conn.fd, SHM_HELLO + name + " " + self_addr + "\n")) return;
+        auto deadline = std::chrono::steady_clock::now() + SHM_ATTACH_WAIT;
+        while (!channel->attached())
+        {
+            if (std::chrono::steady_clock::now() > deadline || peer_closed(conn.fd))
+            {
+                channel->close();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        conn.shm = std::move(channel);
+    }
+
+    // Write frames[0, n) with as few sendmsg calls as IOV_MAX allows; on
+    // failure done is the number of frames fully written
+    static bool write_frames(int fd, const std::string* frames, size_t n, size_t& done)
+    {
+        done = 0;
+        size_t off = 0; // into frames[done]
+        iovec iov[IOV_MAX];
+        while (done < n)
+        {
+            int count = 0;
+            for (size_t i = done; i < n && count < IOV_MAX; ++i, ++count)
+            {
+                size_t skip = (i == done ? off : 0);
+                iov[count].iov_base = const_cast<char*>(frames[i].data()) + skip;
+                iov[count].iov_len = frames[i].size() - skip;
+            }
+            msghdr mh{};
+            mh.msg_iov = iov;
+            mh.msg_iovlen = count;
+            ssize_t sent = sendmsg(fd, &mh, MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            writes.fetch_add(1, std::memory_order_relaxed);
+            size_t left = static_cast<size_t>(sent);
+            while (done < n && left >= frames[done].size() - off)
+            {
+                left -= frames[done].size() - off;
+                off = 0;
+                ++done;
+            }
+            off += left;
+        }
+        return true;
+    }
+
+    // Take over a shared-memory channel the destination offered, if any,
+    // unless a TCP connection to it is open: frames sent on it could still
+    // be unread when later ones arrive through the ring. Caller holds
+    // conn.mtx.
+    static void adopt_offer(Connection& conn)
+    {
+        if (!conn.has_offer.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> offer_lock(conn.offer_mtx);
+        if (!conn.shm && conn.fd < 0 && conn.offered && conn.offered->ready()) conn.shm = std::move(conn.offered);
+        conn.offered.reset();
+        conn.has_offer.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * Send frames[0, n) to dest_addr, in order: through the shared-memory
+     * channel when there is one, otherwise over the TCP (or Unix)
+     * connection, reconnecting once if the cached one turns out to be
+     * stale. Traffic moves from one path to the other only when the first
+     * is gone, so frames to one destination never overtake each other.
+     * Caller holds conn.mtx.
+     */
+    static bool send_frames(Connection& conn, const std::string& dest_addr, const std::string* frames, size_t n)
+    {
+        frames_sent.fetch_add(n, std::memory_order_relaxed);
+        adopt_offer(conn);
+        if (conn.fd >= 0 && peer_closed(conn.fd))
+        {
+            close(conn.fd);
+            conn.fd = -1;
+            conn.shm.reset();
+        }
+        size_t next = 0;
+        for (int attempt = 0; attempt < 2; ++attempt)
         {
+            if (!conn.shm && conn.fd < 0)
+            {
+                conn.fd = connect_to(dest_addr);
+                if (conn.fd < 0) return false;
+                offer_shm(conn, dest_addr);
+            }
+            if (conn.shm)
+            {
+                auto gone = [&conn] { return conn.fd >= 0 && peer_closed(conn.fd); };
+                while (next < n && conn.shm->send(frames[next], gone)) ++next;
+                if (next == n) return true;
+                // The peer dropped the channel, and what it had not read
+                // with it; the rest goes to whatever answers a fresh
+                // connection
+                conn.shm.reset();
+                if (conn.fd >= 0)
+                {
+                    close(conn.fd);
+                    conn.fd = -1;
+                }
+                continue;
+            }
+            size_t done;
+            if (write_frames(conn.fd, frames + next, n - next, done)) return true;
             perror("write");
-            close(sock);
-            return false;
+            // Frames cut off mid-write go again, whole, on the new connection
+            next += done;
+            close(conn.fd);
+            conn.fd = -1;
+        }
+        return false;
+    }
+
+    // Frames one thread holds back for one destination while batching
+    struct PendingFrames
+    {
+        std::string dest_addr;
+        Connection* conn = nullptr;
+        std::vector<std::string> frames;
+        size_t bytes = 0;
+        std::chrono::steady_clock::time_point first; // oldest frame queued
+    };
+
+    struct SendBatch
+    {
+        int depth = 0; // nested begin_batch() calls
+        std::vector<PendingFrames> pending; // one entry per destination; few
+    };
+    static thread_local SendBatch send_batch;
+
+    static void flush_pending(PendingFrames& p)
+    {
+        if (p.frames.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(p.conn->mtx);
+            send_frames(*p.conn, p.dest_addr, p.frames.data(), p.frames.size());
+        }
+        p.frames.clear();
+        p.bytes = 0;
+    }
+
+    /**
+     * Queue a frame on this thread's batch. The first frame for a
+     * destination makes sure there is a connection (or channel) to it, so
+     * an unreachable destination still fails here; a write that fails at
+     * flush time is as lost as any sent frame the peer never reads. The
+     * delay bound is checked here, so it holds only while frames keep being
+     * queued; end_batch() flushes the rest.
+     */
+    static bool queue_frame(Connection* conn, const std::string& dest_addr, std::string&& frame)
+    {
+        auto it = std::find_if(send_batch.pending.begin(), send_batch.pending.end(),
+                               [&dest_addr](const PendingFrames& p) { return p.dest_addr == dest_addr; });
+        if (it == send_batch.pending.end())
+        {
+            send_batch.pending.emplace_back();
+            it = std::prev(send_batch.pending.end());
+            it->dest_addr = dest_addr;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (it->frames.empty())
+        {
+            it->conn = conn; // entries outlive batches (and shutdown)
+            auto connected = [conn]
+            {
+                adopt_offer(*conn);
+                return (conn->shm && conn->shm->ready()) || conn->fd >= 0;
+            };
+            std::unique_lock<std::mutex> lock(conn->mtx);
+            if (!connected())
+            {
+                // Connecting may block: let what is held for other
+                // destinations go first (without this one's lock held)
+                lock.unlock();
+                for (auto& p : send_batch.pending) flush_pending(p);
+                lock.lock();
+                if (!connected())
+                {
+                    conn->fd = connect_to(dest_addr);
+                    if (conn->fd < 0) return false;
+                    offer_shm(*conn, dest_addr);
+                }
+                now = std::chrono::steady_clock::now();
+            }
+            it->first = now;
+        }
+        it->bytes += frame.size();
+        it->frames.push_back(std::move(frame));
+        // Bound what a batch may hold back, in bytes and in time
+        for (auto& p : send_batch.pending)
+        {
+            if (p.bytes >= COALESCE_MAX_BYTES || (!p.frames.empty() && now - p.first >= COALESCE_MAX_DELAY))
+            {
+                flush_pending(p);
+            }
         }
-        close(sock);
         return true;
     }
 
+    void begin_batch()
+    {
+        ++send_batch.depth;
+    }
+
+    void end_batch()
+    {
+        if (send_batch.depth == 0 || --send_batch.depth > 0) return;
+        for (auto& p : send_batch.pending) flush_pending(p);
+    }
+
+    bool send_message(const std::string& dest_addr, const Message& msg)
+    {
+        Connection* conn = connection(dest_addr);
+        std::string frame = msg.frame();
+        if (send_batch.depth > 0) return queue_frame(conn, dest_addr, std::move(frame));
+        std::lock_guard<std::mutex> lock(conn->mtx);
+        return send_frames(*conn, dest_addr, &frame, 1);
+    }
+
+    SendStats send_stats()
+    {
+        return {frames_sent.load(std::memory_order_relaxed), writes.load(std::memory_order_relaxed)};
+    }
+
     bool receive_message(Message& msg, int timeout_ms)
     {
         std::unique_lock<std::mutex> lock(mtx);
@@ -197,13 +1036,75 @@ namespace network
         }
         msg = msg_queue.front();
         msg_queue.pop();
+        queued.store(msg_queue.size(), std::memory_order_relaxed);
         return true;
     }
 
+    void set_inbound_handler(InboundHandler handler)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::lock_guard<std::mutex> turn(handler_mtx);
+        inbound_handler = std::move(handler);
+        // Hand over whatever arrived before the handler, in order
+        while (!msg_queue.empty())
+        {
+            inbound_handler(std::move(msg_queue.front()));
+            msg_queue.pop();
+        }
+        queued.store(0, std::memory_order_relaxed);
+    }
+
+    size_t shm_channels()
+    {
+        return shm_open.load(std::memory_order_relaxed);
+    }
+
+    size_t queue_depth()
+    {
+        return queued.load(std::memory_order_relaxed);
+    }
+
+    bool TcpTransport::send_message(const std::string& dest_addr, const Message& msg)
+    {
+        return network::send_message(dest_addr, msg);
+    }
+
+    std::string TcpTransport::get_addr(const std::string& node_id)
+    {
+        return network::get_addr(node_id);
+    }
+
+    void TcpTransport::begin_batch()
+    {
+        network::begin_batch();
+    }
+
+    void TcpTransport::end_batch()
+    {
+        network::end_batch();
+    }
+
     void shutdown()
     {
         running = false;
-        if (listen_sock >= 0) close(listen_sock);
+        if (wake_pipe[1] >= 0 && write(wake_pipe[1], "x", 1) < 0) perror("write");
         if (listener_thread.joinable()) listener_thread.join();
+        uring.reset();
+        uring_bufs.reset();
+        if (listen_sock >= 0) close(listen_sock);
+        if (!listen_path.empty()) unlink(listen_path.c_str());
+        listen_path.clear();
+        for (int& fd : wake_pipe)
+        {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+        listen_sock = -1;
+        std::lock_guard<std::mutex> lock(conn_mtx);
+        for (auto& kv : connections)
+        {
+            if (kv.second->fd >= 0) close(kv.second->fd);
+        }
+        connections.clear();
     }
 } // namespace network
@@ -4,6 +4,7 @@
 #ifndef NETWORK_HPP
 #define NETWORK_HPP
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <thread>
@@ -13,15 +14,69 @@
 #include <unordered_map>
 #include "message.hpp"
 
+// How replica logic reaches other nodes. The TCP layer below is one
+// implementation; the in-process simulator (sim.hpp) is another.
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * Send msg to the node at dest_addr. Returns false when the destination
+     * is known to be unreachable (e.g. connection refused); a true return
+     * does not promise delivery.
+     */
+    virtual bool send_message(const std::string& dest_addr, const Message& msg) = 0;
+
+    /**
+     * Address of a node ID, or empty string if the ID is unknown.
+     */
+    virtual std::string get_addr(const std::string& node_id) = 0;
+
+    /**
+     * Hint that a burst of sends follows on this thread: the transport may
+     * hold them back (for a bounded time) and write them together at
+     * end_batch(). Calls nest; the defaults send everything at once.
+     */
+    virtual void begin_batch() {}
+    virtual void end_batch() {}
+};
+
 // Simple TCP networking layer for one-to-one messaging among replicas/clients
 namespace network
 {
+    // How the listener thread waits for and reads inbound connections
+    enum class IoBackend
+    {
+        EPOLL,
+        IO_URING // batched submissions, multishot accept/recv, direct descriptors
+    };
+
+    /**
+     * Choose the inbound I/O backend; call before init(). IO_URING falls
+     * back to EPOLL when the kernel lacks it (or the features it needs).
+     */
+    void set_io_backend(IoBackend backend);
+
+    /**
+     * Backend actually in use after init().
+     */
+    IoBackend io_backend();
+
+    // "epoll" / "io_uring"
+    const char* io_backend_name(IoBackend backend);
+    bool parse_io_backend(const std::string& name, IoBackend& out);
+
     /**
      * Initialize networking: parse config, start listener
-     * config_file format: one entry per line: <node_id> <host> <port>
+     * config_file format: one entry per line: <node_id> <host> <port> [shm]
+     * or <node_id> unix:<path> [shm] for a Unix domain socket.
+     * "shm" marks a node that co-located processes reach over shared memory
      * On return,
-     *  - peers contains "host:port" addresses of all other nodes
-     *  - listen_port is the TCP port this node listens on
+     *  - peers contains the addresses ("host:port" or "unix:<path>") of all
+     *    other nodes
+     *  - listen_port is the TCP port this node listens on (0 for a Unix
+     *    domain socket)
      */
     void init(const std::string& node_id,
               const std::string& config_file,
@@ -29,28 +84,91 @@ namespace network
               int& listen_port);
 
     /**
-     * Lookup the "host:port" address for a given node ID (replica or client)
+     * Lookup the "host:port" (or "unix:<path>") address for a given node ID (replica or client)
      * Requires init() to have been called.
      * Returns empty string if ID not found.
      */
     std::string get_addr(const std::string& node_id);
 
     /**
-     * Send a Message to the destination address "host:port".
-     * This is a one-shot TCP connect/send/close.
+     * Send a Message to the destination address "host:port" or "unix:<path>".
+     * The TCP connection is kept open and reused by later sends to the same
+     * address; a connection the peer has closed is re-established once.
+     * When the destination is marked "shm" and attaches the shared-memory
+     * segment offered on connect, frames go through that instead (and the
+     * destination's replies come back the same way).
+     * Thread-safe.
      */
     bool send_message(const std::string& dest_addr, const Message& msg);
 
+    /**
+     * Coalesce this thread's sends until the matching end_batch(). Frames
+     * are encoded at once and queued per destination, then each
+     * destination's queue goes out in one sendmsg() (scatter-gather over
+     * the encoded frames) at end_batch(), or earlier once it holds 64 KiB
+     * or, checked as later frames are queued, its oldest frame has waited
+     * 200 us; a frame queued last waits for end_batch(). The first send to
+     * a destination in a batch still connects, so send_message() keeps
+     * reporting unreachable destinations; the other destinations' queues
+     * are flushed before that connect. Calls nest.
+     */
+    void begin_batch();
+    void end_batch();
+
+    struct SendStats
+    {
+        uint64_t frames = 0; // messages sent (or attempted)
+        uint64_t writes = 0; // socket write syscalls that carried them
+    };
+
+    /**
+     * Outbound totals since the process started.
+     */
+    SendStats send_stats();
+
     /**
      * Blocking receive: waits until a message arrives in the incoming queue.
      * Messages are deserialized before being queued.
      */
     bool receive_message(Message& msg, int timeout_ms);
 
+    using InboundHandler = std::function<void(Message&&)>;
+
+    /**
+     * Pass every received message to handler instead of queueing it for
+     * receive_message(). It runs on the thread that read the message (the
+     * listener or a shared-memory reader), one call at a time. Messages
+     * already queued are handed over first. Call at most once, after init().
+     */
+    void set_inbound_handler(InboundHandler handler);
+
+    /**
+     * Number of open shared-memory channels (see send_message).
+     */
+    size_t shm_channels();
+
+    /**
+     * Number of received messages waiting in the incoming queue.
+     * Lock-free; safe to call from any thread.
+     */
+    size_t queue_depth();
+
     /**
      * Shutdown networking: stops listener thread and closes sockets.
      */
     void shutdown();
+
+    /**
+     * The functions above as a Transport (requires init()).
+     */
+    class TcpTransport : public Transport
+    {
+    public:
+        bool send_message(const std::string& dest_addr, const Message& msg) override;
+        std::string get_addr(const std::string& node_id) override;
+        void begin_batch() override;
+        void end_batch() override;
+    };
 } // namespace network
 
 #endif // NETWORK_HPP
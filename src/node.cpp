@@ -6,191 +6,196 @@
  * Contributor: N/A
  */
 
+#include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <vector>
-#include <unordered_set>
-#include <unordered_map>
 #include <csignal>
-#include "message.hpp"
-#include "lamport.hpp"
-#include "kv_store.hpp"
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "replica.hpp"
+#include "shard_runtime.hpp"
+#include "failure_detector.hpp"
+#include "watch_hub.hpp"
+#include "hot_keys.hpp"
+#include "metrics.hpp"
+#include "admin_server.hpp"
+#include "logger.hpp"
 #include "network.hpp"
 
 static bool running = true;
-// Map operation_id (replica-level) to client info (node_id, client_op_id)
-static std::unordered_map<std::string, std::pair<std::string, std::string>> op_client_map;
-// Track acknowledgments per operation
-static std::unordered_map<std::string, std::unordered_set<std::string>> ack_tracker;
-// Track which ops have been committed
-static std::unordered_set<std::string> committed_ops;
-// Record dynamic quorum size per op_id
-static std::unordered_map<std::string, int> op_quorum_size;
 
 void handle_sigint(int)
 {
     running = false;
 }
 
+static uint64_t steady_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc != 3)
+    std::string trace_out;
+    uint64_t trace_sample = 1;
+    int admin_port = 0;
+    std::string log_file;
+    logging::Level log_level = logging::Level::INFO;
+    int shards = 1;
+    ShardRuntime::Options runtime_options;
+    HotKeys::Options hot_options;
+    network::IoBackend io_backend = network::IoBackend::EPOLL;
+    bool usage_error = (argc < 3);
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--trace-out=", 0) == 0) trace_out = arg.substr(12);
+        else if (arg.rfind("--trace-sample=", 0) == 0) trace_sample = std::strtoull(arg.c_str() + 15, nullptr, 10);
+        else if (arg.rfind("--admin-port=", 0) == 0) admin_port = std::atoi(arg.c_str() + 13);
+        else if (arg.rfind("--log-file=", 0) == 0) log_file = arg.substr(11);
+        else if (arg.rfind("--shards=", 0) == 0) shards = std::atoi(arg.c_str() + 9);
+        else if (arg.rfind("--client-queue=", 0) == 0)
+            runtime_options.client_queue_limit = std::strtoull(arg.c_str() + 15, nullptr, 10);
+        else if (arg.rfind("--max-queue-delay-ms=", 0) == 0)
+            runtime_options.max_queue_delay_ms = std::strtoull(arg.c_str() + 21, nullptr, 10);
+        else if (arg.rfind("--readers=", 0) == 0) runtime_options.readers = std::max(0, std::atoi(arg.c_str() + 10));
+        else if (arg.rfind("--hot-key-rate=", 0) == 0)
+            hot_options.hot_rate = std::strtoull(arg.c_str() + 15, nullptr, 10);
+        else if (arg.rfind("--io-backend=", 0) == 0) usage_error |= !network::parse_io_backend(arg.substr(13), io_backend);
+        else if (arg.rfind("--log-level=", 0) == 0) usage_error |= !logging::parse_level(arg.substr(12), log_level);
+        else usage_error = true;
+    }
+    if (shards <= 0) shards = std::max(1u, std::thread::hardware_concurrency());
+    if (usage_error)
     {
-        std::cerr << "Usage: " << argv[0] << " <replica_id> <config_file>\n";
+        std::cerr << "Usage: " << argv[0] << " <replica_id> <config_file>"
+            " [--trace-out=trace.json] [--trace-sample=N] [--admin-port=P] [--shards=N|0]"
+            " [--io-backend=epoll|io_uring] [--client-queue=N] [--max-queue-delay-ms=MS|0]"
+            " [--readers=N|0] [--hot-key-rate=N|0] [--log-level=trace|debug|info|warn|error|off] [--log-file=PATH]\n";
         return 1;
     }
     std::string replica_id = argv[1];
     std::string config_file = argv[2];
 
+    // Per-message logging is at TRACE/DEBUG and off unless asked for
+    logging::init(log_file, log_level, replica_id);
+
     // Networking initialization
     std::vector<std::string> peers;
     int listen_port;
+    network::set_io_backend(io_backend);
     network::init(replica_id, config_file, peers, listen_port);
     std::signal(SIGINT, handle_sigint);
 
-    LamportClock clock;
-    KVStore store;
-
-    while (running)
+    // Metrics are served from the admin thread, which only reads atomics
+    MetricsRegistry registry;
+    network::TcpTransport transport;
+    // Heartbeats from the main loop feed a detector the shards consult
+    // before every write fan-out
+    FailureDetector::Options detector_options;
+    FailureDetector detector(peers, detector_options);
+    std::unordered_map<std::string, Gauge*> peer_state;
+    for (const auto& peer : peers)
+    {
+        peer_state[peer] = &registry.gauge("kv_peer_state", "Peer liveness: 0 up, 1 suspect, 2 down",
+                                           "peer=\"" + peer + "\"");
+    }
+    // Client watches, fed by every shard's commits
+    WatchHub watches(transport, registry, WatchHub::Options());
+    // Read-hot keys, counted by every shard and reader
+    HotKeys hot_keys(registry, hot_options);
+    Replica::Options options;
+    options.detector = &detector;
+    options.watches = &watches;
+    if (hot_options.hot_rate > 0) options.hot_keys = &hot_keys;
+    // Per-phase latency of coordinated writes; Chrome trace events only
+    // when a trace file is requested
+    options.chrome_trace = !trace_out.empty();
+    options.trace_sample = trace_sample;
+    runtime_options.shards = shards;
+    ShardRuntime runtime(replica_id, peers, transport, registry, options, runtime_options);
+    for (int i = 0; i < runtime.shards(); ++i) watches.add_store(runtime.replica(i).store());
+    if (admin_port > 0 && !admin::start(admin_port, registry))
     {
-        Message msg;
-        network::receive_message(msg, /*timeout_ms=*/5000);
-        std::cout << "[" << replica_id << "] RECEIVED type=" << (int)msg.type
-            << " key=" << msg.key << " op=" << msg.op_id << " from="
-            << msg.replica_id << "\n";
+        KV_LOG(WARN, "admin_port_unavailable", {"port", admin_port});
+        admin_port = 0;
+    }
 
-        switch (msg.type)
+    // The listener thread routes each message straight into its shard's ring;
+    // heartbeats stop here, and watch requests go to a reader lane
+    runtime.start();
+    network::set_inbound_handler([&runtime, &detector](Message&& msg)
+    {
+        if (msg.type == MessageType::HEARTBEAT)
         {
-        case MessageType::PUT_REQUEST:
-            {
-                // Capture original client info
-                std::string client_node = msg.client_id;
-                std::string client_op = msg.op_id;
-
-                // Assign Lamport timestamp and new replica op_id
-                uint64_t ts = clock.tick();
-                std::string rep_op = replica_id + ":" + std::to_string(ts);
-
-                // Update message for multicast
-                msg.type = MessageType::MULTICAST_OP;
-                msg.replica_id = replica_id;
-                msg.timestamp = ts;
-                msg.op_id = rep_op;
-
-                // Record mapping for client ack
-                op_client_map[rep_op] = {client_node, client_op};
-
-                // Apply locally so origin also has the update pending
-                store.apply(msg);
-                // Self-ACK for origin
-                ack_tracker[rep_op].insert(replica_id);
-
-                // Dynamic quorum: count live replicas (including self)
-                int live_count = 1;
-
-                // Multicast to other peers
-                for (const auto& peer : peers)
-                {
-                    if (network::send_message(peer, msg))
-                    {
-                        live_count++;
-                    }
-                    else
-                    {
-                        std::cerr << "[" << replica_id << "] Peer down, excluding "
-                            << peer << " from quorum";
-                    }
-                }
-                op_quorum_size[rep_op] = live_count;
-                break;
-            }
-        case MessageType::MULTICAST_OP:
-            {
-                // Apply multicast op
-                clock.update(msg.timestamp);
-                store.apply(msg);
-
-                // Send ACK back to origin
-                Message ack;
-                ack.type = MessageType::ACK;
-                ack.op_id = msg.op_id;
-                ack.replica_id = replica_id;
-                ack.timestamp = clock.tick();
-                std::string origin = network::get_addr(msg.replica_id);
-                if (!origin.empty()) network::send_message(origin, ack);
-                break;
-            }
-        case MessageType::ACK:
-            {
-                // Add ack
-                auto& acks = ack_tracker[msg.op_id];
-                acks.insert(msg.replica_id);
-
-                // Check dynamic quorum for this op
-                int needed = op_quorum_size[msg.op_id] / 2 + 1;
-                if (!committed_ops.count(msg.op_id) && (int)acks.size() >= needed)
-                {
-                    committed_ops.insert(msg.op_id);
-
-                    // Broadcast COMMIT to replicas
-                    Message commit;
-                    commit.type = MessageType::COMMIT;
-                    commit.op_id = msg.op_id;
-                    commit.timestamp = clock.tick();
-                    for (const auto& peer : peers)
-                    {
-                        network::send_message(peer, commit);
-                    }
-                    // Local commit
-                    store.commit(msg.op_id);
-
-                    // Send COMMIT-ack to client (using original client op_id)
-                    auto it = op_client_map.find(msg.op_id);
-                    if (it != op_client_map.end())
-                    {
-                        const auto& [cnode, cop] = it->second;
-                        std::string client_addr = network::get_addr(cnode);
-                        Message cack;
-                        cack.type = MessageType::COMMIT;
-                        cack.op_id = cop;
-                        cack.timestamp = clock.tick();
-                        std::cout << "[" << replica_id << "] Sending COMMIT to client "
-                            << client_addr << " for client_op=" << cop << "\n";
-                        if (!client_addr.empty()) network::send_message(client_addr, cack);
-                    }
-                }
-                break;
-            }
-        case MessageType::COMMIT:
-            {
-                if (committed_ops.insert(msg.op_id).second)
-                {
-                    store.commit(msg.op_id);
-                }
-                break;
-            }
-        case MessageType::GET_REQUEST:
-            {
-                // Handle GET
-                std::string val = store.get(msg.key);
-                Message resp;
-                resp.type = MessageType::GET_RESPONSE;
-                resp.op_id = msg.op_id;
-                resp.key = msg.key;
-                resp.value = val;
-                resp.client_id = msg.client_id;
-                resp.timestamp = clock.tick();
-                std::string client_addr = network::get_addr(msg.client_id);
-                std::cout << "[" << replica_id << "] Replying GET_RESPONSE to "
-                    << client_addr << "='" << val << "'\n";
-                if (!client_addr.empty()) network::send_message(client_addr, resp);
-                break;
-            }
-        default:
-            std::cerr << "[" << replica_id << "] Unknown message type\n";
+            detector.heard(network::get_addr(msg.replica_id), steady_ms());
+            return;
+        }
+        runtime.route(std::move(msg));
+    });
+    KV_LOG(INFO, "node_started", {"port", listen_port}, {"peers", peers.size()}, {"admin_port", admin_port},
+           {"shards", shards}, {"io_backend", network::io_backend_name(network::io_backend())});
+
+    // One heartbeat round per detector interval. A DOWN peer is only probed
+    // every PROBE_ROUNDS rounds: enough for it to hear from us when it comes
+    // back, without a failed connect every interval while it is gone.
+    const int PROBE_ROUNDS = 10;
+    // Closed timestamps go out this often, which bounds how far an idle
+    // replica's read watermark lags
+    const uint64_t CLOSED_INTERVAL_MS = 10;
+    Message heartbeat;
+    heartbeat.type = MessageType::HEARTBEAT;
+    heartbeat.replica_id = replica_id;
+    for (uint64_t round = 0; running; ++round)
+    {
+        for (const auto& peer : peers)
+        {
+            if (detector.state(peer) == FailureDetector::State::DOWN && round % PROBE_ROUNDS != 0) continue;
+            if (!transport.send_message(peer, heartbeat)) detector.send_failed(peer);
+        }
+        if (round % 10 == 0) // about once a second
+        {
+            watches.tick(steady_ms());
+            hot_keys.tick(steady_ms());
+        }
+        for (const auto& [peer, state] : detector.tick(steady_ms()))
+        {
+            peer_state[peer]->set(static_cast<int64_t>(state));
+            if (state == FailureDetector::State::UP)
+                KV_LOG(INFO, "peer_state", {"peer", peer}, {"state", FailureDetector::state_name(state)});
+            else
+                KV_LOG(WARN, "peer_state", {"peer", peer}, {"state", FailureDetector::state_name(state)});
+        }
+        for (uint64_t slept = 0; running && slept < detector_options.interval_ms; slept += CLOSED_INTERVAL_MS)
+        {
+            runtime.tick();
+            std::this_thread::sleep_for(std::chrono::milliseconds(CLOSED_INTERVAL_MS));
         }
     }
 
+    if (admin_port > 0) admin::stop();
     network::shutdown();
+    runtime.stop();
+    KV_LOG(INFO, "node_stopped", {"log_records_dropped", logging::dropped()});
+    logging::shutdown();
+    for (int i = 0; i < runtime.shards(); ++i)
+    {
+        const PhaseTracer& tracer = runtime.replica(i).tracer();
+        std::string name = replica_id + (shards > 1 ? "/" + std::to_string(i) : "");
+        std::cout << "[" << name << "] Write latency by phase (us):\n";
+        tracer.write_summary(std::cout);
+        if (!trace_out.empty())
+        {
+            // One trace file per shard: <trace_out>.<shard>
+            std::string path = trace_out + (shards > 1 ? "." + std::to_string(i) : "");
+            std::ofstream ofs(path);
+            tracer.write_chrome_trace(ofs, "node " + name);
+            std::cout << "[" << name << "] Chrome trace written to " << path << "\n";
+        }
+    }
     std::cout << "Node " << replica_id << " shutting down.\n";
     return 0;
 }
@@ -0,0 +1,561 @@
+#include "replica.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <tuple>
+#include "logger.hpp"
+
+NodeMetrics::NodeMetrics(MetricsRegistry& r, const std::string& gauge_labels)
+    : writes_committed(r.counter("kv_writes_committed_total", "Writes committed by this replica as coordinator")),
+      writes_rejected(r.counter("kv_writes_rejected_total", "Conditional writes whose condition failed")),
+      retries_deduplicated(r.counter("kv_retries_deduplicated_total",
+                                     "Client retries answered or dropped by the session table")),
+      reads_served(r.counter("kv_reads_served_total", "GET and MULTI_GET requests answered")),
+      reads_declined(r.counter("kv_reads_declined_total", "Bounded reads declined as too stale")),
+      queue_depth(r.gauge("kv_inbound_queue_depth", "Received messages waiting for the main loop", gauge_labels)),
+      pending_ops(r.gauge("kv_pending_ops", "Replicated ops applied but not yet committed", gauge_labels)),
+      keys(r.gauge("kv_keys", "Keys in the store", gauge_labels)),
+      ack_tracker(r.gauge("kv_ack_tracker_entries", "Ops with ACK sets being tracked", gauge_labels)),
+      op_client_map(r.gauge("kv_op_client_map_entries", "Coordinated ops mapped to their client request",
+                            gauge_labels)),
+      committed_ops(r.gauge("kv_committed_ops_entries", "Op ids remembered as committed", gauge_labels)),
+      commit_latency(r.histogram("kv_write_commit_latency_seconds",
+                                 "Coordinated writes: request received to client COMMIT sent")),
+      quorum_latency(r.histogram("kv_write_quorum_latency_seconds",
+                                 "Coordinated writes: multicast sent to quorum of ACKs"))
+{
+    for (int t = 0; t < static_cast<int>(MessageType::COUNT); ++t)
+    {
+        MessageType type = static_cast<MessageType>(t);
+        received[t] = &r.counter("kv_messages_received_total", "Messages received, by type",
+                                 std::string("type=\"") + message_type_name(type) + "\"");
+    }
+}
+
+Replica::Replica(const std::string& replica_id, std::vector<std::string> peers, Transport& transport,
+                 MetricsRegistry& registry, Options options)
+    : replica_id_(replica_id),
+      op_prefix_(replica_id + ":" + (options.shard >= 0 ? std::to_string(options.shard) + ":" : "")),
+      shard_(options.shard), peers_(std::move(peers)), self_addr_(transport.get_addr(replica_id)),
+      transport_(transport), detector_(options.detector), watches_(options.watches), hot_keys_(options.hot_keys),
+      metrics_(registry, options.shard >= 0 ? "shard=\"" + std::to_string(options.shard) + "\"" : ""),
+      tracer_(options.chrome_trace, options.trace_sample), clock_(options.physical_clock)
+{
+    if (self_addr_.empty()) self_addr_ = replica_id_;
+}
+
+int Replica::op_shard(const std::string& op_id)
+{
+    size_t first = op_id.find(':');
+    size_t second = (first == std::string::npos ? first : op_id.find(':', first + 1));
+    if (second == std::string::npos) return 0;
+    return std::atoi(op_id.c_str() + first + 1);
+}
+
+void Replica::publish_gauges(size_t queue_depth)
+{
+    metrics_.queue_depth.set(queue_depth);
+    metrics_.pending_ops.set(store_.pending_count());
+    metrics_.keys.set(store_.size());
+    metrics_.ack_tracker.set(ack_tracker_.size());
+    metrics_.op_client_map.set(op_client_map_.size());
+    metrics_.committed_ops.set(committed_ops_.size());
+}
+
+void Replica::handle(Message msg, uint64_t dequeued_ns)
+{
+    size_t type_index = static_cast<size_t>(msg.type);
+    if (type_index < metrics_.received.size()) metrics_.received[type_index]->inc();
+    KV_LOG(TRACE, "recv", {"type", message_type_name(msg.type)}, {"key", msg.key}, {"op", msg.op_id},
+           {"from", msg.replica_id});
+
+    switch (msg.type)
+    {
+    case MessageType::PUT_REQUEST:
+    case MessageType::MULTI_PUT_REQUEST:
+    case MessageType::CAS_REQUEST:
+    case MessageType::INCR_REQUEST:
+    case MessageType::APPEND_REQUEST:
+        handle_write(msg, dequeued_ns);
+        break;
+    case MessageType::MULTICAST_OP:
+        handle_multicast(msg);
+        break;
+    case MessageType::ACK:
+        handle_ack(msg, dequeued_ns);
+        break;
+    case MessageType::COMMIT:
+        handle_commit(msg);
+        break;
+    case MessageType::GET_REQUEST:
+        handle_get(msg);
+        break;
+    case MessageType::MULTI_GET_REQUEST:
+        handle_multi_get(msg);
+        break;
+    case MessageType::CLOSED:
+        handle_closed(msg);
+        break;
+    default:
+        KV_LOG_RATE(WARN, 10, "unknown_message_type", {"type", static_cast<int>(msg.type)});
+    }
+}
+
+// All writes replicate the same way: the entries of a MULTI_PUT travel in
+// one MULTICAST_OP, and CAS/INCR/APPEND are evaluated by each replica's
+// store when the op commits
+void Replica::handle_write(Message& msg, uint64_t dequeued_ns)
+{
+    // A client write goes to the shard's sequencer; one forwarded here is
+    // coordinated whatever this replica thinks of its sender
+    if (msg.replica_id.empty())
+    {
+        std::string owner = sequencer();
+        if (!owner.empty())
+        {
+            msg.replica_id = replica_id_;
+            if (transport_.send_message(owner, msg)) return;
+            // Unreachable: coordinate here, and stop forwarding to it
+            if (detector_) detector_->send_failed(owner);
+            KV_LOG_RATE(WARN, 10, "sequencer_unreachable", {"sequencer", owner});
+        }
+    }
+
+    // A retried client write is answered from its session or re-driven
+    // under its existing op_id, never replicated afresh
+    if (msg.seq != 0)
+    {
+        SessionStatus status = sessions_.check(msg.client_id, msg.seq);
+        if (status != SessionStatus::FRESH) metrics_.retries_deduplicated.inc();
+        if (status == SessionStatus::COMPLETED)
+        {
+            send_client_commit(msg.client_id, msg.op_id, sessions_.result(msg.client_id, msg.seq));
+            return;
+        }
+        if (status == SessionStatus::STALE)
+        {
+            // Its result is no longer kept: say so rather than leave the
+            // client waiting on a reply that never comes
+            Message refused;
+            refused.type = MessageType::COMMIT;
+            refused.op_id = msg.op_id;
+            refused.key = msg.key;
+            refused.ok = false;
+            refused.error = "stale_retry";
+            KV_LOG_RATE(WARN, 10, "stale_retry_refused", {"client", msg.client_id}, {"seq", msg.seq});
+            std::string client_addr = transport_.get_addr(msg.client_id);
+            if (!client_addr.empty()) transport_.send_message(client_addr, refused);
+            return;
+        }
+        if (status == SessionStatus::IN_FLIGHT)
+        {
+            std::string rep_op = sessions_.inflight_op(msg.client_id, msg.seq);
+            const Message* op = store_.pending(rep_op);
+            if (!op) return;
+            if (op_client_map_.count(rep_op))
+            {
+                // Coordinated here and still short of a quorum: a multicast
+                // or ACK was lost, so send it again (peers holding it only
+                // ACK again). Retries now all come here via the sequencer.
+                multicast_op(*op);
+                return;
+            }
+            // Pending from a coordinator that may be gone: take it over
+            Message takeover = *op;
+            takeover.replica_id = replica_id_;
+            op_client_map_[rep_op] = {msg.client_id, msg.op_id};
+            ack_tracker_[rep_op].insert(replica_id_);
+            op_quorum_size_[rep_op] = multicast_op(takeover);
+            return;
+        }
+    }
+
+    // Capture original client info
+    std::string client_node = msg.client_id;
+    std::string client_op = msg.op_id;
+
+    // Assign hybrid logical timestamp and new replica op_id
+    uint64_t ts = clock_.tick();
+    std::string rep_op = op_prefix_ + std::to_string(ts);
+
+    // Update message for multicast
+    msg.op = msg.type;
+    msg.type = MessageType::MULTICAST_OP;
+    msg.replica_id = replica_id_;
+    msg.timestamp = ts;
+    msg.op_id = rep_op;
+
+    // Record mapping for client ack
+    op_client_map_[rep_op] = {client_node, client_op};
+    coordinated_++;
+    undecided_.insert(ts);
+    if (msg.seq != 0) sessions_.start(client_node, msg.seq, rep_op);
+    tracer_.mark(rep_op, PhaseTracer::Mark::RECEIVED, msg.received_ns);
+    tracer_.mark(rep_op, PhaseTracer::Mark::DEQUEUED, dequeued_ns);
+
+    // Apply locally so origin also has the update pending
+    store_.apply(msg);
+    // Self-ACK for origin
+    ack_tracker_[rep_op].insert(replica_id_);
+    tracer_.mark(rep_op, PhaseTracer::Mark::SEQUENCED);
+
+    // Multicast to other peers; dynamic quorum counts live replicas
+    op_quorum_size_[rep_op] = multicast_op(msg);
+    tracer_.mark(rep_op, PhaseTracer::Mark::MULTICAST);
+}
+
+void Replica::handle_multicast(const Message& msg)
+{
+    // Apply multicast op (a re-driven op that already committed here is
+    // only ACKed, so it cannot apply twice)
+    clock_.update(msg.timestamp);
+    if (!committed_ops_.count(msg.op_id))
+    {
+        // Counted against its coordinator's CLOSED (a re-driven op only once)
+        if (!store_.pending(msg.op_id)) closed_[msg.op_id.substr(0, msg.op_id.rfind(':') + 1)].ops++;
+        store_.apply(msg);
+        if (msg.seq != 0) sessions_.start(msg.client_id, msg.seq, msg.op_id);
+    }
+
+    // Send ACK back to origin, echoing its trace stamp with the time this
+    // replica held the op
+    Message ack;
+    ack.type = MessageType::ACK;
+    ack.op_id = msg.op_id;
+    ack.replica_id = replica_id_;
+    ack.timestamp = clock_.tick();
+    ack.trace_ns = msg.trace_ns;
+    if (msg.trace_ns && msg.received_ns) ack.trace_hold_ns = PhaseTracer::now_ns() - msg.received_ns;
+    std::string origin = transport_.get_addr(msg.replica_id);
+    if (!origin.empty()) transport_.send_message(origin, ack);
+}
+
+void Replica::handle_ack(const Message& msg, uint64_t dequeued_ns)
+{
+    // Add ack
+    auto& acks = ack_tracker_[msg.op_id];
+    acks.insert(msg.replica_id);
+    if (msg.trace_ns && msg.received_ns >= msg.trace_ns + msg.trace_hold_ns)
+    {
+        tracer_.record(Phase::NETWORK_RTT, msg.received_ns - msg.trace_ns - msg.trace_hold_ns);
+        tracer_.record(Phase::FOLLOWER_HOLD, msg.trace_hold_ns);
+    }
+
+    // Check dynamic quorum for this op
+    int needed = op_quorum_size_[msg.op_id] / 2 + 1;
+    if (committed_ops_.count(msg.op_id) || (int)acks.size() < needed) return;
+
+    committed_ops_.insert(msg.op_id);
+    tracer_.mark(msg.op_id, PhaseTracer::Mark::QUORUM, dequeued_ns);
+    uint64_t multicast_ns = tracer_.stamp(msg.op_id, PhaseTracer::Mark::MULTICAST);
+    if (multicast_ns && dequeued_ns > multicast_ns)
+    {
+        metrics_.quorum_latency.observe_us((dequeued_ns - multicast_ns) / 1000);
+    }
+
+    // COMMIT to every peer holding the op: each one it reached or that
+    // ACKed it, even if DOWN since, so none keeps it pending for good
+    std::unordered_set<std::string> holders;
+    auto reached = op_recipients_.find(msg.op_id);
+    if (reached != op_recipients_.end())
+    {
+        holders.swap(reached->second);
+        op_recipients_.erase(reached);
+    }
+    for (const auto& id : acks)
+    {
+        if (id != replica_id_) holders.insert(transport_.get_addr(id));
+    }
+    Message commit;
+    commit.type = MessageType::COMMIT;
+    commit.op_id = msg.op_id;
+    commit.timestamp = clock_.tick();
+    for (const auto& peer : peers_)
+    {
+        if (holders.count(peer)) transport_.send_message(peer, commit);
+    }
+    // Local commit
+    OpResult result = commit_op(msg.op_id);
+    tracer_.mark(msg.op_id, PhaseTracer::Mark::COMMITTED);
+    metrics_.writes_committed.inc();
+    if (!result.ok) metrics_.writes_rejected.inc();
+
+    // Send COMMIT-ack to client (using original client op_id)
+    auto it = op_client_map_.find(msg.op_id);
+    if (it != op_client_map_.end())
+    {
+        const auto& [cnode, cop] = it->second;
+        send_client_commit(cnode, cop, result);
+        tracer_.mark(msg.op_id, PhaseTracer::Mark::REPLIED);
+        uint64_t received_ns = tracer_.stamp(msg.op_id, PhaseTracer::Mark::RECEIVED);
+        if (received_ns)
+        {
+            metrics_.commit_latency.observe_us((PhaseTracer::now_ns() - received_ns) / 1000);
+        }
+    }
+    tracer_.finish(msg.op_id);
+}
+
+void Replica::handle_commit(const Message& msg)
+{
+    clock_.update(msg.timestamp);
+    if (committed_ops_.insert(msg.op_id).second)
+    {
+        commit_op(msg.op_id);
+        // An op of ours committed by a replica that took it over: that
+        // replica answers the client, and no quorum ends the span here
+        tracer_.discard(msg.op_id);
+    }
+}
+
+void Replica::handle_closed(const Message& msg)
+{
+    clock_.update(msg.timestamp);
+    Closed& c = closed_[msg.op_id];
+    c.addr = transport_.get_addr(msg.replica_id);
+    if (msg.version < c.ops)
+    {
+        // Counting afresh: the coordinator restarted
+        KV_LOG(WARN, "coordinator_restarted", {"coordinator", msg.replica_id});
+        c.ops = msg.version;
+        c.gap = false;
+    }
+    if (msg.version != c.ops && !c.gap)
+    {
+        c.gap = true;
+        KV_LOG(WARN, "coordinator_ops_missed", {"coordinator", msg.replica_id}, {"missed", msg.version - c.ops});
+    }
+    if (!c.gap) c.ts = std::max(c.ts, msg.timestamp);
+    // Its ops at or below the timestamp committed there; commit those whose
+    // COMMIT was lost, in timestamp order
+    for (const auto& op_id : store_.pending_through(msg.op_id, msg.timestamp))
+    {
+        if (committed_ops_.insert(op_id).second) commit_op(op_id);
+    }
+    publish_closed();
+}
+
+void Replica::tick()
+{
+    // Every op stamped here at or below closed has committed, and any op
+    // stamped later gets a larger timestamp
+    Message closed;
+    closed.type = MessageType::CLOSED;
+    closed.op_id = op_prefix_;
+    closed.replica_id = replica_id_;
+    closed.timestamp = (undecided_.empty() ? clock_.tick() : *undecided_.begin() - 1);
+    closed.version = coordinated_;
+    for (const auto& peer : peers_)
+    {
+        if (live_replica(peer)) transport_.send_message(peer, closed);
+    }
+    publish_closed();
+    uint64_t now_ns = PhaseTracer::now_ns();
+    if (now_ns > SPAN_HORIZON_NS) tracer_.expire(now_ns - SPAN_HORIZON_NS);
+}
+
+// A read may be served locally when the watermark reaches the requested
+// minimum (req.timestamp) and lags physical time by at most req.max_staleness_ms
+static bool satisfies_bound(const Message& req, uint64_t watermark, uint64_t now_ms)
+{
+    if (watermark < req.timestamp) return false;
+    if (req.max_staleness_ms == 0) return true;
+    uint64_t applied_ms = HybridLogicalClock::physical_ms(watermark);
+    return applied_ms >= now_ms || now_ms - applied_ms <= req.max_staleness_ms;
+}
+
+void Replica::handle_read(const Message& msg)
+{
+    size_t type_index = static_cast<size_t>(msg.type);
+    if (type_index < metrics_.received.size()) metrics_.received[type_index]->inc();
+    KV_LOG(TRACE, "recv", {"type", message_type_name(msg.type)}, {"key", msg.key}, {"op", msg.op_id});
+    if (msg.type == MessageType::MULTI_GET_REQUEST) handle_multi_get(msg);
+    else handle_get(msg);
+}
+
+void Replica::handle_get(const Message& msg)
+{
+    // Handle GET locally if this replica meets the requested bound;
+    // otherwise reply ok=false so the client tries another replica
+    uint64_t watermark = read_watermark();
+    Message resp;
+    resp.type = MessageType::GET_RESPONSE;
+    resp.op_id = msg.op_id;
+    resp.key = msg.key;
+    resp.seq = msg.seq; // the client's attempt, for a bounded read
+    resp.ok = satisfies_bound(msg, watermark, clock_.physical_now());
+    (resp.ok ? metrics_.reads_served : metrics_.reads_declined).inc();
+    // A hot key is marked for every client, but leased (and later
+    // invalidated) only to clients that cache hot keys: their GETs carry
+    // value "hot" (lease if hot) when not asking for a lease outright
+    resp.hot = hot_keys_ && hot_keys_->record(msg.key);
+    // A near-cache read is leased before the store is read, so a commit
+    // racing the read is invalidated rather than missed: commit_op asks the
+    // hub only after writing the store, so either this read sees the new
+    // version or that commit sees the lease. The lease length travels back
+    // as the reply's staleness bound
+    if (resp.ok && watches_ && (msg.value == "lease" || (msg.value == "hot" && resp.hot)))
+        resp.max_staleness_ms = watches_->lease(msg.client_id, msg.key);
+    if (resp.ok) std::tie(resp.value, resp.version) = store_.get_versioned(msg.key);
+    resp.client_id = msg.client_id;
+    resp.timestamp = watermark;
+    std::string client_addr = transport_.get_addr(msg.client_id);
+    KV_LOG(DEBUG, "get_reply", {"client", client_addr}, {"key", resp.key}, {"value", resp.value}, {"ok", resp.ok});
+    if (!client_addr.empty()) transport_.send_message(client_addr, resp);
+}
+
+void Replica::handle_multi_get(const Message& msg)
+{
+    // Serve every requested key from one store pass
+    std::vector<std::string> keys;
+    keys.reserve(msg.entries.size());
+    for (const auto& entry : msg.entries)
+    {
+        keys.push_back(entry.first);
+        if (hot_keys_) hot_keys_->record(entry.first);
+    }
+    uint64_t watermark = read_watermark();
+    Message resp;
+    resp.type = MessageType::MULTI_GET_RESPONSE;
+    resp.op_id = msg.op_id;
+    resp.ok = satisfies_bound(msg, watermark, clock_.physical_now());
+    (resp.ok ? metrics_.reads_served : metrics_.reads_declined).inc();
+    if (resp.ok) resp.entries = store_.multi_get(keys);
+    resp.client_id = msg.client_id;
+    resp.timestamp = watermark;
+    std::string client_addr = transport_.get_addr(msg.client_id);
+    KV_LOG(DEBUG, "multi_get_reply", {"client", client_addr}, {"keys", keys.size()}, {"ok", resp.ok});
+    if (!client_addr.empty()) transport_.send_message(client_addr, resp);
+}
+
+// The replica that sequences this shard's writes, or "" for this one. The
+// candidates are this replica and the peers known to be live replicas:
+// heard from (clients never send heartbeats) and not DOWN, or every peer
+// without a detector. Sorted by address and indexed by shard, so every
+// replica with the same view picks the same one and shards spread over the
+// nodes.
+std::string Replica::sequencer() const
+{
+    std::vector<const std::string*> live{&self_addr_};
+    for (const auto& peer : peers_)
+    {
+        if (live_replica(peer)) live.push_back(&peer);
+    }
+    if (live.size() == 1) return std::string();
+    std::sort(live.begin(), live.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+    const std::string* owner = live[static_cast<size_t>(std::max(shard_, 0)) % live.size()];
+    return (owner == &self_addr_ ? std::string() : *owner);
+}
+
+bool Replica::live_replica(const std::string& peer) const
+{
+    return !detector_ || (detector_->heard_from(peer) && !excluded(peer));
+}
+
+// Applied watermark advertised in read responses: peers' ops count up to
+// their closed timestamps, and this replica's own future ops are stamped
+// above its hybrid now
+uint64_t Replica::read_watermark() const
+{
+    uint64_t now = std::max(HybridLogicalClock::make(clock_.physical_now()), clock_.read());
+    return store_.watermark(std::min(now, peers_closed_.load()));
+}
+
+// Lowest closed timestamp among the coordinators that count: all of them,
+// except that a replica still in touch with most of them drops those the
+// failure detector holds DOWN. One cut off from most of its peers cannot
+// tell whether they go on committing without it, so it stays stale.
+void Replica::publish_closed()
+{
+    size_t up = 1;
+    for (const auto& entry : closed_)
+    {
+        if (!excluded(entry.second.addr)) up++;
+    }
+    bool majority = 2 * up > closed_.size() + 1;
+    uint64_t low = UINT64_MAX;
+    for (const auto& entry : closed_)
+    {
+        if (!majority || !excluded(entry.second.addr)) low = std::min(low, entry.second.ts);
+    }
+    peers_closed_.store(low);
+}
+
+// Peers the failure detector holds DOWN get no replication traffic
+bool Replica::excluded(const std::string& peer) const
+{
+    return detector_ && detector_->state(peer) == FailureDetector::State::DOWN;
+}
+
+// Multicast a replicated op to every peer not known to be down; returns the
+// number of live replicas (including self) that make up its dynamic quorum.
+// Each copy is stamped as it is sent so a follower's ACK measures its own
+// round trip.
+int Replica::multicast_op(Message msg)
+{
+    int live_count = 1;
+    for (const auto& peer : peers_)
+    {
+        if (excluded(peer)) continue;
+        msg.trace_ns = PhaseTracer::now_ns();
+        if (transport_.send_message(peer, msg))
+        {
+            live_count++;
+            if (!committed_ops_.count(msg.op_id)) op_recipients_[msg.op_id].insert(peer);
+        }
+        else
+        {
+            // Later writes skip it until it is heard from again
+            if (detector_) detector_->send_failed(peer);
+            KV_LOG_RATE(WARN, 10, "peer_down_excluded_from_quorum", {"peer", peer});
+        }
+    }
+    return live_count;
+}
+
+// Commit an op locally and record its result in the client's session
+OpResult Replica::commit_op(const std::string& op_id)
+{
+    const Message* op = store_.pending(op_id);
+    if (op && op_id.compare(0, op_prefix_.size(), op_prefix_) == 0) undecided_.erase(op->timestamp);
+    std::string client_node = (op ? op->client_id : std::string());
+    uint64_t seq = (op ? op->seq : 0);
+    // Keys the op writes, taken before the commit consumes it
+    std::vector<std::string> watched;
+    if (op && watches_)
+    {
+        if (op->entries.empty()) watched.push_back(op->key);
+        for (const auto& entry : op->entries) watched.push_back(entry.first);
+    }
+    OpResult result = store_.commit(op_id);
+    if (seq != 0) sessions_.complete(client_node, seq, result);
+    // Asked only now: a watch registered before this check is seen by it,
+    // and one registered after it scans the store after the commit (the
+    // store's lock orders the two), so no watch misses the change
+    if (result.ok && watches_ && watches_->active())
+    {
+        for (const auto& key : watched)
+        {
+            auto [value, version] = store_.get_versioned(key);
+            watches_->committed(key, value, version, result.timestamp);
+        }
+    }
+    return result;
+}
+
+// Send the COMMIT-ack for a client op (using the client's own op_id)
+void Replica::send_client_commit(const std::string& client_node, const std::string& client_op,
+                                 const OpResult& result)
+{
+    std::string client_addr = transport_.get_addr(client_node);
+    Message cack;
+    cack.type = MessageType::COMMIT;
+    cack.op_id = client_op;
+    cack.key = result.key;
+    cack.value = result.value;
+    cack.version = result.version;
+    cack.ok = result.ok;
+    // The op's timestamp doubles as a token for "at least version" reads
+    cack.timestamp = result.timestamp;
+    KV_LOG(DEBUG, "client_commit", {"client", client_addr}, {"op", client_op}, {"ok", result.ok});
+    if (!client_addr.empty()) transport_.send_message(client_addr, cack);
+}
@@ -0,0 +1,194 @@
+// replica.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef REPLICA_HPP
+#define REPLICA_HPP
+
+#include <array>
+#include <atomic>
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include "message.hpp"
+#include "hlc.hpp"
+#include "kv_store.hpp"
+#include "session_table.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "network.hpp"
+#include "failure_detector.hpp"
+#include "watch_hub.hpp"
+#include "hot_keys.hpp"
+
+// Metrics a replica exports on its admin port. Counters and histograms are
+// shared by the shards of a node; gauges carry gauge_labels (the shard).
+struct NodeMetrics
+{
+    NodeMetrics(MetricsRegistry& r, const std::string& gauge_labels);
+
+    std::array<Counter*, static_cast<size_t>(MessageType::COUNT)> received{};
+    Counter& writes_committed;
+    Counter& writes_rejected;
+    Counter& retries_deduplicated;
+    Counter& reads_served;
+    Counter& reads_declined;
+    Gauge& queue_depth;
+    Gauge& pending_ops;
+    Gauge& keys;
+    Gauge& ack_tracker;
+    Gauge& op_client_map;
+    Gauge& committed_ops;
+    MetricHistogram& commit_latency;
+    MetricHistogram& quorum_latency;
+};
+
+// Protocol state machine of one replica: coordinates client writes through
+// multicast/ACK/COMMIT and serves reads. It is driven one message at a time
+// by whoever owns the inbound queue (node.cpp over TCP, or the simulator)
+// and reaches other nodes only through its Transport.
+//
+// Every write to a shard is coordinated by one replica, its sequencer (see
+// sequencer()); the others forward client writes to it. Followers commit in
+// the order its COMMITs arrive, which over FIFO links is the order it
+// committed in, so CAS/INCR/APPEND and competing PUTs reach the same result
+// on every replica. Replicas that disagree on who is live (a partition the
+// failure detector has only half noticed) may briefly sequence the same
+// shard twice.
+//
+// Reads report an applied watermark. It advances only on closed timestamps
+// from the coordinators (see tick()): a CLOSED from a peer promises that
+// every op it stamped at or below the timestamp has committed, and says how
+// many ops it has stamped so far. A replica that received fewer of them
+// missed some, and its watermark stays where it was when it last had them
+// all; ops whose COMMIT was lost are committed when the CLOSED covering
+// them arrives.
+class Replica
+{
+public:
+    struct Options
+    {
+        bool chrome_trace = false; // keep Chrome trace events (see PhaseTracer)
+        uint64_t trace_sample = 1;
+        HybridLogicalClock::PhysicalClock physical_clock = HybridLogicalClock::system_ms;
+        int shard = -1; // >= 0 on a sharded node: tags the op ids it coordinates
+        // Peer liveness shared by the node's shards; writes skip DOWN peers
+        // and report failed sends to it. nullptr: send to every peer.
+        FailureDetector* detector = nullptr;
+        // Client watches shared by the node's shards; told of every key a
+        // commit changes. nullptr: no watches.
+        WatchHub* watches = nullptr;
+        // Read-hot key tracking shared by the node's shards; GET replies for
+        // hot keys are marked and leased. nullptr: no tracking.
+        HotKeys* hot_keys = nullptr;
+    };
+
+    /**
+     * peers holds the addresses of every other node in the configuration.
+     * transport and registry must outlive the replica.
+     */
+    Replica(const std::string& replica_id, std::vector<std::string> peers, Transport& transport,
+            MetricsRegistry& registry, Options options);
+
+    /**
+     * Process one inbound message; dequeued_ns is when it left the inbound
+     * queue (PhaseTracer clock, 0 if unknown).
+     */
+    void handle(Message msg, uint64_t dequeued_ns = 0);
+
+    /**
+     * Serve a GET_REQUEST or MULTI_GET_REQUEST. Unlike handle(), this may run
+     * on any number of other threads at once, concurrently with handle():
+     * reads touch only the store's read side, the clock and the metrics.
+     */
+    void handle_read(const Message& msg);
+
+    /**
+     * Send this replica's closed timestamp to its peers, which is what
+     * advances their read watermarks while it is idle, and expire trace
+     * spans of ops stuck short of a quorum. Call every few milliseconds
+     * from the thread that calls handle().
+     */
+    void tick();
+
+    /**
+     * Publish table sizes and the inbound queue depth to the gauges.
+     * Call from the thread that calls handle().
+     */
+    void publish_gauges(size_t queue_depth);
+
+    const std::string& id() const { return replica_id_; }
+    const KVStore& store() const { return store_; }
+    const PhaseTracer& tracer() const { return tracer_; }
+
+    /**
+     * Shard that coordinated a replicated op, from the tag in its op_id
+     * ("A:2:1234" -> 2); 0 for untagged op ids ("A:1234").
+     */
+    static int op_shard(const std::string& op_id);
+
+private:
+    void handle_write(Message& msg, uint64_t dequeued_ns);
+    void handle_multicast(const Message& msg);
+    void handle_ack(const Message& msg, uint64_t dequeued_ns);
+    void handle_commit(const Message& msg);
+    void handle_get(const Message& msg);
+    void handle_multi_get(const Message& msg);
+    void handle_closed(const Message& msg);
+
+    std::string sequencer() const;
+    bool live_replica(const std::string& peer) const;
+    uint64_t read_watermark() const;
+    void publish_closed();
+    int multicast_op(Message msg);
+    OpResult commit_op(const std::string& op_id);
+    void send_client_commit(const std::string& client_node, const std::string& client_op, const OpResult& result);
+    bool excluded(const std::string& peer) const;
+
+    std::string replica_id_;
+    std::string op_prefix_; // "<replica_id>:" or "<replica_id>:<shard>:"
+    int shard_; // -1 when unsharded
+    std::vector<std::string> peers_;
+    std::string self_addr_; // this replica's address, as peers know it
+    Transport& transport_;
+    FailureDetector* detector_;
+    WatchHub* watches_;
+    HotKeys* hot_keys_;
+    NodeMetrics metrics_;
+    static constexpr uint64_t SPAN_HORIZON_NS = 10'000'000'000; // spans kept this long at most
+    PhaseTracer tracer_;
+    HybridLogicalClock clock_;
+    KVStore store_;
+    SessionTable sessions_;
+
+    // Map operation_id (replica-level) to client info (node_id, client_op_id)
+    std::unordered_map<std::string, std::pair<std::string, std::string>> op_client_map_;
+    // Track acknowledgments per operation
+    std::unordered_map<std::string, std::unordered_set<std::string>> ack_tracker_;
+    // Track which ops have been committed
+    std::unordered_set<std::string> committed_ops_;
+    // Record dynamic quorum size per op_id
+    std::unordered_map<std::string, int> op_quorum_size_;
+    // Peers each coordinated op's MULTICAST_OP reached, until it commits
+    std::unordered_map<std::string, std::unordered_set<std::string>> op_recipients_;
+
+    // What this replica knows of one coordinator's closed timestamps
+    struct Closed
+    {
+        std::string addr; // "" until its first CLOSED
+        uint64_t ts = 0; // its ops at or below this are all committed here
+        uint64_t ops = 0; // its ops received here
+        bool gap = false; // some op of it never arrived: ts no longer advances
+    };
+    // Coordinators by op prefix ("B:" or "B:<shard>:")
+    std::unordered_map<std::string, Closed> closed_;
+    // Lowest ts among the coordinators that count (see publish_closed);
+    // read by reader threads
+    std::atomic<uint64_t> peers_closed_{UINT64_MAX};
+    // Ops stamped here, and the timestamps of those not yet committed
+    uint64_t coordinated_ = 0;
+    std::set<uint64_t> undecided_;
+};
+
+#endif // REPLICA_HPP
@@ -0,0 +1,89 @@
+/*
+ * File: session_table.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Client request deduplication
+*/
+#ifndef SESSION_TABLE_HPP
+#define SESSION_TABLE_HPP
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include "kv_store.hpp"
+
+// What a replica should do with a client write carrying (client_id, seq)
+enum class SessionStatus
+{
+    FRESH = 0, // never seen: replicate it
+    COMPLETED, // already committed: answer from the cached result
+    IN_FLIGHT, // replicating under an existing op_id: do not start another
+    STALE // older than the retained window: refuse it (outcome unknown)
+};
+
+// Per-client table of completed and in-flight write sequence numbers, so a
+// retried request (same client_id and seq, e.g. after fail-over) is answered
+// from the cached result instead of being replicated a second time. Every
+// replica records ops as they are multicast and committed, so a retry is
+// recognised whichever replica it lands on.
+class SessionTable
+{
+public:
+    // Completed results retained per client; older retries are dropped
+    static constexpr size_t WINDOW = 1024;
+
+    SessionStatus check(const std::string& client_id, uint64_t seq) const
+    {
+        auto it = sessions_.find(client_id);
+        if (it == sessions_.end()) return SessionStatus::FRESH;
+        const Session& s = it->second;
+        if (s.completed.count(seq)) return SessionStatus::COMPLETED;
+        if (s.inflight.count(seq)) return SessionStatus::IN_FLIGHT;
+        if (s.completed.size() >= WINDOW && seq < s.completed.begin()->first) return SessionStatus::STALE;
+        return SessionStatus::FRESH;
+    }
+
+    // Cached result of a completed request (check() must report COMPLETED)
+    const OpResult& result(const std::string& client_id, uint64_t seq) const
+    {
+        return sessions_.at(client_id).completed.at(seq);
+    }
+
+    // Replica op_id carrying an in-flight request (check() must report IN_FLIGHT)
+    const std::string& inflight_op(const std::string& client_id, uint64_t seq) const
+    {
+        return sessions_.at(client_id).inflight.at(seq);
+    }
+
+    // Record that seq is being replicated under op_id
+    void start(const std::string& client_id, uint64_t seq, const std::string& op_id)
+    {
+        Session& s = sessions_[client_id];
+        if (!s.completed.count(seq)) s.inflight[seq] = op_id;
+    }
+
+    // Record the committed result of seq
+    void complete(const std::string& client_id, uint64_t seq, const OpResult& result)
+    {
+        Session& s = sessions_[client_id];
+        s.inflight.erase(seq);
+        s.completed[seq] = result;
+        while (s.completed.size() > WINDOW)
+        {
+            s.completed.erase(s.completed.begin());
+        }
+    }
+
+private:
+    struct Session
+    {
+        std::map<uint64_t, OpResult> completed; // seq -> result, oldest first
+        std::unordered_map<uint64_t, std::string> inflight; // seq -> replica op_id
+    };
+
+    std::unordered_map<std::string, Session> sessions_;
+};
+
+#endif // SESSION_TABLE_HPP
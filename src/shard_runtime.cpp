@@ -0,0 +1,590 @@
+#include "shard_runtime.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+#include "logger.hpp"
+#include "trace.hpp"
+
+// Messages a shard takes from its inbound ring before checking the others
+static constexpr int BATCH = 64;
+// A split request whose replies have not all arrived is forgotten after this
+static constexpr uint64_t JOIN_TIMEOUT_NS = 30ULL * 1000 * 1000 * 1000;
+
+// Split sub-request ids: "<client op id>#<combining shard>.<parts>.<shard>"
+static bool parse_sub_op(const std::string& op_id, std::string& base, int& home, int& parts, int& shard)
+{
+    size_t hash = op_id.rfind('#');
+    if (hash == std::string::npos) return false;
+    const char* p = op_id.c_str() + hash + 1;
+    char* end;
+    home = static_cast<int>(std::strtol(p, &end, 10));
+    if (*end != '.') return false;
+    parts = static_cast<int>(std::strtol(end + 1, &end, 10));
+    if (*end != '.') return false;
+    shard = static_cast<int>(std::strtol(end + 1, &end, 10));
+    if (*end != '\0') return false;
+    base = op_id.substr(0, hash);
+    return true;
+}
+
+ShardRuntime::ShardRuntime(const std::string& replica_id, const std::vector<std::string>& peers,
+                           Transport& transport, MetricsRegistry& registry, Replica::Options replica_options,
+                           Options options)
+    : transport_(transport), options_(options), watches_(replica_options.watches),
+      rejected_full_(registry.counter("kv_requests_rejected_total", "Client requests answered BUSY, by reason",
+                                      "reason=\"queue_full\"")),
+      rejected_late_(registry.counter("kv_requests_rejected_total", "Client requests answered BUSY, by reason",
+                                      "reason=\"queue_delay\""))
+{
+    options_.client_queue_limit = std::min(options_.client_queue_limit, options_.ring_capacity);
+    int n = std::max(1, options_.shards);
+    for (int i = 0; i < n; ++i)
+    {
+        auto shard = std::make_unique<Shard>(options_.ring_capacity);
+        for (int from = 0; from < n; ++from)
+        {
+            shard->mesh.push_back(from == i ? nullptr : std::make_unique<SpscRing<Task>>(options_.ring_capacity));
+        }
+        shard->transport = std::make_unique<ShardTransport>(*this, i);
+        // A single shard keeps untagged op ids, as an unsharded replica
+        replica_options.shard = (n > 1 ? i : -1);
+        shard->replica = std::make_unique<Replica>(replica_id, peers, *shard->transport, registry, replica_options);
+        shards_.push_back(std::move(shard));
+    }
+    for (int i = 0; i < options_.readers; ++i)
+    {
+        readers_.push_back(std::make_unique<Reader>(options_.ring_capacity));
+    }
+}
+
+ShardRuntime::~ShardRuntime()
+{
+    stop();
+}
+
+void ShardRuntime::start()
+{
+    if (running_.exchange(true)) return;
+    for (int i = 0; i < shards(); ++i)
+    {
+        shards_[i]->thread = std::thread(&ShardRuntime::run, this, i);
+    }
+    for (int i = 0; i < readers(); ++i)
+    {
+        readers_[i]->thread = std::thread(&ShardRuntime::run_reader, this, i);
+    }
+}
+
+void ShardRuntime::stop()
+{
+    if (!running_.exchange(false)) return;
+    std::vector<Lane*> lanes;
+    for (auto& shard : shards_) lanes.push_back(shard.get());
+    for (auto& reader : readers_) lanes.push_back(reader.get());
+    for (Lane* lane : lanes)
+    {
+        lane->bell.fetch_add(1);
+        lane->bell.notify_one();
+    }
+    for (Lane* lane : lanes)
+    {
+        if (lane->thread.joinable()) lane->thread.join();
+    }
+}
+
+int ShardRuntime::key_shard(const std::string& key, int shards)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : key) h = (h ^ c) * 1099511628211ULL;
+    return static_cast<int>(h % static_cast<uint64_t>(shards));
+}
+
+size_t ShardRuntime::queue_depth() const
+{
+    size_t depth = 0;
+    for (const auto& shard : shards_) depth += shard->inbound.size() + shard->replication.size();
+    for (const auto& reader : readers_) depth += reader->inbound.size();
+    return depth;
+}
+
+void ShardRuntime::wake(Lane& lane)
+{
+    // Pairs with the sleeping/bell sequence in run(): either the thread sees
+    // the new bell value before it waits, or we see it sleeping
+    lane.bell.fetch_add(1);
+    if (lane.sleeping.load()) lane.bell.notify_one();
+}
+
+void ShardRuntime::tick()
+{
+    for (auto& shard : shards_)
+    {
+        shard->tick_due.store(true);
+        wake(*shard);
+    }
+}
+
+void ShardRuntime::push(int shard, Task&& task, bool replication)
+{
+    Shard& target = *shards_[shard];
+    SpscRing<Task>& ring = (replication ? target.replication : target.inbound);
+    while (!ring.try_push(std::move(task)))
+    {
+        // Full: stop reading the network until the shard catches up
+        if (!running_) return;
+        std::this_thread::yield();
+    }
+    wake(target);
+}
+
+void ShardRuntime::route(Message&& msg)
+{
+    const int n = shards();
+    if (route_read(msg)) return;
+    Task task;
+    switch (msg.type)
+    {
+    case MessageType::MULTICAST_OP:
+    case MessageType::ACK:
+    case MessageType::COMMIT:
+    case MessageType::CLOSED:
+        {
+            int shard = Replica::op_shard(msg.op_id);
+            task.msg = std::move(msg);
+            push(shard >= 0 && shard < n ? shard : 0, std::move(task), /*replication=*/true);
+            return;
+        }
+    case MessageType::WATCH_REQUEST:
+    case MessageType::UNWATCH_REQUEST:
+        route_watch(std::move(msg));
+        return;
+    case MessageType::MULTI_PUT_REQUEST:
+    case MessageType::MULTI_GET_REQUEST:
+        {
+            if (msg.entries.empty() || n == 1) break;
+            std::vector<std::vector<std::pair<std::string, std::string>>> groups(n);
+            for (auto& entry : msg.entries)
+            {
+                groups[key_shard(entry.first, n)].push_back(entry);
+            }
+            int parts = static_cast<int>(std::count_if(groups.begin(), groups.end(),
+                                                       [](const auto& g) { return !g.empty(); }));
+            int home = key_shard(msg.entries.front().first, n);
+            if (parts > 1 && msg.type == MessageType::MULTI_PUT_REQUEST)
+            {
+                // Per-shard commits would not be atomic, so refuse rather than split
+                refuse(msg, "cross_shard");
+                return;
+            }
+            // All or nothing: every shard the request touches must have room
+            for (int s = 0; s < n; ++s)
+            {
+                if (!groups[s].empty() && !admit(s))
+                {
+                    reject(msg, rejected_full_);
+                    return;
+                }
+            }
+            if (parts == 1)
+            {
+                task.msg = std::move(msg);
+                push(home, std::move(task));
+                return;
+            }
+            // The combining shard hears of the request first; sub-replies
+            // that still overtake it (via the mesh rings) wait in its table
+            Task join;
+            join.kind = Task::Kind::JOIN;
+            join.msg = msg;
+            push(home, std::move(join));
+            std::string prefix = msg.op_id + "#" + std::to_string(home) + "." + std::to_string(parts) + ".";
+            for (int s = 0; s < n; ++s)
+            {
+                if (groups[s].empty()) continue;
+                Task sub;
+                sub.msg = msg;
+                sub.msg.entries = std::move(groups[s]);
+                sub.msg.op_id = prefix + std::to_string(s);
+                push(s, std::move(sub));
+            }
+            return;
+        }
+    default:
+        break;
+    }
+    const std::string& key = (msg.entries.empty() ? msg.key : msg.entries.front().first);
+    int shard = key_shard(key, n);
+    if (!admit(shard))
+    {
+        reject(msg, rejected_full_);
+        return;
+    }
+    task.msg = std::move(msg);
+    push(shard, std::move(task));
+}
+
+// Hand a read to the next reader; false if it belongs on a shard (no
+// readers, not a read, or a MULTI_GET spanning shards)
+bool ShardRuntime::route_read(Message& msg)
+{
+    if (readers_.empty()) return false;
+    if (msg.type == MessageType::MULTI_GET_REQUEST)
+    {
+        if (msg.entries.empty()) return false;
+        int first = key_shard(msg.entries.front().first, shards());
+        for (const auto& entry : msg.entries)
+        {
+            if (key_shard(entry.first, shards()) != first) return false;
+        }
+    }
+    else if (msg.type != MessageType::GET_REQUEST)
+    {
+        return false;
+    }
+    Reader& reader = *readers_[next_reader_];
+    next_reader_ = (next_reader_ + 1) % readers_.size();
+    if (reader.inbound.size() >= options_.client_queue_limit)
+    {
+        reject(msg, rejected_full_);
+        return true;
+    }
+    Task task;
+    task.msg = std::move(msg);
+    while (!reader.inbound.try_push(std::move(task)))
+    {
+        if (!running_) return true;
+        std::this_thread::yield();
+    }
+    wake(reader);
+    return true;
+}
+
+void ShardRuntime::route_watch(Message&& msg)
+{
+    Task task;
+    task.msg = std::move(msg);
+    if (readers_.empty())
+    {
+        push(0, std::move(task));
+        return;
+    }
+    Reader& reader = *readers_[next_reader_];
+    next_reader_ = (next_reader_ + 1) % readers_.size();
+    while (!reader.inbound.try_push(std::move(task)))
+    {
+        if (!running_) return;
+        std::this_thread::yield();
+    }
+    wake(reader);
+}
+
+bool ShardRuntime::admit(int shard) const
+{
+    return shards_[shard]->inbound.size() < options_.client_queue_limit;
+}
+
+// A client request that has waited past the delay bound. Sub-requests of a
+// split request are always served: the other parts may already be done.
+bool ShardRuntime::overdue(const Task& task, uint64_t now_ns) const
+{
+    const Message& msg = task.msg;
+    if (task.kind != Task::Kind::MESSAGE || !options_.max_queue_delay_ms || !msg.received_ns) return false;
+    if (msg.type == MessageType::WATCH_REQUEST || msg.type == MessageType::UNWATCH_REQUEST) return false;
+    if (now_ns < msg.received_ns + options_.max_queue_delay_ms * 1000000) return false;
+    return msg.op_id.find('#') == std::string::npos;
+}
+
+// Tell the client its request was not admitted
+void ShardRuntime::reject(const Message& request, Counter& reason)
+{
+    reason.inc();
+    KV_LOG_RATE(WARN, 1, "request_rejected", {"op", request.op_id},
+                {"reason", &reason == &rejected_full_ ? "queue_full" : "queue_delay"});
+    Message busy;
+    busy.type = MessageType::BUSY;
+    busy.op_id = request.op_id;
+    busy.client_id = request.client_id;
+    busy.key = request.key;
+    std::string client_addr = transport_.get_addr(request.client_id);
+    if (!client_addr.empty()) transport_.send_message(client_addr, busy);
+}
+
+void ShardRuntime::refuse(const Message& request, const std::string& error)
+{
+    KV_LOG_RATE(WARN, 1, "request_refused", {"op", request.op_id}, {"reason", error});
+    Message reply;
+    reply.type = MessageType::COMMIT;
+    reply.op_id = request.op_id;
+    reply.client_id = request.client_id;
+    reply.ok = false;
+    reply.error = error;
+    std::string client_addr = transport_.get_addr(request.client_id);
+    if (!client_addr.empty()) transport_.send_message(client_addr, reply);
+}
+
+void ShardRuntime::run(int index)
+{
+    Shard& shard = *shards_[index];
+    if (options_.pin_threads)
+    {
+        unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(index % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    KV_LOG(DEBUG, "shard_started", {"shard", index});
+
+    Task task;
+    while (running_)
+    {
+        uint32_t seen = shard.bell.load();
+        bool worked = false;
+        // Replies produced by one pass (e.g. a burst of ACKs to the same
+        // coordinator) leave together, one write per destination
+        shard.transport->begin_batch();
+        if (shard.tick_due.exchange(false)) shard.replica->tick();
+        // Replication first: it completes writes that were already admitted
+        for (int i = 0; i < BATCH && shard.replication.try_pop(task); ++i)
+        {
+            handle(index, task);
+            worked = true;
+        }
+        uint64_t now = PhaseTracer::now_ns();
+        for (int i = 0; i < BATCH && shard.inbound.try_pop(task); ++i)
+        {
+            if (overdue(task, now)) reject(task.msg, rejected_late_);
+            else handle(index, task);
+            worked = true;
+        }
+        // Bounded like the rings above, so one pass (and the frames its
+        // send batch holds back) stays short however busy the other shards
+        for (auto& ring : shard.mesh)
+        {
+            for (int i = 0; i < BATCH && ring && ring->try_pop(task); ++i)
+            {
+                handle(index, task);
+                worked = true;
+            }
+        }
+        shard.transport->end_batch();
+        bool backlog = flush_overflow(index);
+        shard.replica->publish_gauges(shard.inbound.size() + shard.replication.size());
+        if (worked) continue;
+        if (backlog)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        shard.sleeping.store(true);
+        shard.bell.wait(seen);
+        shard.sleeping.store(false);
+    }
+}
+
+// Reads only: no pinning (the cores belong to the shards), no partials, and
+// every message goes straight to the owning shard's store
+void ShardRuntime::run_reader(int index)
+{
+    Reader& reader = *readers_[index];
+    KV_LOG(DEBUG, "reader_started", {"reader", index});
+
+    Task task;
+    while (running_)
+    {
+        uint32_t seen = reader.bell.load();
+        bool worked = false;
+        transport_.begin_batch();
+        uint64_t now = PhaseTracer::now_ns();
+        for (int i = 0; i < BATCH && reader.inbound.try_pop(task); ++i)
+        {
+            if (overdue(task, now)) reject(task.msg, rejected_late_);
+            else serve_read(task.msg);
+            worked = true;
+        }
+        transport_.end_batch();
+        if (worked) continue;
+        reader.sleeping.store(true);
+        reader.bell.wait(seen);
+        reader.sleeping.store(false);
+    }
+}
+
+void ShardRuntime::serve_read(const Message& msg)
+{
+    if (msg.type == MessageType::WATCH_REQUEST || msg.type == MessageType::UNWATCH_REQUEST)
+    {
+        if (watches_) watches_->handle(msg, PhaseTracer::now_ns() / 1000000);
+        return;
+    }
+    const std::string& key = (msg.entries.empty() ? msg.key : msg.entries.front().first);
+    shards_[key_shard(key, shards())]->replica->handle_read(msg);
+}
+
+void ShardRuntime::handle(int shard, Task& task)
+{
+    switch (task.kind)
+    {
+    case Task::Kind::MESSAGE:
+        if (task.msg.type == MessageType::WATCH_REQUEST || task.msg.type == MessageType::UNWATCH_REQUEST)
+        {
+            serve_read(task.msg);
+            break;
+        }
+        shards_[shard]->replica->handle(std::move(task.msg), PhaseTracer::now_ns());
+        break;
+    case Task::Kind::JOIN:
+        on_join(shard, std::move(task.msg));
+        break;
+    case Task::Kind::PARTIAL:
+        on_partial(shard, std::move(task.msg));
+        break;
+    }
+}
+
+// Called on shard `from`'s thread: pass a sub-request's reply to the shard
+// combining it (possibly itself)
+void ShardRuntime::post_partial(int from, const Message& reply)
+{
+    std::string base;
+    int home, parts, sub;
+    if (!parse_sub_op(reply.op_id, base, home, parts, sub) || home < 0 || home >= shards()) return;
+    if (home == from)
+    {
+        on_partial(from, Message(reply));
+        return;
+    }
+    Task task;
+    task.kind = Task::Kind::PARTIAL;
+    task.msg = reply;
+    Shard& source = *shards_[from];
+    // Keep order behind anything already waiting for the same ring
+    if (!source.overflow.empty() || !shards_[home]->mesh[from]->try_push(std::move(task)))
+    {
+        source.overflow.emplace_back(home, std::move(task));
+        return;
+    }
+    wake(*shards_[home]);
+}
+
+// Retry partials that found their ring full; true if some are still waiting
+bool ShardRuntime::flush_overflow(int index)
+{
+    Shard& shard = *shards_[index];
+    while (!shard.overflow.empty())
+    {
+        auto& [home, task] = shard.overflow.front();
+        if (!shards_[home]->mesh[index]->try_push(std::move(task))) return true;
+        wake(*shards_[home]);
+        shard.overflow.pop_front();
+    }
+    return false;
+}
+
+void ShardRuntime::on_join(int shard, Message&& request)
+{
+    Join& join = shards_[shard]->joins[request.op_id];
+    // A retry arriving while the first attempt is being combined is dropped
+    if (join.registered) return;
+    join.registered = true;
+    if (!join.created_ns) join.created_ns = PhaseTracer::now_ns();
+    std::string op_id = request.op_id;
+    join.request = std::move(request);
+    finish_join(shard, op_id);
+}
+
+void ShardRuntime::on_partial(int shard, Message&& reply)
+{
+    std::string base;
+    int home, parts, sub;
+    if (!parse_sub_op(reply.op_id, base, home, parts, sub) || sub < 0 || sub >= shards()) return;
+    Shard& self = *shards_[shard];
+    if (++self.partials_seen % 1024 == 0) expire_joins(self);
+    Join& join = self.joins[base];
+    if (join.got.empty())
+    {
+        join.got.assign(shards(), false);
+        join.parts = parts;
+        if (!join.created_ns) join.created_ns = PhaseTracer::now_ns();
+    }
+    if (join.got[sub]) return; // duplicate reply (e.g. a retry answered from the session)
+    join.got[sub] = true;
+    join.replies.push_back(std::move(reply));
+    finish_join(shard, base);
+}
+
+// Send the combined reply once the request and all its parts are in
+void ShardRuntime::finish_join(int shard, const std::string& op_id)
+{
+    auto& joins = shards_[shard]->joins;
+    auto it = joins.find(op_id);
+    if (it == joins.end()) return;
+    Join& join = it->second;
+    if (!join.registered || join.parts == 0 || static_cast<int>(join.replies.size()) < join.parts) return;
+
+    // Entries in request order; the oldest watermark bounds them all
+    const Message& request = join.request;
+    Message resp;
+    resp.type = MessageType::MULTI_GET_RESPONSE;
+    resp.op_id = op_id;
+    resp.client_id = request.client_id;
+    resp.ok = true;
+    resp.timestamp = UINT64_MAX;
+    std::unordered_map<std::string, std::string> values;
+    for (const auto& part : join.replies)
+    {
+        resp.ok = resp.ok && part.ok;
+        resp.timestamp = std::min(resp.timestamp, part.timestamp);
+        for (const auto& [k, v] : part.entries) values[k] = v;
+    }
+    if (resp.ok)
+    {
+        for (const auto& entry : request.entries) resp.entries.emplace_back(entry.first, values[entry.first]);
+    }
+    std::string client_addr = transport_.get_addr(request.client_id);
+    if (!client_addr.empty()) transport_.send_message(client_addr, resp);
+    joins.erase(it);
+}
+
+void ShardRuntime::expire_joins(Shard& shard)
+{
+    uint64_t now = PhaseTracer::now_ns();
+    for (auto it = shard.joins.begin(); it != shard.joins.end();)
+    {
+        if (now - it->second.created_ns > JOIN_TIMEOUT_NS)
+        {
+            KV_LOG_RATE(WARN, 10, "split_request_expired", {"op", it->first});
+            it = shard.joins.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool ShardRuntime::ShardTransport::send_message(const std::string& dest_addr, const Message& msg)
+{
+    if (msg.type == MessageType::MULTI_GET_RESPONSE && msg.op_id.find('#') != std::string::npos)
+    {
+        runtime_.post_partial(shard_, msg);
+        return true;
+    }
+    return runtime_.transport_.send_message(dest_addr, msg);
+}
+
+std::string ShardRuntime::ShardTransport::get_addr(const std::string& node_id)
+{
+    return runtime_.transport_.get_addr(node_id);
+}
+
+void ShardRuntime::ShardTransport::begin_batch()
+{
+    runtime_.transport_.begin_batch();
+}
+
+void ShardRuntime::ShardTransport::end_batch()
+{
+    runtime_.transport_.end_batch();
+}
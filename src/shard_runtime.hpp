@@ -0,0 +1,211 @@
+// shard_runtime.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef SHARD_RUNTIME_HPP
+#define SHARD_RUNTIME_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "message.hpp"
+#include "metrics.hpp"
+#include "network.hpp"
+#include "replica.hpp"
+#include "spsc_ring.hpp"
+
+// Thread-per-core replica runtime. The keyspace is partitioned across
+// shards; each shard is one thread that owns its own Replica (store, clock,
+// sessions and protocol tables) and shares nothing with the others.
+//
+// One producer at a time (the network layer) routes every inbound message
+// into its shard's SPSC ring: client requests by key hash, replication
+// traffic by the shard tag in the op id. A MULTI_GET spanning shards is
+// split into one sub-request per shard; the sub-replies travel over
+// shard-to-shard SPSC rings to the shard of the first key, which sends the
+// client one combined reply. A MULTI_PUT spanning shards is refused
+// (error "cross_shard"): split, it would commit shard by shard instead of
+// atomically. Every node of a cluster must run the same number of shards.
+//
+// Each shard has two inbound rings: replication traffic (MULTICAST_OP, ACK,
+// COMMIT, CLOSED), which finishes writes already admitted and is drained first, and
+// client requests. Admission control applies to client requests only: one
+// arriving while its shard already holds client_queue_limit of them, or
+// still queued max_queue_delay_ms after it arrived, is answered BUSY
+// instead of being served, and the client backs off and retries. A
+// saturated node so keeps its queueing delay bounded instead of buffering
+// until every reply is too late to be useful.
+//
+// Reads get their own lane: with readers > 0, GET and MULTI_GET requests go
+// to reader threads (round robin, one SPSC ring each) that serve them
+// against the owning shard's store while the shard keeps replicating, so a
+// read never waits behind a burst of write and replication work. Reads of
+// a MULTI_GET split across shards stay on the shards, whose threads alone
+// may combine the replies.
+//
+// Watch requests (WATCH_REQUEST, UNWATCH_REQUEST) go to a reader too, or to
+// shard 0 without readers: registering a prefix watch scans the stores for
+// its catch-up, which must not hold up the network thread. They are never
+// answered BUSY; a client renews its watches anyway.
+class ShardRuntime
+{
+public:
+    struct Options
+    {
+        int shards = 1;
+        size_t ring_capacity = 4096; // per ring, messages
+        bool pin_threads = true; // pin shard i to CPU i (mod CPU count)
+        size_t client_queue_limit = 1024; // queued client requests per shard before BUSY (< ring_capacity)
+        uint64_t max_queue_delay_ms = 200; // client requests queued longer get BUSY; 0 = no limit
+        int readers = 1; // threads serving GET/MULTI_GET; 0 = the shards serve them
+    };
+
+    /**
+     * transport carries every outbound message and must be thread-safe;
+     * replica_options apply to each shard's Replica (its shard is set here).
+     */
+    ShardRuntime(const std::string& replica_id, const std::vector<std::string>& peers, Transport& transport,
+                 MetricsRegistry& registry, Replica::Options replica_options, Options options);
+    ~ShardRuntime();
+
+    ShardRuntime(const ShardRuntime&) = delete;
+    ShardRuntime& operator=(const ShardRuntime&) = delete;
+
+    void start();
+
+    // Stop and join the shard threads; queued messages are dropped
+    void stop();
+
+    /**
+     * Route one inbound message to its shard. Calls must never overlap (this
+     * is the single producer of the inbound rings); waits while the target
+     * ring is full.
+     */
+    void route(Message&& msg);
+
+    // Have every shard's Replica tick() on its own thread; any thread may call
+    void tick();
+
+    int shards() const { return static_cast<int>(shards_.size()); }
+
+    // Read only while stopped (or while no messages are being routed)
+    const Replica& replica(int shard) const { return *shards_[shard]->replica; }
+
+    int readers() const { return static_cast<int>(readers_.size()); }
+
+    // Messages waiting in all inbound rings
+    size_t queue_depth() const;
+
+    // Client requests answered BUSY so far
+    uint64_t rejected() const { return rejected_full_.value() + rejected_late_.value(); }
+
+    // Shard owning a key (FNV-1a, identical on every node)
+    static int key_shard(const std::string& key, int shards);
+
+private:
+    struct Task
+    {
+        enum class Kind : uint8_t
+        {
+            MESSAGE, // inbound message for the shard's Replica
+            JOIN, // original multi-key request whose replies this shard combines
+            PARTIAL // one sub-request's reply, for the combining shard
+        };
+
+        Kind kind = Kind::MESSAGE;
+        Message msg;
+    };
+
+    // Outbound path of one shard: replies to split sub-requests go to the
+    // combining shard instead of the client
+    class ShardTransport : public Transport
+    {
+    public:
+        ShardTransport(ShardRuntime& runtime, int shard) : runtime_(runtime), shard_(shard) {}
+        bool send_message(const std::string& dest_addr, const Message& msg) override;
+        std::string get_addr(const std::string& node_id) override;
+        void begin_batch() override;
+        void end_batch() override;
+
+    private:
+        ShardRuntime& runtime_;
+        int shard_;
+    };
+
+    // Replies collected for one split request
+    struct Join
+    {
+        bool registered = false; // request has arrived
+        Message request;
+        int parts = 0;
+        std::vector<bool> got; // by shard
+        std::vector<Message> replies;
+        uint64_t created_ns = 0;
+    };
+
+    // A thread that sleeps on bell when its rings are empty
+    struct Lane
+    {
+        std::atomic<uint32_t> bell{0};
+        std::atomic<bool> sleeping{false};
+        std::thread thread;
+    };
+
+    struct Reader : Lane
+    {
+        explicit Reader(size_t capacity) : inbound(capacity) {}
+
+        SpscRing<Task> inbound; // reads, from the router
+    };
+
+    struct Shard : Lane
+    {
+        explicit Shard(size_t capacity) : inbound(capacity), replication(capacity) {}
+
+        SpscRing<Task> inbound; // client requests, from the router
+        SpscRing<Task> replication; // replication traffic, from the router; served first
+        std::vector<std::unique_ptr<SpscRing<Task>>> mesh; // mesh[from]: from other shards
+        std::deque<std::pair<int, Task>> overflow; // partials waiting for room in a full mesh ring
+        std::unique_ptr<ShardTransport> transport;
+        std::unique_ptr<Replica> replica;
+        std::unordered_map<std::string, Join> joins;
+        uint64_t partials_seen = 0;
+        std::atomic<bool> tick_due{false};
+    };
+
+    void run(int shard);
+    void run_reader(int reader);
+    bool route_read(Message& msg);
+    void route_watch(Message&& msg);
+    void serve_read(const Message& msg);
+    void handle(int shard, Task& task);
+    void push(int shard, Task&& task, bool replication = false);
+    bool admit(int shard) const;
+    bool overdue(const Task& task, uint64_t now_ns) const;
+    void reject(const Message& request, Counter& reason);
+    // Answer a write that can never be served here with ok = false and error
+    void refuse(const Message& request, const std::string& error);
+    void post_partial(int from, const Message& reply);
+    bool flush_overflow(int shard);
+    void wake(Lane& lane);
+    void on_join(int shard, Message&& request);
+    void on_partial(int shard, Message&& reply);
+    void finish_join(int shard, const std::string& op_id);
+    void expire_joins(Shard& shard);
+
+    Transport& transport_;
+    Options options_;
+    WatchHub* watches_; // from the replica options; may be nullptr
+    Counter& rejected_full_;
+    Counter& rejected_late_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::unique_ptr<Reader>> readers_;
+    size_t next_reader_ = 0; // round robin; router only
+    std::atomic<bool> running_{false};
+};
+
+#endif // SHARD_RUNTIME_HPP
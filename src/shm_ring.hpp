@@ -0,0 +1,223 @@
+/*
+ * File: shm_ring.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Shared-memory byte rings between co-located processes
+*/
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// A POSIX shared-memory segment holding one byte ring per direction between
+// two processes on the same host. The side that creates it (the initiator)
+// writes ring 0 and reads ring 1; the side that attaches does the opposite.
+// Each ring has one producer and one consumer. A consumer with nothing to
+// read spins briefly and then sleeps on a futex in the segment; producers
+// only make the wake syscall when it is asleep.
+class ShmSegment
+{
+public:
+    static constexpr size_t RING_BYTES = 1 << 20; // per direction
+    static constexpr int STALE_MS = 1000; // consumer heartbeat older than this: peer is gone
+
+    ~ShmSegment()
+    {
+        if (layout_) munmap(layout_, sizeof(Layout));
+        if (initiator_) shm_unlink(name_.c_str()); // no-op once the peer attached
+    }
+
+    ShmSegment(const ShmSegment&) = delete;
+    ShmSegment& operator=(const ShmSegment&) = delete;
+
+    // New segment under name (e.g. "/kvstore-123-1"); nullptr on failure
+    static std::unique_ptr<ShmSegment> create(const std::string& name)
+    {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) return nullptr;
+        std::unique_ptr<ShmSegment> seg(new ShmSegment(name, true));
+        void* p = MAP_FAILED;
+        if (ftruncate(fd, sizeof(Layout)) == 0)
+        {
+            p = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (p == MAP_FAILED) return nullptr;
+        seg->layout_ = new (p) Layout; // the ring bytes are already zero
+        seg->layout_->magic = MAGIC;
+        return seg;
+    }
+
+    // Map a segment the peer created and tell it so; nullptr on failure
+    static std::unique_ptr<ShmSegment> attach(const std::string& name)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return nullptr;
+        struct stat st{};
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == sizeof(Layout))
+        {
+            p = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (p == MAP_FAILED) return nullptr;
+        std::unique_ptr<ShmSegment> seg(new ShmSegment(name, false));
+        seg->layout_ = static_cast<Layout*>(p);
+        if (seg->layout_->magic != MAGIC) return nullptr;
+        shm_unlink(name.c_str()); // both sides hold it mapped; nothing else needs the name
+        seg->touch();
+        seg->layout_->attached.store(1, std::memory_order_release);
+        return seg;
+    }
+
+    const std::string& name() const { return name_; }
+    bool attached() const { return layout_->attached.load(std::memory_order_acquire) != 0; }
+    bool closed() const { return layout_->closed.load(std::memory_order_acquire) != 0; }
+
+    // Tell the peer to stop using the segment
+    void close_segment()
+    {
+        layout_->closed.store(1, std::memory_order_release);
+        wake(in());
+        wake(out());
+    }
+
+    // Whether the peer's consumer has checked in recently
+    bool peer_alive() const
+    {
+        return now_ms() - out().heartbeat_ms.load(std::memory_order_relaxed) < STALE_MS;
+    }
+
+    /**
+     * Producer: append len bytes as one unit, waiting up to timeout_ms for
+     * room. False when it cannot fit, the timeout passes or the segment is
+     * closed; nothing is written then.
+     */
+    bool write(const char* data, size_t len, int timeout_ms)
+    {
+        Ring& r = out();
+        if (len > RING_BYTES) return false;
+        uint64_t tail = r.tail.load(std::memory_order_relaxed);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (RING_BYTES - (tail - r.head.load(std::memory_order_acquire)) < len)
+        {
+            if (closed() || std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::yield();
+        }
+        char* bytes = out_bytes();
+        size_t at = tail % RING_BYTES;
+        size_t first = std::min(len, RING_BYTES - at);
+        std::memcpy(bytes + at, data, first);
+        std::memcpy(bytes, data + first, len - first);
+        r.tail.store(tail + len, std::memory_order_seq_cst);
+        if (r.sleeping.load(std::memory_order_seq_cst)) wake(r);
+        return true;
+    }
+
+    /**
+     * Consumer: append everything readable to out, first waiting up to
+     * timeout_ms if there is nothing. Returns the number of bytes read.
+     */
+    size_t read(std::string& out, int timeout_ms)
+    {
+        Ring& r = in();
+        touch();
+        uint64_t head = r.head.load(std::memory_order_relaxed);
+        uint64_t tail = r.tail.load(std::memory_order_acquire);
+        for (int spin = 0; tail == head && spin < SPIN; ++spin)
+        {
+            std::this_thread::yield();
+            tail = r.tail.load(std::memory_order_acquire);
+        }
+        if (tail == head)
+        {
+            uint32_t bell = r.bell.load(std::memory_order_acquire);
+            r.sleeping.store(1, std::memory_order_seq_cst);
+            if (r.tail.load(std::memory_order_seq_cst) == head && !closed())
+            {
+                timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+                syscall(SYS_futex, &r.bell, FUTEX_WAIT, bell, &ts, nullptr, 0);
+            }
+            r.sleeping.store(0, std::memory_order_relaxed);
+            tail = r.tail.load(std::memory_order_acquire);
+            if (tail == head) return 0;
+        }
+        const char* bytes = in_bytes();
+        size_t len = tail - head;
+        size_t at = head % RING_BYTES;
+        size_t first = std::min(len, RING_BYTES - at);
+        out.append(bytes + at, first);
+        out.append(bytes, len - first);
+        r.head.store(tail, std::memory_order_release);
+        return len;
+    }
+
+    // Wake our own consumer (e.g. so its thread can exit)
+    void interrupt() { wake(in()); }
+
+private:
+    static constexpr uint32_t MAGIC = 0x6b76736d; // "kvsm"
+    static constexpr int SPIN = 64;
+
+    struct Ring
+    {
+        alignas(64) std::atomic<uint64_t> head{0}; // consumer
+        alignas(64) std::atomic<uint64_t> tail{0}; // producer
+        alignas(64) std::atomic<uint32_t> bell{0}; // futex word
+        std::atomic<uint32_t> sleeping{0};
+        std::atomic<int64_t> heartbeat_ms{0}; // consumer's last read(), CLOCK_MONOTONIC
+    };
+
+    struct Layout
+    {
+        uint32_t magic = 0;
+        std::atomic<uint32_t> attached{0};
+        std::atomic<uint32_t> closed{0};
+        Ring rings[2];
+        char bytes[2][RING_BYTES];
+    };
+
+    ShmSegment(const std::string& name, bool initiator) : name_(name), initiator_(initiator) {}
+
+    Ring& out() const { return layout_->rings[initiator_ ? 0 : 1]; }
+    Ring& in() const { return layout_->rings[initiator_ ? 1 : 0]; }
+    char* out_bytes() const { return layout_->bytes[initiator_ ? 0 : 1]; }
+    const char* in_bytes() const { return layout_->bytes[initiator_ ? 1 : 0]; }
+
+    static int64_t now_ms()
+    {
+        // steady_clock is CLOCK_MONOTONIC, the same in every process
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void touch() { in().heartbeat_ms.store(now_ms(), std::memory_order_relaxed); }
+
+    static void wake(Ring& r)
+    {
+        r.bell.fetch_add(1, std::memory_order_seq_cst);
+        syscall(SYS_futex, &r.bell, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+
+    std::string name_;
+    bool initiator_;
+    Layout* layout_ = nullptr;
+};
+
+#endif // SHM_RING_HPP
@@ -0,0 +1,374 @@
+#include "sim.hpp"
+#include <algorithm>
+#include "trace.hpp"
+
+static SimNetwork* active_network = nullptr;
+
+SimNetwork::SimNetwork(uint64_t seed) : SimNetwork(seed, LinkModel())
+{
+}
+
+SimNetwork::SimNetwork(uint64_t seed, LinkModel model) : rng_(seed), model_(model)
+{
+    active_network = this;
+}
+
+SimNetwork::~SimNetwork()
+{
+    if (active_network == this) active_network = nullptr;
+}
+
+uint64_t SimNetwork::virtual_ms()
+{
+    return EPOCH_MS + (active_network ? active_network->now_us_ / 1000 : 0);
+}
+
+Transport& SimNetwork::add_node(const std::string& node_id, Handler handler)
+{
+    Node& node = nodes_[node_id];
+    node.handler = std::move(handler);
+    node.transport = std::make_unique<NodeTransport>(*this, node_id);
+    return *node.transport;
+}
+
+void SimNetwork::set_link(const std::string& from, const std::string& to, LinkModel model)
+{
+    links_[{from, to}] = model;
+}
+
+void SimNetwork::partition(const std::vector<std::string>& side_a, const std::vector<std::string>& side_b)
+{
+    for (const auto& a : side_a)
+    {
+        for (const auto& b : side_b)
+        {
+            cut_.insert({a, b});
+            cut_.insert({b, a});
+        }
+    }
+}
+
+void SimNetwork::heal()
+{
+    cut_.clear();
+}
+
+void SimNetwork::crash(const std::string& node_id)
+{
+    auto it = nodes_.find(node_id);
+    if (it == nodes_.end()) return;
+    it->second.crashed = true;
+    it->second.incarnation++;
+}
+
+// The node resumes with its state intact (a pause rather than a restart)
+void SimNetwork::recover(const std::string& node_id)
+{
+    auto it = nodes_.find(node_id);
+    if (it != nodes_.end()) it->second.crashed = false;
+}
+
+bool SimNetwork::crashed(const std::string& node_id) const
+{
+    auto it = nodes_.find(node_id);
+    return it != nodes_.end() && it->second.crashed;
+}
+
+bool SimNetwork::partitioned(const std::string& from, const std::string& to) const
+{
+    return cut_.count({from, to}) != 0;
+}
+
+void SimNetwork::schedule(uint64_t delay_us, std::function<void()> fn)
+{
+    events_.push(Event{now_us_ + delay_us, next_seq_++, std::move(fn)});
+}
+
+bool SimNetwork::step()
+{
+    if (events_.empty()) return false;
+    // priority_queue::top is const; the event is discarded right after
+    Event event = std::move(const_cast<Event&>(events_.top()));
+    events_.pop();
+    now_us_ = event.at_us;
+    active_network = this;
+    event.fn();
+    return true;
+}
+
+void SimNetwork::run_until(uint64_t end_us)
+{
+    while (!events_.empty() && events_.top().at_us <= end_us)
+    {
+        step();
+    }
+    if (now_us_ < end_us) now_us_ = end_us;
+}
+
+uint64_t SimNetwork::run(uint64_t max_events)
+{
+    uint64_t ran = 0;
+    while (ran < max_events && step())
+    {
+        ++ran;
+    }
+    return ran;
+}
+
+bool SimNetwork::send(const std::string& from, const std::string& to, const Message& msg)
+{
+    auto src = nodes_.find(from);
+    auto dst = nodes_.find(to);
+    if (src == nodes_.end() || src->second.crashed) return false;
+    if (dst == nodes_.end() || dst->second.crashed)
+    {
+        stats_.refused++;
+        return false;
+    }
+    stats_.sent++;
+
+    auto link = links_.find({from, to});
+    const LinkModel& model = (link != links_.end() ? link->second : model_);
+    // Draw from the generator for every send, lost or not, so that a drop
+    // rate or partition does not shift the random stream of later sends
+    uint64_t jitter = (model.jitter_us ? rng_() % (model.jitter_us + 1) : 0);
+    bool lost = std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < model.drop_rate;
+    if (lost || partitioned(from, to))
+    {
+        stats_.dropped++;
+        return true;
+    }
+
+    // Links are FIFO, like one TCP connection per peer
+    uint64_t& tail = link_tail_us_[{from, to}];
+    uint64_t at = std::max(now_us_ + model.latency_us + jitter, tail);
+    tail = at;
+    std::string wire = msg.serialize();
+    uint64_t incarnation = dst->second.incarnation;
+    events_.push(Event{at, next_seq_++, [this, to, wire = std::move(wire), incarnation]
+    {
+        Node& node = nodes_[to];
+        if (node.crashed || node.incarnation != incarnation)
+        {
+            stats_.dropped++;
+            return;
+        }
+        stats_.delivered++;
+        Message delivered = Message::deserialize(wire);
+        delivered.received_ns = PhaseTracer::now_ns();
+        node.handler(std::move(delivered));
+    }});
+    return true;
+}
+
+bool SimNetwork::NodeTransport::send_message(const std::string& dest_addr, const Message& msg)
+{
+    return net_.send(id_, dest_addr, msg);
+}
+
+// Addresses are node IDs
+std::string SimNetwork::NodeTransport::get_addr(const std::string& node_id)
+{
+    return net_.nodes_.count(node_id) ? node_id : std::string();
+}
+
+SimClient::SimClient(SimNetwork& net, const std::string& client_id, std::vector<std::string> replicas,
+                     uint64_t seed, Options options)
+    : net_(net), client_id_(client_id), replicas_(std::move(replicas)), options_(options), rng_(seed)
+{
+    transport_ = &net_.add_node(client_id_, [this](const Message& msg) { on_message(msg); });
+    replica_ = seed % replicas_.size();
+}
+
+void SimClient::start(uint64_t ops)
+{
+    target_ = completed_ + ops;
+    net_.schedule(0, [this] { issue(); });
+}
+
+void SimClient::issue()
+{
+    if (completed_ >= target_) return;
+    uint64_t seq = ++next_seq_;
+    std::string key = "key" + std::to_string(rng_() % options_.key_space);
+    bool read = std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < options_.read_ratio;
+
+    current_ = Message();
+    current_.type = (read ? MessageType::GET_REQUEST : MessageType::PUT_REQUEST);
+    current_.key = key;
+    current_.client_id = client_id_;
+    current_.op_id = client_id_ + ":" + std::to_string(seq);
+    if (!read)
+    {
+        current_.value = client_id_ + "-" + std::to_string(seq);
+        current_.seq = seq;
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < options_.cas_ratio)
+        {
+            // Races other clients' writes to the key; which one wins must
+            // not depend on the replica
+            current_.type = MessageType::CAS_REQUEST;
+            current_.version = versions_[key];
+        }
+    }
+    waiting_ = true;
+    send_current();
+}
+
+void SimClient::send_current()
+{
+    // Skip replicas that refuse the connection, as KVClient does
+    for (size_t tries = 0; tries < replicas_.size(); ++tries)
+    {
+        if (transport_->send_message(replicas_[replica_], current_)) break;
+        replica_ = (replica_ + 1) % replicas_.size();
+    }
+    uint64_t attempt = ++attempt_;
+    net_.schedule(options_.timeout_us, [this, attempt]
+    {
+        if (!waiting_ || attempt != attempt_) return;
+        retries_++;
+        replica_ = (replica_ + 1) % replicas_.size();
+        send_current();
+    });
+}
+
+void SimClient::on_message(const Message& msg)
+{
+    if (!waiting_ || msg.op_id != current_.op_id) return;
+    MessageType expect = (current_.type == MessageType::GET_REQUEST ? MessageType::GET_RESPONSE : MessageType::COMMIT);
+    if (msg.type != expect) return;
+    if (expect == MessageType::GET_RESPONSE && !msg.ok)
+    {
+        // Declined bounded read: try the next replica
+        replica_ = (replica_ + 1) % replicas_.size();
+        send_current();
+        return;
+    }
+    waiting_ = false;
+    completed_++;
+    if (current_.type == MessageType::CAS_REQUEST && !msg.ok) cas_failed_++;
+    uint64_t& seen = versions_[msg.key];
+    seen = std::max(seen, msg.version);
+    net_.schedule(options_.think_us, [this] { issue(); });
+}
+
+SimCluster::SimCluster(Options options) : net_(options.seed, options.link), tick_us_(options.tick_us)
+{
+    for (int i = 1; i <= options.replicas; ++i)
+    {
+        replica_ids_.push_back("r" + std::to_string(i));
+    }
+    Replica::Options replica_options;
+    replica_options.physical_clock = SimNetwork::virtual_ms;
+    for (size_t i = 0; i < replica_ids_.size(); ++i)
+    {
+        std::vector<std::string> peers;
+        for (const auto& id : replica_ids_)
+        {
+            if (id != replica_ids_[i]) peers.push_back(id);
+        }
+        Transport& transport = net_.add_node(replica_ids_[i], [this, i](Message msg)
+        {
+            replicas_[i]->handle(std::move(msg), PhaseTracer::now_ns());
+        });
+        registries_.push_back(std::make_unique<MetricsRegistry>());
+        replicas_.push_back(std::make_unique<Replica>(replica_ids_[i], std::move(peers), transport,
+                                                      *registries_.back(), replica_options));
+    }
+    for (int i = 1; i <= options.clients; ++i)
+    {
+        clients_.push_back(std::make_unique<SimClient>(net_, "c" + std::to_string(i), replica_ids_,
+                                                       options.seed + i, options.client));
+    }
+}
+
+void SimCluster::start(uint64_t ops_per_client)
+{
+    for (auto& client : clients_)
+    {
+        client->start(ops_per_client);
+    }
+}
+
+uint64_t SimCluster::run()
+{
+    if (!ticking_)
+    {
+        ticking_ = true;
+        idle_ticks_ = 0;
+        net_.schedule(0, [this] { tick(); });
+    }
+    return net_.run();
+}
+
+// Tick every live replica, and again after tick_us until the network has
+// stayed quiet for a few ticks
+void SimCluster::tick()
+{
+    idle_ticks_ = (net_.queued_events() > 0 ? 0 : idle_ticks_ + 1);
+    for (size_t i = 0; i < replicas_.size(); ++i)
+    {
+        if (!net_.crashed(replica_ids_[i])) replicas_[i]->tick();
+    }
+    if (idle_ticks_ > 2)
+    {
+        ticking_ = false;
+        return;
+    }
+    net_.schedule(tick_us_, [this] { tick(); });
+}
+
+bool SimCluster::clients_done() const
+{
+    for (const auto& client : clients_)
+    {
+        if (!client->done()) return false;
+    }
+    return true;
+}
+
+uint64_t SimCluster::completed() const
+{
+    uint64_t total = 0;
+    for (const auto& client : clients_)
+    {
+        total += client->completed();
+    }
+    return total;
+}
+
+uint64_t SimCluster::retries() const
+{
+    uint64_t total = 0;
+    for (const auto& client : clients_)
+    {
+        total += client->retries();
+    }
+    return total;
+}
+
+uint64_t SimCluster::cas_failed() const
+{
+    uint64_t total = 0;
+    for (const auto& client : clients_)
+    {
+        total += client->cas_failed();
+    }
+    return total;
+}
+
+bool SimCluster::consistent() const
+{
+    bool have_reference = false;
+    uint64_t reference = 0;
+    for (size_t i = 0; i < replicas_.size(); ++i)
+    {
+        if (net_.crashed(replica_ids_[i])) continue;
+        const KVStore& store = replicas_[i]->store();
+        if (store.pending_count() != 0) return false;
+        if (have_reference && store.fingerprint() != reference) return false;
+        reference = store.fingerprint();
+        have_reference = true;
+    }
+    return true;
+}
@@ -0,0 +1,250 @@
+// sim.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef SIM_HPP
+#define SIM_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "message.hpp"
+#include "network.hpp"
+#include "metrics.hpp"
+#include "replica.hpp"
+
+// Deterministic in-process network for running many replicas and clients in
+// one process. Nothing happens on its own: every delivery and timer is an
+// event in one queue ordered by (virtual time, insertion order), and run()
+// pops them on the calling thread. Latency jitter and drops come from a
+// seeded generator, so a given seed replays exactly the same execution.
+// Messages are serialized and parsed on the way, as over TCP, and each
+// ordered pair of nodes is a FIFO link.
+class SimNetwork
+{
+public:
+    struct LinkModel
+    {
+        uint64_t latency_us = 100; // one-way base latency
+        uint64_t jitter_us = 0; // uniform extra latency in [0, jitter_us]
+        double drop_rate = 0.0; // probability a message is lost
+    };
+
+    struct Stats
+    {
+        uint64_t sent = 0;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0; // random loss, partitions and crashed receivers
+        uint64_t refused = 0; // sends to crashed nodes
+    };
+
+    using Handler = std::function<void(Message)>;
+
+    // Virtual clock starts here so that no HLC timestamp is 0
+    static constexpr uint64_t EPOCH_MS = 1000;
+
+    explicit SimNetwork(uint64_t seed);
+    SimNetwork(uint64_t seed, LinkModel model);
+    ~SimNetwork();
+
+    SimNetwork(const SimNetwork&) = delete;
+    SimNetwork& operator=(const SimNetwork&) = delete;
+
+    /**
+     * Register a node; its address is its ID. The returned transport stays
+     * valid for the network's lifetime.
+     */
+    Transport& add_node(const std::string& node_id, Handler handler);
+
+    // Override the model for messages from one node to another
+    void set_link(const std::string& from, const std::string& to, LinkModel model);
+
+    // Drop everything between the two groups until heal()
+    void partition(const std::vector<std::string>& side_a, const std::vector<std::string>& side_b);
+    void heal();
+
+    // A crashed node neither sends nor receives; sends to it fail like a
+    // refused connection. Messages already in flight to it are lost.
+    void crash(const std::string& node_id);
+    void recover(const std::string& node_id);
+    bool crashed(const std::string& node_id) const;
+
+    // Run fn after delay_us of virtual time
+    void schedule(uint64_t delay_us, std::function<void()> fn);
+
+    // Run the next event; false if none is left
+    bool step();
+
+    // Run events up to and including virtual time end_us
+    void run_until(uint64_t end_us);
+
+    // Run until no event is left or max_events have run; returns events run
+    uint64_t run(uint64_t max_events = UINT64_MAX);
+
+    uint64_t now_us() const { return now_us_; }
+    const Stats& stats() const { return stats_; }
+    size_t queued_events() const { return events_.size(); }
+
+    /**
+     * Virtual milliseconds of the network currently running events on this
+     * thread (an HLC PhysicalClock), or of the most recently created one.
+     */
+    static uint64_t virtual_ms();
+
+private:
+    class NodeTransport : public Transport
+    {
+    public:
+        NodeTransport(SimNetwork& net, std::string id) : net_(net), id_(std::move(id)) {}
+        bool send_message(const std::string& dest_addr, const Message& msg) override;
+        std::string get_addr(const std::string& node_id) override;
+
+    private:
+        SimNetwork& net_;
+        std::string id_;
+    };
+
+    struct Node
+    {
+        Handler handler;
+        std::unique_ptr<NodeTransport> transport;
+        bool crashed = false;
+        uint64_t incarnation = 0; // bumped on crash; stale deliveries are dropped
+    };
+
+    struct Event
+    {
+        uint64_t at_us;
+        uint64_t seq;
+        std::function<void()> fn;
+
+        bool operator>(const Event& other) const
+        {
+            return at_us != other.at_us ? at_us > other.at_us : seq > other.seq;
+        }
+    };
+
+    bool send(const std::string& from, const std::string& to, const Message& msg);
+    bool partitioned(const std::string& from, const std::string& to) const;
+
+    std::mt19937_64 rng_;
+    LinkModel model_;
+    std::map<std::pair<std::string, std::string>, LinkModel> links_;
+    std::map<std::pair<std::string, std::string>, uint64_t> link_tail_us_; // FIFO: last delivery per link
+    std::set<std::pair<std::string, std::string>> cut_;
+    std::unordered_map<std::string, Node> nodes_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t now_us_ = 0;
+    uint64_t next_seq_ = 0;
+    Stats stats_;
+};
+
+// Closed-loop simulated client speaking the replica protocol: one request
+// at a time, writes deduplicated by seq, a timeout that retries the next
+// replica, and bounded reads that move on when a replica declines.
+class SimClient
+{
+public:
+    struct Options
+    {
+        uint64_t timeout_us = 50000;
+        double read_ratio = 0.5;
+        uint64_t key_space = 100;
+        uint64_t think_us = 0; // pause between a reply and the next request
+        double cas_ratio = 0.0; // fraction of writes sent as CAS on the last version seen
+    };
+
+    SimClient(SimNetwork& net, const std::string& client_id, std::vector<std::string> replicas, uint64_t seed,
+              Options options);
+
+    // Issue up to ops requests, starting now
+    void start(uint64_t ops);
+
+    uint64_t completed() const { return completed_; }
+    uint64_t retries() const { return retries_; }
+    uint64_t cas_failed() const { return cas_failed_; }
+    bool done() const { return completed_ == target_; }
+
+private:
+    void on_message(const Message& msg);
+    void issue();
+    void send_current();
+
+    SimNetwork& net_;
+    std::string client_id_;
+    std::vector<std::string> replicas_;
+    Options options_;
+    std::mt19937_64 rng_;
+    Transport* transport_ = nullptr;
+    Message current_;
+    bool waiting_ = false;
+    size_t replica_ = 0;
+    uint64_t next_seq_ = 0;
+    uint64_t attempt_ = 0; // identifies the live timeout
+    uint64_t completed_ = 0;
+    uint64_t retries_ = 0;
+    uint64_t cas_failed_ = 0;
+    uint64_t target_ = 0;
+    std::unordered_map<std::string, uint64_t> versions_; // newest version seen, per key
+};
+
+// Replicas and closed-loop clients wired to one SimNetwork. Replica IDs are
+// r1..rN and client IDs c1..cM; every replica's HLC runs on virtual time.
+class SimCluster
+{
+public:
+    struct Options
+    {
+        int replicas = 3;
+        int clients = 1;
+        uint64_t seed = 1;
+        SimNetwork::LinkModel link;
+        SimClient::Options client;
+        uint64_t tick_us = 5000; // replicas send closed timestamps this often
+    };
+
+    explicit SimCluster(Options options);
+
+    // Give every client ops requests to issue
+    void start(uint64_t ops_per_client);
+
+    // Run until every client is done and the network is quiet (replicas
+    // keep ticking while other events are queued); returns events run
+    uint64_t run();
+
+    bool clients_done() const;
+    uint64_t completed() const;
+    uint64_t retries() const;
+    uint64_t cas_failed() const;
+
+    /**
+     * True when every replica that is not crashed has committed exactly
+     * the same state and has nothing left pending.
+     */
+    bool consistent() const;
+
+    SimNetwork& network() { return net_; }
+    size_t replica_count() const { return replicas_.size(); }
+    const Replica& replica(size_t i) const { return *replicas_[i]; }
+    const std::vector<std::string>& replica_ids() const { return replica_ids_; }
+
+private:
+    void tick();
+
+    SimNetwork net_;
+    uint64_t tick_us_;
+    bool ticking_ = false;
+    int idle_ticks_ = 0;
+    std::vector<std::string> replica_ids_;
+    std::vector<std::unique_ptr<MetricsRegistry>> registries_;
+    std::vector<std::unique_ptr<Replica>> replicas_;
+    std::vector<std::unique_ptr<SimClient>> clients_;
+};
+
+#endif // SIM_HPP
@@ -0,0 +1,96 @@
+/*
+ * File: spsc_ring.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Single-producer single-consumer ring
+*/
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Head and tail live on separate cache lines, and each side keeps a
+// cached copy of the other's index so the common case touches no shared
+// line but its own.
+template <typename T>
+class SpscRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+    {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        mask_ = n - 1;
+        slots_.reset(new T[n]);
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side; false (value untouched) when full
+    bool try_push(T&& value)
+    {
+        uint64_t tail = producer_.tail.load(std::memory_order_relaxed);
+        if (tail - producer_.cached_head > mask_)
+        {
+            producer_.cached_head = consumer_.head.load(std::memory_order_acquire);
+            if (tail - producer_.cached_head > mask_) return false;
+        }
+        slots_[tail & mask_] = std::move(value);
+        producer_.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when empty
+    bool try_pop(T& out)
+    {
+        uint64_t head = consumer_.head.load(std::memory_order_relaxed);
+        if (head == consumer_.cached_tail)
+        {
+            consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+            if (head == consumer_.cached_tail) return false;
+        }
+        out = std::move(slots_[head & mask_]);
+        consumer_.head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate number of queued items; safe from any thread
+    size_t size() const
+    {
+        uint64_t tail = producer_.tail.load(std::memory_order_acquire);
+        uint64_t head = consumer_.head.load(std::memory_order_acquire);
+        return static_cast<size_t>(tail - head);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct alignas(64) Producer
+    {
+        std::atomic<uint64_t> tail{0};
+        uint64_t cached_head = 0;
+    };
+
+    struct alignas(64) Consumer
+    {
+        std::atomic<uint64_t> head{0};
+        uint64_t cached_tail = 0;
+    };
+
+    Producer producer_;
+    Consumer consumer_;
+    size_t mask_;
+    std::unique_ptr<T[]> slots_;
+};
+
+#endif // SPSC_RING_HPP
@@ -0,0 +1,206 @@
+/*
+ * File: trace.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Per-phase latency tracing of the replication pipeline
+*/
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <ostream>
+#include <chrono>
+#include <cstdint>
+#include <unistd.h>
+#include "histogram.hpp"
+
+// Phases of a replicated write as seen by its coordinator. Durations are
+// differences of monotonic stamps taken on one node; the round trip to a
+// follower subtracts the hold time the follower reports in its ACK, so no
+// two nodes' clocks are ever compared.
+enum class Phase
+{
+    QUEUE = 0, // frame read off the socket -> dequeued by the main loop
+    SEQUENCE, // dequeued -> stamped, applied locally and self-ACKed
+    MULTICAST, // sending the MULTICAST_OP to every peer
+    QUORUM, // multicast sent -> quorum-completing ACK dequeued
+    NETWORK_RTT, // per ACK: round trip minus the follower's hold time
+    FOLLOWER_HOLD, // per ACK: follower's arrival -> ACK sent (queue + apply)
+    COMMIT, // COMMIT broadcast and local commit
+    REPLY, // client COMMIT sent
+    TOTAL, // frame read off the socket -> client COMMIT sent
+    COUNT
+};
+
+inline const char* phase_name(Phase p)
+{
+    static const char* names[] = {"queue", "sequence", "multicast", "quorum", "network_rtt",
+                                  "follower_hold", "commit", "reply", "total"};
+    return names[static_cast<int>(p)];
+}
+
+// Collects per-phase latency histograms (microseconds) for every write a
+// replica coordinates and, optionally, Chrome trace events for 1 in
+// sample_every of them. Used from the main loop only, so not thread-safe.
+class PhaseTracer
+{
+public:
+    // Milestones the coordinator stamps, in pipeline order
+    enum class Mark
+    {
+        RECEIVED = 0,
+        DEQUEUED,
+        SEQUENCED,
+        MULTICAST,
+        QUORUM,
+        COMMITTED,
+        REPLIED,
+        COUNT
+    };
+
+    explicit PhaseTracer(bool chrome_events = false, uint64_t sample_every = 1)
+        : chrome_(chrome_events), sample_every_(sample_every ? sample_every : 1), origin_ns_(now_ns())
+    {
+    }
+
+    // Monotonic clock shared by all stamps (and by network arrival stamps)
+    static uint64_t now_ns()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Stamp a milestone of a coordinated op (now, unless ns is given)
+    void mark(const std::string& op_id, Mark m, uint64_t ns = 0)
+    {
+        spans_[op_id][static_cast<int>(m)] = (ns ? ns : now_ns());
+    }
+
+    // Stamp of a milestone, 0 if not reached
+    uint64_t stamp(const std::string& op_id, Mark m) const
+    {
+        auto it = spans_.find(op_id);
+        return (it == spans_.end() ? 0 : it->second[static_cast<int>(m)]);
+    }
+
+    // Record a phase measured outside a span (per-ACK phases)
+    void record(Phase p, uint64_t ns)
+    {
+        hist_[static_cast<int>(p)].record(ns / 1000);
+    }
+
+    // Turn an op's stamps into phase durations and forget it
+    void finish(const std::string& op_id)
+    {
+        auto it = spans_.find(op_id);
+        if (it == spans_.end()) return;
+        const Stamps& s = it->second;
+        static const struct { Phase phase; Mark from, to; } phases[] = {
+            {Phase::QUEUE, Mark::RECEIVED, Mark::DEQUEUED},
+            {Phase::SEQUENCE, Mark::DEQUEUED, Mark::SEQUENCED},
+            {Phase::MULTICAST, Mark::SEQUENCED, Mark::MULTICAST},
+            {Phase::QUORUM, Mark::MULTICAST, Mark::QUORUM},
+            {Phase::COMMIT, Mark::QUORUM, Mark::COMMITTED},
+            {Phase::REPLY, Mark::COMMITTED, Mark::REPLIED},
+            {Phase::TOTAL, Mark::RECEIVED, Mark::REPLIED},
+        };
+        bool sampled = chrome_ && (finished_++ % sample_every_ == 0);
+        for (const auto& ph : phases)
+        {
+            uint64_t from = s[static_cast<int>(ph.from)], to = s[static_cast<int>(ph.to)];
+            if (!from || !to || to < from) continue;
+            record(ph.phase, to - from);
+            if (sampled && events_.size() < MAX_EVENTS) events_.push_back({ph.phase, op_id, from, to});
+        }
+        spans_.erase(it);
+    }
+
+    // Forget an op without recording it (e.g. abandoned after a failover)
+    void discard(const std::string& op_id) { spans_.erase(op_id); }
+
+    // Discard spans first stamped before before_ns: ops that never reach a
+    // quorum would otherwise be kept forever. Returns how many.
+    size_t expire(uint64_t before_ns)
+    {
+        size_t expired = 0;
+        for (auto it = spans_.begin(); it != spans_.end();)
+        {
+            uint64_t first = 0;
+            for (uint64_t ns : it->second)
+            {
+                if (ns && (!first || ns < first)) first = ns;
+            }
+            if (first && first < before_ns)
+            {
+                it = spans_.erase(it);
+                ++expired;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        return expired;
+    }
+
+    const LatencyHistogram& histogram(Phase p) const { return hist_[static_cast<int>(p)]; }
+
+    size_t open_spans() const { return spans_.size(); }
+
+    // One line per phase: count and latency percentiles in microseconds
+    void write_summary(std::ostream& os) const
+    {
+        os << "phase,count,avg_us,p50_us,p99_us,p999_us,max_us\n";
+        for (int i = 0; i < static_cast<int>(Phase::COUNT); ++i)
+        {
+            const LatencyHistogram& h = hist_[i];
+            if (h.count() == 0) continue;
+            os << phase_name(static_cast<Phase>(i)) << ',' << h.count() << ',' << h.mean() << ','
+                << h.percentile(50) << ',' << h.percentile(99) << ',' << h.percentile(99.9) << ','
+                << h.max() << '\n';
+        }
+    }
+
+    // Sampled spans in Chrome trace-event format (chrome://tracing, Perfetto):
+    // one complete ("X") event per phase, one track per op
+    void write_chrome_trace(std::ostream& os, const std::string& process_name) const
+    {
+        long pid = static_cast<long>(getpid());
+        os << "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"args\":{\"name\":\"" << process_name << "\"}}";
+        std::unordered_map<std::string, size_t> tracks;
+        for (const auto& e : events_)
+        {
+            size_t tid = tracks.emplace(e.op_id, tracks.size() + 1).first->second;
+            os << ",\n{\"name\":\"" << phase_name(e.phase) << "\",\"cat\":\"replication\",\"ph\":\"X\",\"ts\":"
+                << (e.begin_ns - origin_ns_) / 1e3 << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1e3
+                << ",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"op\":\"" << e.op_id << "\"}}";
+        }
+        os << "\n]}\n";
+    }
+
+private:
+    using Stamps = std::array<uint64_t, static_cast<int>(Mark::COUNT)>;
+    static constexpr size_t MAX_EVENTS = 1 << 20; // bounds trace memory on long runs
+
+    struct Event
+    {
+        Phase phase;
+        std::string op_id;
+        uint64_t begin_ns, end_ns;
+    };
+
+    bool chrome_;
+    uint64_t sample_every_;
+    uint64_t origin_ns_;
+    uint64_t finished_ = 0;
+    std::unordered_map<std::string, Stamps> spans_;
+    std::array<LatencyHistogram, static_cast<int>(Phase::COUNT)> hist_;
+    std::vector<Event> events_;
+};
+
+#endif // TRACE_HPP
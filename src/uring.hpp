@@ -0,0 +1,249 @@
+/*
+ * File: uring.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Minimal io_uring wrapper (raw syscalls, no liburing)
+*/
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// One submission/completion ring pair, driven from a single thread. Callers
+// queue any number of SQEs, then submit_and_wait() hands them all to the
+// kernel in one io_uring_enter() and drain() walks every completion that is
+// ready, so a busy loop costs one syscall per batch rather than per I/O.
+class IoUring
+{
+public:
+    IoUring() = default;
+
+    ~IoUring()
+    {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_map_ && cq_map_ != sq_map_) munmap(cq_map_, cq_map_size_);
+        if (sq_map_) munmap(sq_map_, sq_map_size_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Set up a ring with room for entries SQEs; false (errno set) when the
+    // kernel refuses, e.g. io_uring is disabled or flags are unknown
+    bool init(unsigned entries, unsigned flags = 0)
+    {
+        io_uring_params p{};
+        p.flags = flags;
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return false;
+        features_ = p.features;
+
+        sq_map_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_map_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+        sq_map_ = map(sq_map_size_, IORING_OFF_SQ_RING);
+        if (!sq_map_) return fail();
+        cq_map_ = single ? sq_map_ : map(cq_map_size_, IORING_OFF_CQ_RING);
+        if (!cq_map_) return fail();
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) return fail();
+
+        char* sq = static_cast<char*>(sq_map_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        // SQE i always sits in array slot i, so the indirection is set once
+        unsigned* array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i) array[i] = i;
+        sqe_tail_ = submitted_ = *sq_tail_;
+
+        char* cq = static_cast<char*>(cq_map_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    int fd() const { return fd_; }
+    unsigned features() const { return features_; }
+
+    // Next free SQE, zeroed; nullptr when the submission queue is full
+    // (submit first)
+    io_uring_sqe* get_sqe()
+    {
+        unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        if (sqe_tail_ - head >= sq_entries_) return nullptr;
+        io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+        ++sqe_tail_;
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    /**
+     * Submit every queued SQE and wait until at least wait_nr completions
+     * are ready. Returns the number submitted, or -errno.
+     */
+    int submit_and_wait(unsigned wait_nr)
+    {
+        std::atomic_ref<unsigned>(*sq_tail_).store(sqe_tail_, std::memory_order_release);
+        unsigned to_submit = sqe_tail_ - submitted_;
+        for (;;)
+        {
+            long n = syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr,
+                             wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (n >= 0)
+            {
+                submitted_ += static_cast<unsigned>(n);
+                return static_cast<int>(n);
+            }
+            if (errno != EINTR) return -errno;
+        }
+    }
+
+    // Call f(cqe) for each completion ready now; returns how many
+    template <typename F>
+    unsigned drain(F&& f)
+    {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        unsigned seen = 0;
+        for (; head != tail; ++head, ++seen) f(cqes_[head & cq_mask_]);
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+        return seen;
+    }
+
+    // Whether the kernel implements an opcode
+    bool supports(uint8_t op)
+    {
+        std::vector<char> raw(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(raw.data());
+        if (enter_register(IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    // An empty fixed-file table of n slots, filled by direct accepts
+    bool register_sparse_files(unsigned n)
+    {
+        io_uring_rsrc_register reg{};
+        reg.nr = n;
+        reg.flags = IORING_RSRC_REGISTER_SPARSE;
+        return enter_register(IORING_REGISTER_FILES2, &reg, sizeof(reg)) >= 0;
+    }
+
+    int enter_register(unsigned opcode, void* arg, unsigned nr_args)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd_, opcode, arg, nr_args));
+    }
+
+private:
+    void* map(size_t size, uint64_t offset)
+    {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    bool fail()
+    {
+        int saved = errno;
+        close(fd_);
+        fd_ = -1;
+        errno = saved;
+        return false;
+    }
+
+    int fd_ = -1;
+    unsigned features_ = 0;
+    void* sq_map_ = nullptr;
+    void* cq_map_ = nullptr;
+    size_t sq_map_size_ = 0, cq_map_size_ = 0, sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0, sq_entries_ = 0;
+    unsigned sqe_tail_ = 0; // local tail, published on submit
+    unsigned submitted_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+// Fixed-size receive buffers registered with a ring as a provided-buffer
+// group: the kernel picks a free buffer for each recv and the reader hands
+// it back with recycle() once the bytes are consumed, so no buffer is
+// pinned per idle connection.
+class UringBufferRing
+{
+public:
+    UringBufferRing() = default;
+
+    ~UringBufferRing()
+    {
+        if (ring_) munmap(ring_, ring_size_);
+    }
+
+    UringBufferRing(const UringBufferRing&) = delete;
+    UringBufferRing& operator=(const UringBufferRing&) = delete;
+
+    // count must be a power of two
+    bool init(IoUring& uring, uint16_t group, unsigned count, unsigned size)
+    {
+        ring_size_ = count * sizeof(io_uring_buf);
+        void* p = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return false;
+        ring_ = static_cast<io_uring_buf_ring*>(p);
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring_);
+        reg.ring_entries = count;
+        reg.bgid = group;
+        if (uring.enter_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+        group_ = group;
+        mask_ = count - 1;
+        size_ = size;
+        memory_.resize(static_cast<size_t>(count) * size);
+        for (unsigned bid = 0; bid < count; ++bid) recycle(static_cast<uint16_t>(bid));
+        return true;
+    }
+
+    uint16_t group() const { return group_; }
+    const char* data(uint16_t bid) const { return memory_.data() + static_cast<size_t>(bid) * size_; }
+
+    // Return a buffer to the kernel
+    void recycle(uint16_t bid)
+    {
+        // Index the entries directly: in C++ the header's flex-array member
+        // sits after a one-byte empty struct, not at offset 0
+        io_uring_buf& slot = reinterpret_cast<io_uring_buf*>(ring_)[tail_ & mask_];
+        slot.addr = reinterpret_cast<uint64_t>(data(bid));
+        slot.len = size_;
+        slot.bid = bid;
+        ++tail_;
+        std::atomic_ref<uint16_t>(ring_->tail).store(tail_, std::memory_order_release);
+    }
+
+private:
+    io_uring_buf_ring* ring_ = nullptr;
+    size_t ring_size_ = 0;
+    uint16_t group_ = 0;
+    uint16_t tail_ = 0;
+    unsigned mask_ = 0;
+    unsigned size_ = 0;
+    std::vector<char> memory_;
+};
+
+#endif // URING_HPP
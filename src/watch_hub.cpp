@@ -0,0 +1,256 @@
+#include "watch_hub.hpp"
+#include <algorithm>
+#include <iterator>
+#include "logger.hpp"
+
+WatchHub::WatchHub(Transport& transport, MetricsRegistry& registry, Options options)
+    : transport_(transport), options_(options),
+      watches_gauge_(registry.gauge("kv_watches", "Key and prefix watches registered by clients")),
+      leases_gauge_(registry.gauge("kv_cache_leases", "Keys leased to client near caches")),
+      events_(registry.counter("kv_watch_events_total", "Key changes pushed to watching clients")),
+      invalidations_(registry.counter("kv_cache_invalidations_total", "Near-cache invalidations sent to clients"))
+{
+}
+
+void WatchHub::add_store(const KVStore& store)
+{
+    stores_.push_back(&store);
+}
+
+void WatchHub::handle(const Message& request, uint64_t now_ms)
+{
+    bool prefix = (request.value == "prefix");
+    Message resp;
+    resp.type = MessageType::WATCH_RESPONSE;
+    resp.op_id = request.op_id;
+    resp.client_id = request.client_id;
+    resp.key = request.key;
+    resp.value = request.value;
+    bool fresh = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        now_ms_ = std::max(now_ms_, now_ms);
+        auto& table = (prefix ? prefixes_ : keys_);
+        if (request.type == MessageType::UNWATCH_REQUEST)
+        {
+            auto it = table.find(request.key);
+            if (it != table.end() && it->second.erase(request.client_id))
+            {
+                --total_;
+                if (it->second.empty()) erase_entry(table, it);
+            }
+        }
+        else
+        {
+            auto it = table.find(request.key);
+            fresh = (it == table.end() || !it->second.count(request.client_id));
+            if (fresh && total_ >= options_.max_watches)
+            {
+                resp.ok = false;
+                fresh = false;
+            }
+            else
+            {
+                if (it == table.end())
+                {
+                    it = table.emplace(request.key, Watchers()).first;
+                    if (prefix) ++prefix_lengths_[request.key.size()];
+                }
+                it->second[request.client_id] = now_ms + options_.lease_ms;
+                total_ += fresh;
+            }
+        }
+        set_count();
+    }
+    KV_LOG(DEBUG, "watch", {"client", request.client_id}, {"key", request.key}, {"prefix", prefix},
+           {"type", message_type_name(request.type)}, {"ok", resp.ok});
+    // Registered before catching up: a commit racing the scan is sent
+    // twice at worst, never missed
+    if (fresh) catch_up(request);
+    std::string client_addr = transport_.get_addr(request.client_id);
+    if (!client_addr.empty()) transport_.send_message(client_addr, resp);
+}
+
+// Send a new watch the keys that changed after the version it asked from
+void WatchHub::catch_up(const Message& request)
+{
+    std::vector<KeyState> changed;
+    if (request.value == "prefix")
+    {
+        for (const KVStore* store : stores_)
+        {
+            for (auto& state : store->scan(request.key, request.version)) changed.push_back(std::move(state));
+        }
+    }
+    else
+    {
+        // A key lives in one shard; the others report version 0
+        KeyState state{request.key, "", 0};
+        for (const KVStore* store : stores_)
+        {
+            auto [value, version] = store->get_versioned(request.key);
+            if (version > state.version) state = {request.key, std::move(value), version};
+        }
+        if (state.version > request.version) changed.push_back(std::move(state));
+    }
+    for (const auto& state : changed) send_event(request.client_id, state, 0);
+}
+
+uint64_t WatchHub::lease(const std::string& client, const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    Watchers& holders = leases_[key];
+    auto it = holders.find(client);
+    if (it == holders.end())
+    {
+        if (leased_ >= options_.max_leases)
+        {
+            if (holders.empty()) leases_.erase(key);
+            return 0;
+        }
+        it = holders.emplace(client, 0).first;
+        ++leased_;
+        set_count();
+    }
+    it->second = now_ms_ + options_.cache_lease_ms;
+    return options_.cache_lease_ms;
+}
+
+void WatchHub::committed(const std::string& key, const std::string& value, uint64_t version, uint64_t timestamp)
+{
+    std::vector<std::string> clients;
+    std::vector<std::string> leased;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        // Leases end with the first commit after them
+        auto l = leases_.find(key);
+        if (l != leases_.end())
+        {
+            for (const auto& [client, expires] : l->second) leased.push_back(client);
+            leased_ -= l->second.size();
+            leases_.erase(l);
+            set_count();
+        }
+        auto it = keys_.find(key);
+        if (it != keys_.end())
+        {
+            for (const auto& [client, expires] : it->second) clients.push_back(client);
+        }
+        // One lookup per prefix length in use, not one per prefix
+        for (const auto& [length, count] : prefix_lengths_)
+        {
+            if (length > key.size()) break;
+            auto p = prefixes_.find(key.substr(0, length));
+            if (p == prefixes_.end()) continue;
+            for (const auto& [client, expires] : p->second) clients.push_back(client);
+        }
+    }
+    // A client watching the key several ways hears of it once
+    std::sort(clients.begin(), clients.end());
+    clients.erase(std::unique(clients.begin(), clients.end()), clients.end());
+    KeyState state{key, value, version};
+    for (const auto& client : clients) send_event(client, state, timestamp);
+    for (const auto& client : leased) send_invalidate(client, key, version);
+}
+
+void WatchHub::send_event(const std::string& client, const KeyState& state, uint64_t timestamp)
+{
+    Message event;
+    event.type = MessageType::WATCH_EVENT;
+    event.client_id = client;
+    event.key = state.key;
+    event.value = state.value;
+    event.version = state.version;
+    event.timestamp = timestamp;
+    std::string client_addr = transport_.get_addr(client);
+    if (client_addr.empty() || !transport_.send_message(client_addr, event))
+    {
+        KV_LOG_RATE(WARN, 10, "watcher_unreachable", {"client", client});
+        drop_client(client);
+        return;
+    }
+    events_.inc();
+}
+
+void WatchHub::send_invalidate(const std::string& client, const std::string& key, uint64_t version)
+{
+    Message msg;
+    msg.type = MessageType::CACHE_INVALIDATE;
+    msg.client_id = client;
+    msg.key = key;
+    msg.version = version;
+    std::string client_addr = transport_.get_addr(client);
+    // An unreachable client's cache entry expires by itself
+    if (!client_addr.empty() && transport_.send_message(client_addr, msg)) invalidations_.inc();
+}
+
+void WatchHub::drop_client(const std::string& client)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto* table : {&keys_, &prefixes_})
+    {
+        for (auto it = table->begin(); it != table->end();)
+        {
+            total_ -= it->second.erase(client);
+            it = (it->second.empty() ? erase_entry(*table, it) : std::next(it));
+        }
+    }
+    set_count();
+}
+
+void WatchHub::tick(uint64_t now_ms)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    now_ms_ = std::max(now_ms_, now_ms);
+    for (auto* table : {&keys_, &prefixes_, &leases_})
+    {
+        for (auto it = table->begin(); it != table->end();)
+        {
+            auto& watchers = it->second;
+            for (auto w = watchers.begin(); w != watchers.end();)
+            {
+                if (w->second > now_ms)
+                {
+                    ++w;
+                    continue;
+                }
+                if (table != &leases_) KV_LOG(DEBUG, "watch_expired", {"client", w->first}, {"key", it->first});
+                w = watchers.erase(w);
+                --(table == &leases_ ? leased_ : total_);
+            }
+            it = (watchers.empty() ? erase_entry(*table, it) : std::next(it));
+        }
+    }
+    set_count();
+}
+
+// Remove a key or prefix nobody watches any more. Called with mtx_ held.
+WatchHub::Table::iterator WatchHub::erase_entry(Table& table, Table::iterator it)
+{
+    if (&table == &prefixes_)
+    {
+        auto length = prefix_lengths_.find(it->first.size());
+        if (--length->second == 0) prefix_lengths_.erase(length);
+    }
+    return table.erase(it);
+}
+
+size_t WatchHub::watches() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return total_;
+}
+
+size_t WatchHub::leases() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return leased_;
+}
+
+// Called with mtx_ held
+void WatchHub::set_count()
+{
+    count_.store(total_ + leased_, std::memory_order_release);
+    watches_gauge_.set(static_cast<int64_t>(total_));
+    leases_gauge_.set(static_cast<int64_t>(leased_));
+}
@@ -0,0 +1,114 @@
+// watch_hub.hpp
+// Created by Yuesong Huang on 4/30/25.
+
+#ifndef WATCH_HUB_HPP
+#define WATCH_HUB_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "kv_store.hpp"
+#include "message.hpp"
+#include "metrics.hpp"
+#include "network.hpp"
+
+// Key-change subscriptions of one node. A client registers a watch on a key
+// or a key prefix with WATCH_REQUEST; from then on every commit to a
+// watched key is pushed to it as a WATCH_EVENT with the key's new value and
+// version, over the connection its replies already use. Watches are
+// leased: a client renews one by sending the same WATCH_REQUEST again, and
+// a watch not renewed for lease_ms is dropped, as are all of a client's
+// watches once a send to it fails.
+//
+// Watches resume by version. A new watch is first sent the current value of
+// every matching key whose version is above the request's version, so a
+// client re-registering (say, with another replica) with the last version
+// it saw misses no key's latest value; versions it skipped show in the
+// version numbers.
+//
+// The hub also holds near-cache leases. A GET that asks for one (value
+// "lease", or "hot" for a read-hot key) registers the client against the
+// key before the read, and the next commit to the key sends it one
+// CACHE_INVALIDATE and ends the lease; the client GETs (and leases) again
+// on its next miss. A lease taken while
+// its key commits is safe for the same reason a new watch is: the commit
+// looks for leases only after writing the store, and the GET reads the
+// store only after leasing, so the reply or the invalidation carries the
+// new version.
+//
+// committed() runs on the shard threads, handle() on a reader (or shard)
+// thread, so a prefix watch's catch-up scan never stalls the network
+// thread, and tick() on the main thread; all of them lock.
+class WatchHub
+{
+public:
+    struct Options
+    {
+        uint64_t lease_ms = 10000; // watches not renewed for this long are dropped
+        size_t max_watches = 100000; // per node; further WATCH_REQUESTs are refused
+        uint64_t cache_lease_ms = 5000; // near-cache lease granted with a GET
+        size_t max_leases = 100000; // per node; further GETs are served without one
+    };
+
+    WatchHub(Transport& transport, MetricsRegistry& registry, Options options);
+
+    // Stores new watches catch up from (one per shard); add before serving
+    void add_store(const KVStore& store);
+
+    // A WATCH_REQUEST or UNWATCH_REQUEST; answered with WATCH_RESPONSE
+    void handle(const Message& request, uint64_t now_ms);
+
+    // Lease key to client until its next commit; returns the lease length
+    // in ms, or 0 when the table is full (the GET is then not cacheable)
+    uint64_t lease(const std::string& client, const std::string& key);
+
+    // A commit left key at value/version; tell every client watching it
+    void committed(const std::string& key, const std::string& value, uint64_t version, uint64_t timestamp);
+
+    // Any watch or lease registered; lets commits skip the hub without
+    // locking. A watch counts here before its catch-up scan, so ask after
+    // committing to the store, never before.
+    bool active() const { return count_.load(std::memory_order_acquire) > 0; }
+
+    // Drop watches and leases that ran out; call about once a second
+    void tick(uint64_t now_ms);
+
+    size_t watches() const;
+    size_t leases() const;
+
+private:
+    // client -> lease expiry (ms), for one key or prefix
+    using Watchers = std::unordered_map<std::string, uint64_t>;
+    // key or prefix -> its watchers
+    using Table = std::unordered_map<std::string, Watchers>;
+
+    void catch_up(const Message& request);
+    void send_event(const std::string& client, const KeyState& state, uint64_t timestamp);
+    void send_invalidate(const std::string& client, const std::string& key, uint64_t version);
+    void drop_client(const std::string& client);
+    Table::iterator erase_entry(Table& table, Table::iterator it);
+    void set_count();
+
+    Transport& transport_;
+    Options options_;
+    std::vector<const KVStore*> stores_;
+    mutable std::mutex mtx_;
+    Table keys_;
+    Table prefixes_;
+    Table leases_;
+    std::map<size_t, size_t> prefix_lengths_; // length -> prefixes watched with it
+    size_t total_ = 0; // watches in keys_ and prefixes_; guarded by mtx_
+    size_t leased_ = 0; // (client, key) pairs in leases_; guarded by mtx_
+    uint64_t now_ms_ = 0; // as of the last handle() or tick(); guarded by mtx_
+    std::atomic<size_t> count_{0}; // total_ + leased_, readable without the lock
+    Gauge& watches_gauge_;
+    Gauge& leases_gauge_;
+    Counter& events_;
+    Counter& invalidations_;
+};
+
+#endif // WATCH_HUB_HPP
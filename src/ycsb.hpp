@@ -0,0 +1,199 @@
+/*
+ * File: ycsb.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: YCSB workload definitions and key generators for kvbench
+*/
+#ifndef YCSB_HPP
+#define YCSB_HPP
+
+#include <string>
+#include <random>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+namespace ycsb
+{
+    // Operations a workload mixes
+    enum class OpKind
+    {
+        READ = 0,
+        UPDATE,
+        INSERT,
+        SCAN, // MULTI_GET over a run of consecutive keys (no range scans in the store)
+        RMW, // read followed by an update of the same key
+        COUNT
+    };
+
+    inline const char* op_name(OpKind op)
+    {
+        static const char* names[] = {"READ", "UPDATE", "INSERT", "SCAN", "RMW"};
+        return names[static_cast<int>(op)];
+    }
+
+    enum class Distribution
+    {
+        UNIFORM = 0,
+        ZIPFIAN,
+        LATEST
+    };
+
+    inline bool parse_distribution(const std::string& s, Distribution& out)
+    {
+        if (s == "uniform") out = Distribution::UNIFORM;
+        else if (s == "zipfian") out = Distribution::ZIPFIAN;
+        else if (s == "latest") out = Distribution::LATEST;
+        else return false;
+        return true;
+    }
+
+    inline const char* distribution_name(Distribution d)
+    {
+        static const char* names[] = {"uniform", "zipfian", "latest"};
+        return names[static_cast<int>(d)];
+    }
+
+    // Operation mix of a core YCSB workload
+    struct Workload
+    {
+        char name;
+        double read, update, insert, scan, rmw; // proportions, summing to 1
+        Distribution distribution; // default request distribution
+    };
+
+    // Core workloads A-F as defined by YCSB
+    inline bool workload(char name, Workload& out)
+    {
+        switch (name)
+        {
+        case 'A': out = {'A', 0.50, 0.50, 0.00, 0.00, 0.00, Distribution::ZIPFIAN}; return true; // update heavy
+        case 'B': out = {'B', 0.95, 0.05, 0.00, 0.00, 0.00, Distribution::ZIPFIAN}; return true; // read mostly
+        case 'C': out = {'C', 1.00, 0.00, 0.00, 0.00, 0.00, Distribution::ZIPFIAN}; return true; // read only
+        case 'D': out = {'D', 0.95, 0.00, 0.05, 0.00, 0.00, Distribution::LATEST}; return true; // read latest
+        case 'E': out = {'E', 0.00, 0.00, 0.05, 0.95, 0.00, Distribution::ZIPFIAN}; return true; // short ranges
+        case 'F': out = {'F', 0.50, 0.00, 0.00, 0.00, 0.50, Distribution::ZIPFIAN}; return true; // read-modify-write
+        default: return false;
+        }
+    }
+
+    // Pick the next operation according to the workload mix
+    template <typename Rng>
+    OpKind choose_op(const Workload& w, Rng& rng)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        if ((u -= w.read) < 0) return OpKind::READ;
+        if ((u -= w.update) < 0) return OpKind::UPDATE;
+        if ((u -= w.insert) < 0) return OpKind::INSERT;
+        if ((u -= w.scan) < 0) return OpKind::SCAN;
+        return (w.rmw > 0 ? OpKind::RMW : OpKind::READ);
+    }
+
+    // 64-bit FNV-1a of an integer, used to scatter zipfian ranks over the keyspace
+    inline uint64_t fnv_hash(uint64_t v)
+    {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (int i = 0; i < 8; ++i)
+        {
+            h ^= v & 0xFF;
+            h *= 0x100000001B3ULL;
+            v >>= 8;
+        }
+        return h;
+    }
+
+    // Zipfian ranks in [0, items) after Gray et al., "Quickly Generating
+    // Billion-Record Synthetic Databases" (the generator YCSB uses). Rank 0
+    // is the most popular. Construction is O(items).
+    class ZipfianGenerator
+    {
+    public:
+        static constexpr double DEFAULT_THETA = 0.99;
+
+        explicit ZipfianGenerator(uint64_t items, double theta = DEFAULT_THETA)
+            : items_(items), theta_(theta)
+        {
+            double zeta2 = zeta(2, theta_);
+            zetan_ = zeta(items_, theta_);
+            alpha_ = 1.0 / (1.0 - theta_);
+            eta_ = (1.0 - std::pow(2.0 / items_, 1.0 - theta_)) / (1.0 - zeta2 / zetan_);
+        }
+
+        template <typename Rng>
+        uint64_t next(Rng& rng) const
+        {
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            double uz = u * zetan_;
+            if (uz < 1.0) return 0;
+            if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+            uint64_t rank = static_cast<uint64_t>(items_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+            return (rank < items_ ? rank : items_ - 1);
+        }
+
+        uint64_t items() const { return items_; }
+
+    private:
+        static double zeta(uint64_t n, double theta)
+        {
+            double sum = 0;
+            for (uint64_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta);
+            return sum;
+        }
+
+        uint64_t items_;
+        double theta_;
+        double zetan_, alpha_, eta_;
+    };
+
+    // Chooses record indices for reads/updates/scans under a distribution.
+    // Inserts append past the loaded records; "latest" favours recent ones.
+    class KeyChooser
+    {
+    public:
+        KeyChooser(Distribution dist, uint64_t records)
+            : dist_(dist), zipf_(records > 1 ? records : 2), inserted_(records)
+        {
+        }
+
+        template <typename Rng>
+        uint64_t next(Rng& rng) const
+        {
+            uint64_t n = inserted_.load(std::memory_order_relaxed);
+            switch (dist_)
+            {
+            case Distribution::UNIFORM:
+                return std::uniform_int_distribution<uint64_t>(0, n - 1)(rng);
+            case Distribution::ZIPFIAN:
+                // Scrambled: popular ranks land anywhere in the keyspace
+                return fnv_hash(zipf_.next(rng)) % n;
+            case Distribution::LATEST:
+            default:
+                {
+                    uint64_t back = zipf_.next(rng) % n;
+                    return n - 1 - back;
+                }
+            }
+        }
+
+        // Reserve the index of a new record
+        uint64_t next_insert()
+        {
+            return inserted_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t records() const { return inserted_.load(std::memory_order_relaxed); }
+
+    private:
+        Distribution dist_;
+        ZipfianGenerator zipf_;
+        std::atomic<uint64_t> inserted_;
+    };
+
+    inline std::string key_name(uint64_t index)
+    {
+        return "user" + std::to_string(index);
+    }
+} // namespace ycsb
+
+#endif // YCSB_HPP
@@ -0,0 +1,67 @@
+/*
+ * File: recording_transport.hpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Transport double shared by the replica-level tests
+*/
+#ifndef RECORDING_TRANSPORT_HPP
+#define RECORDING_TRANSPORT_HPP
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "../src/message.hpp"
+#include "../src/network.hpp"
+
+// Records every message sent and where to; sends to addresses in down fail
+// like a refused connection (and are still recorded). Node ids are their
+// own addresses. Sends may race; read the records once they are done.
+class RecordingTransport : public Transport
+{
+public:
+    bool send_message(const std::string& dest_addr, const Message& msg) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        dests.push_back(dest_addr);
+        sent.push_back(msg);
+        return !down.count(dest_addr);
+    }
+
+    std::string get_addr(const std::string& node_id) override { return node_id; }
+
+    // Messages of type sent to dest
+    int count(const std::string& dest, MessageType type) const
+    {
+        int n = 0;
+        for (size_t i = 0; i < sent.size(); ++i) n += dests[i] == dest && sent[i].type == type;
+        return n;
+    }
+
+    // WATCH_EVENTs delivered to client, in order sent, as "key=value@version"
+    std::vector<std::string> events(const std::string& client) const
+    {
+        std::vector<std::string> out;
+        for (size_t i = 0; i < sent.size(); ++i)
+        {
+            const Message& m = sent[i];
+            if (m.type == MessageType::WATCH_EVENT && m.client_id == client && !down.count(dests[i]))
+                out.push_back(m.key + "=" + m.value + "@" + std::to_string(m.version));
+        }
+        return out;
+    }
+
+    void clear()
+    {
+        sent.clear();
+        dests.clear();
+    }
+
+    std::mutex mtx;
+    std::set<std::string> down;
+    std::vector<Message> sent;
+    std::vector<std::string> dests; // dests[i] is where sent[i] went
+};
+
+#endif // RECORDING_TRANSPORT_HPP
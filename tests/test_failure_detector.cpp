@@ -0,0 +1,174 @@
+/*
+ * File: test_failure_detector.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Failure detector and peer exclusion tests
+*/
+#include <cassert>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/failure_detector.hpp"
+#include "../src/replica.hpp"
+#include "recording_transport.hpp"
+
+// Regular heartbeats keep a peer UP; silence moves it to SUSPECT, then DOWN
+static void silence()
+{
+    FailureDetector fd({"B"}, FailureDetector::Options());
+    uint64_t now = 1000;
+    assert(fd.tick(now).empty());
+    for (int i = 0; i < 50; ++i)
+    {
+        now += 100;
+        fd.heard("B", now);
+        assert(fd.tick(now).empty());
+    }
+    assert(fd.state("B") == FailureDetector::State::UP);
+
+    // phi = t / (100 ms * ln 10): suspect from ~691 ms, down from ~1843 ms
+    auto changed = fd.tick(now + 600);
+    assert(changed.empty());
+    changed = fd.tick(now + 800);
+    assert(changed.size() == 1 && changed[0].second == FailureDetector::State::SUSPECT);
+    changed = fd.tick(now + 2000);
+    assert(changed.size() == 1 && changed[0].second == FailureDetector::State::DOWN);
+    assert(fd.phi("B", now + 2000) > 8.0);
+
+    // Back again: UP at once, and the outage is not learned as a gap
+    fd.heard("B", now + 5000);
+    changed = fd.tick(now + 5000);
+    assert(changed.size() == 1 && changed[0].second == FailureDetector::State::UP);
+    assert(fd.tick(now + 5600).empty());
+}
+
+// Slow but steady heartbeats raise the mean gap, so the same silence that
+// would mark a fast peer SUSPECT leaves this one UP
+static void adapts_to_interval()
+{
+    FailureDetector fd({"B"}, FailureDetector::Options());
+    uint64_t now = 0;
+    fd.tick(now);
+    for (int i = 0; i < 100; ++i)
+    {
+        now += 400;
+        fd.heard("B", now);
+    }
+    assert(fd.tick(now + 800).empty());
+    assert(fd.state("B") == FailureDetector::State::UP);
+}
+
+// A failed send is DOWN at once and stays DOWN until the peer is heard from;
+// never-heard peers and unknown names are handled
+static void send_failure()
+{
+    FailureDetector fd({"B", "C"}, FailureDetector::Options());
+    fd.tick(0);
+    fd.send_failed("B");
+    assert(fd.state("B") == FailureDetector::State::DOWN);
+    auto changed = fd.tick(10);
+    assert(changed.size() == 1 && changed[0].first == "B");
+    assert(fd.tick(20).empty());
+    assert(fd.state("B") == FailureDetector::State::DOWN);
+    fd.heard("B", 30);
+    assert(fd.state("B") == FailureDetector::State::UP);
+
+    // C has never sent a heartbeat: its silence is timed from the first tick
+    assert(fd.state("C") == FailureDetector::State::UP);
+    fd.tick(2000);
+    assert(fd.state("C") == FailureDetector::State::DOWN);
+
+    fd.heard("X", 40);
+    fd.send_failed("X");
+    assert(fd.state("X") == FailureDetector::State::UP);
+}
+
+static Message put(const std::string& op_id)
+{
+    Message msg;
+    msg.type = MessageType::PUT_REQUEST;
+    msg.client_id = "c";
+    msg.op_id = op_id;
+    msg.key = "k";
+    msg.value = "v";
+    return msg;
+}
+
+// Once a send to C fails, writes stop fanning out to it until it is heard
+// from again
+static void replica_skips_down_peers()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    FailureDetector fd({"B", "C"}, FailureDetector::Options());
+    fd.heard("B", 0);
+    fd.heard("C", 0);
+    Replica::Options options;
+    options.detector = &fd;
+    Replica replica("A", {"B", "C"}, net, registry, options);
+
+    net.down.insert("C");
+    replica.handle(put("c:1"));
+    assert(net.count("C", MessageType::MULTICAST_OP) == 1);
+    assert(fd.state("C") == FailureDetector::State::DOWN);
+
+    replica.handle(put("c:2"));
+    assert(net.count("B", MessageType::MULTICAST_OP) == 2);
+    assert(net.count("C", MessageType::MULTICAST_OP) == 1);
+
+    net.down.clear();
+    fd.heard("C", 100);
+    replica.handle(put("c:3"));
+    assert(net.count("C", MessageType::MULTICAST_OP) == 2);
+}
+
+// A COMMIT goes to every peer an op reached, even one DOWN by the time
+// the quorum forms, and to none the op skipped
+static void commit_reaches_holders()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    FailureDetector fd({"B", "C"}, FailureDetector::Options());
+    fd.heard("B", 0);
+    fd.heard("C", 0);
+    Replica::Options options;
+    options.detector = &fd;
+    Replica replica("A", {"B", "C"}, net, registry, options);
+
+    replica.handle(put("c:1"));
+    std::string first = net.sent.back().op_id;
+    net.down.insert("C");
+    replica.handle(put("c:2"));
+    std::string second = net.sent.back().op_id;
+    assert(fd.state("C") == FailureDetector::State::DOWN);
+    net.down.clear();
+
+    for (const auto& op_id : {first, second})
+    {
+        Message ack;
+        ack.type = MessageType::ACK;
+        ack.op_id = op_id;
+        ack.replica_id = "B";
+        replica.handle(ack);
+    }
+    // c:1 reached C before it went DOWN; c:2 never did
+    assert(net.count("B", MessageType::COMMIT) == 2);
+    assert(net.count("C", MessageType::COMMIT) == 1);
+    for (size_t i = 0; i < net.sent.size(); ++i)
+    {
+        if (net.dests[i] == "C" && net.sent[i].type == MessageType::COMMIT) assert(net.sent[i].op_id == first);
+    }
+}
+
+int main()
+{
+    assert(std::string(FailureDetector::state_name(FailureDetector::State::SUSPECT)) == "suspect");
+    silence();
+    adapts_to_interval();
+    send_failure();
+    replica_skips_down_peers();
+    commit_reaches_holders();
+    return 0;
+}
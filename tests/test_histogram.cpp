@@ -0,0 +1,68 @@
+/*
+ * File: test_histogram.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Latency histogram tests
+*/
+#include <cassert>
+#include <sstream>
+#include "../src/histogram.hpp"
+
+int main()
+{
+    LatencyHistogram h;
+    assert(h.count() == 0 && h.percentile(99) == 0 && h.max() == 0);
+
+    // Small values are exact
+    for (uint64_t v = 1; v <= 100; ++v) h.record(v);
+    assert(h.count() == 100);
+    assert(h.min() == 1 && h.max() == 100);
+    assert(h.percentile(50) == 50);
+    assert(h.percentile(99) == 99);
+    assert(h.percentile(100) == 100);
+    assert(h.mean() == 50.5);
+
+    // Large values stay within the relative error bound (2^-9 at 10 bits)
+    LatencyHistogram big;
+    for (uint64_t v = 1; v <= 1000000; ++v) big.record(v * 10);
+    uint64_t p999 = big.percentile(99.9);
+    assert(p999 >= 9990000 && p999 <= 9990000 + 9990000 / 512);
+    assert(big.percentile(100) == 10000000);
+
+    // A single outlier shows up in the tail but not the median
+    LatencyHistogram tail;
+    for (int i = 0; i < 9999; ++i) tail.record(100);
+    tail.record(50000);
+    assert(tail.percentile(50) == 100);
+    assert(tail.percentile(99.99) == 100);
+    assert(tail.percentile(100) == 50000);
+
+    // Merging adds counts
+    LatencyHistogram merged;
+    assert(merged.merge(h) && merged.merge(tail));
+    assert(merged.count() == h.count() + tail.count());
+    assert(merged.min() == 1 && merged.max() == 50000);
+
+    // Layouts must match to merge
+    LatencyHistogram coarse(7, 1 << 20);
+    assert(!coarse.merge(h));
+
+    // Save/load round-trips
+    std::stringstream ss;
+    merged.save(ss);
+    LatencyHistogram loaded;
+    assert(LatencyHistogram::load(ss, loaded));
+    assert(loaded.count() == merged.count());
+    assert(loaded.percentile(50) == merged.percentile(50));
+    assert(loaded.percentile(99.99) == merged.percentile(99.99));
+    assert(loaded.max() == merged.max() && loaded.mean() == merged.mean());
+
+    std::stringstream bad("not a histogram");
+    assert(!LatencyHistogram::load(bad, loaded));
+
+    h.reset();
+    assert(h.count() == 0 && h.percentile(50) == 0);
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * File: test_hlc.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Hybrid logical clock tests
+*/
+#include <cassert>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "../src/hlc.hpp"
+
+using HLC = HybridLogicalClock;
+
+static uint64_t fake_ms = 1000;
+static uint64_t fake_clock() { return fake_ms; }
+
+int main()
+{
+    HLC clock(fake_clock);
+
+    // Initial state
+    assert(clock.read() == 0);
+
+    // First tick jumps to physical time with a zero logical counter
+    uint64_t t1 = clock.tick();
+    assert(t1 == HLC::make(1000));
+    assert(HLC::physical_ms(t1) == 1000 && HLC::logical(t1) == 0);
+
+    // Physical time stalls: the logical counter advances
+    uint64_t t2 = clock.tick();
+    assert(t2 == HLC::make(1000, 1));
+
+    // Physical time moves on: logical counter resets
+    fake_ms = 1005;
+    uint64_t t3 = clock.tick();
+    assert(t3 == HLC::make(1005));
+
+    // Received timestamp ahead of local physical time is adopted + 1
+    uint64_t remote = HLC::make(2000, 3);
+    uint64_t t4 = clock.update(remote);
+    assert(t4 == HLC::make(2000, 4));
+    assert(clock.read() == t4);
+
+    // Older received timestamp still advances the clock
+    uint64_t t5 = clock.update(HLC::make(10));
+    assert(t5 == HLC::make(2000, 5));
+
+    // Logical overflow carries into the millisecond field, staying monotonic
+    HLC carry(fake_clock);
+    carry.update(HLC::make(5000, HLC::LOGICAL_MASK - 1));
+    uint64_t c1 = carry.tick();
+    assert(c1 == HLC::make(5001, 0));
+
+    // Concurrent ticks and updates never hand out the same timestamp twice
+    HLC shared(fake_clock);
+    const int threads = 4, per_thread = 10000;
+    std::vector<std::vector<uint64_t>> seen(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (int i = 0; i < per_thread; ++i)
+            {
+                seen[t].push_back(i % 2 ? shared.tick() : shared.update(HLC::make(1005, i)));
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    std::vector<uint64_t> all;
+    for (const auto& v : seen)
+    {
+        // Each thread observes a strictly increasing sequence
+        assert(std::is_sorted(v.begin(), v.end()) && std::adjacent_find(v.begin(), v.end()) == v.end());
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    assert(std::adjacent_find(all.begin(), all.end()) == all.end());
+
+    return 0;
+}
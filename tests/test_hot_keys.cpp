@@ -0,0 +1,164 @@
+/*
+ * File: test_hot_keys.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Hot-key detection tests
+*/
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../src/hot_keys.hpp"
+#include "../src/replica.hpp"
+#include "../src/watch_hub.hpp"
+#include "recording_transport.hpp"
+
+// Heavy hitters keep their counters through a stream of one-off keys, and
+// their guaranteed counts never exceed the true ones
+static void space_saving()
+{
+    SpaceSaving sketch(4);
+    for (int i = 0; i < 1000; ++i)
+    {
+        sketch.add("hot");
+        if (i % 2 == 0) sketch.add("warm");
+        sketch.add("cold" + std::to_string(i));
+    }
+    assert(sketch.total() == 2500);
+    auto top = sketch.top(2);
+    assert(top.size() == 2 && top[0].first == "hot" && top[1].first == "warm");
+    assert(top[0].second.count - top[0].second.error <= 1000 && top[0].second.count >= 1000);
+    assert(top[1].second.count - top[1].second.error <= 500 && top[1].second.count >= 500);
+    assert(sketch.top(10).size() == 4);
+    sketch.clear();
+    assert(sketch.total() == 0 && sketch.top(10).empty());
+
+    // Bounds hold for every counter of a skewed stream with many takeovers
+    SpaceSaving skewed(16);
+    std::unordered_map<std::string, uint64_t> truth;
+    for (uint64_t i = 1; i <= 20000; ++i)
+    {
+        // Five heavy keys among one-off ones
+        std::string key = "k" + std::to_string(i % 7 == 0 ? i % 5 : i);
+        skewed.add(key);
+        ++truth[key];
+    }
+    uint64_t counted = 0;
+    for (const auto& [key, counter] : skewed.top(16))
+    {
+        assert(counter.count - counter.error <= truth[key] && truth[key] <= counter.count);
+        counted += counter.count;
+    }
+    assert(counted == skewed.total());
+}
+
+static void read(HotKeys& hot, const std::string& key, int times)
+{
+    for (int i = 0; i < times; ++i) hot.record(key);
+}
+
+// A key turns hot at hot_rate over a window and cools below half of it
+static void detection()
+{
+    MetricsRegistry registry;
+    HotKeys::Options options;
+    options.hot_rate = 100;
+    HotKeys hot(registry, options);
+    hot.tick(0);
+    read(hot, "a", 150);
+    read(hot, "b", 90);
+    assert(!hot.record("a"));
+    hot.tick(1000);
+    assert(hot.hot("a") && !hot.hot("b") && hot.record("a"));
+    assert((hot.hot_keys() == std::vector<std::string>{"a"}));
+
+    // 60/s keeps a hot key hot; a window at 40/s cools it
+    read(hot, "a", 60);
+    read(hot, "b", 60);
+    hot.tick(2000);
+    assert(hot.hot("a") && !hot.hot("b"));
+    read(hot, "a", 40);
+    hot.tick(3000);
+    assert(!hot.hot("a"));
+
+    // Rates are per second over the window's actual length
+    read(hot, "c", 150);
+    hot.tick(5000);
+    assert(!hot.hot("c"));
+
+    std::ostringstream os;
+    registry.write_prometheus(os);
+    std::string text = os.str();
+    assert(text.find("kv_hot_key_detections_total 1") != std::string::npos);
+    assert(text.find("kv_hot_keys 0") != std::string::npos);
+    assert(text.find("kv_top_key_reads_per_second{rank=\"1\"} 75") != std::string::npos);
+}
+
+// Reads recorded on different threads are summed when the window closes
+static void threads_merge()
+{
+    MetricsRegistry registry;
+    HotKeys::Options options;
+    options.hot_rate = 100;
+    HotKeys hot(registry, options);
+    hot.tick(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) readers.emplace_back([&hot] { read(hot, "m", 30); });
+    for (auto& t : readers) t.join();
+    hot.tick(1000);
+    assert(hot.hot("m"));
+    std::thread([&hot] { assert(hot.record("m")); }).join();
+}
+
+// GET replies for hot keys are marked; they are leased only to clients that
+// ask for hot keys' leases
+static void replica_marks_hot_reads()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub hub(net, registry, WatchHub::Options());
+    HotKeys::Options hot_options;
+    hot_options.hot_rate = 10;
+    HotKeys hot(registry, hot_options);
+    Replica::Options options;
+    options.watches = &hub;
+    options.hot_keys = &hot;
+    Replica replica("A", {"B"}, net, registry, options);
+
+    Message get;
+    get.type = MessageType::GET_REQUEST;
+    get.client_id = "c";
+    get.op_id = "c:1";
+    get.key = "k";
+    hot.tick(0);
+    for (int i = 0; i < 10; ++i) replica.handle_read(get);
+    assert(!net.sent.back().hot && net.sent.back().max_staleness_ms == 0);
+    Message mget = get;
+    mget.type = MessageType::MULTI_GET_REQUEST;
+    mget.entries = {{"m", ""}};
+    for (int i = 0; i < 10; ++i) replica.handle_read(mget);
+    hot.tick(1000);
+    assert(hot.hot("m"));
+
+    replica.handle_read(get);
+    assert(net.sent.back().hot && net.sent.back().max_staleness_ms == 0 && hub.leases() == 0);
+    get.value = "hot";
+    replica.handle_read(get);
+    assert(net.sent.back().hot && net.sent.back().max_staleness_ms == WatchHub::Options().cache_lease_ms);
+    assert(hub.leases() == 1);
+    get.key = "cold";
+    replica.handle_read(get);
+    assert(!net.sent.back().hot && net.sent.back().max_staleness_ms == 0 && hub.leases() == 1);
+}
+
+int main()
+{
+    space_saving();
+    detection();
+    threads_merge();
+    replica_marks_hot_reads();
+    return 0;
+}
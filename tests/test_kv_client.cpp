@@ -0,0 +1,221 @@
+/*
+ * File: test_kv_client.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Client library against a replica in a child process
+*/
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../src/kv_client.hpp"
+#include "../src/network.hpp"
+#include "../src/replica.hpp"
+
+// Run serve(msg) in a child process for every message sent to replica "A",
+// until killed; returns the child's pid
+static pid_t serve_as_a(const char* path, const std::function<void(const Message&)>& serve)
+{
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child != 0) return child;
+    // Gone with the test, even when an assertion aborts it
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    std::vector<std::string> peers;
+    int listen_port;
+    network::init("A", path, peers, listen_port);
+    Message in;
+    while (true)
+    {
+        if (network::receive_message(in, /*timeout_ms=*/1000)) serve(in);
+    }
+}
+
+// Wait until the child accepts connections on port
+static void await_listening(int port)
+{
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &sa.sin_addr);
+    for (int i = 0; i < 500; ++i)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        bool up = connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0;
+        close(fd);
+        if (up) return;
+        usleep(10000);
+    }
+    assert(false);
+}
+
+static void stop(pid_t child)
+{
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+}
+
+template <typename T>
+static T await(std::future<T> fut)
+{
+    assert(fut.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    return fut.get();
+}
+
+// Replicas "A" and "B" in one process: A is reached over the network, B
+// only through A, by direct calls
+class Pair : public Transport
+{
+public:
+    Pair() : a_("A", {"B"}, *this, registry_, Replica::Options()), b_("B", {"A"}, *this, registry_, Replica::Options()) {}
+
+    void handle(const Message& msg)
+    {
+        a_.handle(msg);
+        while (!local_.empty())
+        {
+            auto [dest, next] = std::move(local_.front());
+            local_.pop_front();
+            (dest == "A" ? a_ : b_).handle(next);
+        }
+    }
+
+    bool send_message(const std::string& dest_addr, const Message& msg) override
+    {
+        if (dest_addr != "A" && dest_addr != "B") return network::send_message(dest_addr, msg);
+        local_.emplace_back(dest_addr, msg);
+        return true;
+    }
+
+    std::string get_addr(const std::string& node_id) override
+    {
+        return (node_id == "A" || node_id == "B" ? node_id : network::get_addr(node_id));
+    }
+
+private:
+    MetricsRegistry registry_;
+    Replica a_;
+    Replica b_;
+    std::deque<std::pair<std::string, Message>> local_;
+};
+
+// Keys and values may hold the wire format's delimiters
+static void round_trip(int port)
+{
+    const char* path = "/tmp/kv_test_kv_client.txt";
+    std::ofstream(path) << "A 127.0.0.1 " << port << "\n"
+                        << "c 127.0.0.1 " << port + 1 << "\n";
+    pid_t child = serve_as_a(path, [](const Message& msg)
+    {
+        static Pair pair;
+        pair.handle(msg);
+    });
+    await_listening(port);
+
+    KVClient kv("c", path);
+    const std::vector<std::pair<std::string, std::string>> odd = {
+        {"k|1", "a|b"}, {"k\n2", "line\nbreak"}, {"k\\p3", "\\|\n\\n"}, {"|", ""}};
+    for (const auto& [key, value] : odd)
+    {
+        KVResult put = await(kv.async_put(key, value));
+        assert(put.ok);
+        KVResult get = await(kv.async_get(key));
+        assert(get.ok && get.key == key && get.value == value);
+    }
+    KVResult append = await(kv.async_append("k|1", "|c\n"));
+    assert(append.ok);
+    assert(await(kv.async_get("k|1")).value == "a|b|c\n");
+    KVResult cas = await(kv.async_cas("k\n2", "line\nbreak", "x|y"));
+    assert(cas.ok);
+
+    std::vector<std::pair<std::string, std::string>> batch = {{"m|1", "v\n1"}, {"m\n2", "v|2"}};
+    KVResult mput = await(kv.async_multi_put(batch));
+    assert(mput.ok);
+    KVResult mget = await(kv.async_multi_get({"m|1", "m\n2", "k\n2"}));
+    assert(mget.ok && mget.entries.size() == 3);
+    assert(mget.entries[0] == batch[0] && mget.entries[1] == batch[1]);
+    assert(mget.entries[2].second == "x|y");
+
+    kv.shutdown();
+    stop(child);
+    std::remove(path);
+}
+
+static void reply_get(const Message& request, bool ok, uint64_t seq)
+{
+    Message resp;
+    resp.type = MessageType::GET_RESPONSE;
+    resp.op_id = request.op_id;
+    resp.key = request.key;
+    resp.value = "v";
+    resp.ok = ok;
+    resp.seq = seq;
+    network::send_message(network::get_addr(request.client_id), resp);
+}
+
+// A bounded read's first attempt times out and its decline arrives only
+// after the second attempt's, while the read waits out the declined pause.
+// The late decline is dropped: the read is retried once, completes, and
+// leaves the window as it found it, so later requests are still sent.
+static void late_decline(int port)
+{
+    const char* path = "/tmp/kv_test_kv_client.txt";
+    std::ofstream(path) << "A 127.0.0.1 " << port << "\n"
+                        << "c 127.0.0.1 " << port + 1 << "\n";
+    pid_t child = serve_as_a(path, [](const Message& msg)
+    {
+        static int bounded = 0;
+        static Message first;
+        if (msg.max_staleness_ms == 0)
+        {
+            reply_get(msg, true, msg.seq);
+            return;
+        }
+        switch (++bounded)
+        {
+        case 1:
+            first = msg;
+            break;
+        case 2:
+            reply_get(msg, false, msg.seq);
+            reply_get(first, false, first.seq);
+            break;
+        default:
+            reply_get(msg, true, msg.seq);
+        }
+    });
+    await_listening(port);
+
+    KVClient::Options options;
+    options.request_timeout_ms = 200;
+    options.retry_rounds = 3;
+    options.declined_pause_ms = 300;
+    KVClient kv("c", path, options);
+    KVResult read = await(kv.async_get("k", /*max_staleness_ms=*/50));
+    assert(read.ok && read.value == "v");
+    for (int i = 0; i < 3; ++i) assert(await(kv.async_get("k")).ok);
+    assert(kv.in_flight() == 0);
+
+    kv.shutdown();
+    stop(child);
+    std::remove(path);
+}
+
+int main()
+{
+    round_trip(5086);
+    late_decline(5084);
+    return 0;
+}
@@ -11,6 +11,9 @@
 #include "../src/message.hpp"
 
 #include <cassert>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "../src/kv_store.hpp"
 #include "../src/message.hpp"
 
@@ -53,5 +56,149 @@ int main()
     store.commit("op2");
     assert(store.get("key2") == "value2");
 
+    // Multi-key operation stays invisible until commit, then lands as a unit
+    Message multi;
+    multi.type = MessageType::MULTICAST_OP;
+    multi.op_id = "op3";
+    multi.entries = {{"key3", "value3"}, {"key4", "value4"}, {"key1", "value1b"}};
+    store.apply(multi);
+    assert(store.get("key3").empty() && store.get("key4").empty());
+    assert(store.get("key1") == "value1");
+    store.commit("op3");
+    assert(store.get("key3") == "value3");
+    assert(store.get("key4") == "value4");
+    assert(store.get("key1") == "value1b");
+
+    // Multi-get preserves request order and reports missing keys as empty
+    auto got = store.multi_get({"key4", "missing", "key2"});
+    assert(got.size() == 3);
+    assert(got[0].first == "key4" && got[0].second == "value4");
+    assert(got[1].first == "missing" && got[1].second.empty());
+    assert(got[2].first == "key2" && got[2].second == "value2");
+
+    // Every committed write bumps the key's version
+    assert(store.version("key1") == 2);
+    assert(store.version("missing") == 0);
+
+    // Value-conditional CAS: succeeds only on a match
+    Message cas;
+    cas.type = MessageType::MULTICAST_OP;
+    cas.op = MessageType::CAS_REQUEST;
+    cas.op_id = "op4";
+    cas.key = "key1";
+    cas.expected = "stale";
+    cas.value = "value1c";
+    store.apply(cas);
+    OpResult r = store.commit("op4");
+    assert(r.found && !r.ok);
+    assert(r.value == "value1b" && r.version == 2);
+    cas.op_id = "op5";
+    cas.expected = "value1b";
+    store.apply(cas);
+    r = store.commit("op5");
+    assert(r.ok && r.value == "value1c" && r.version == 3);
+
+    // Version-conditional CAS
+    cas.op_id = "op6";
+    cas.version = 3;
+    cas.value = "value1d";
+    store.apply(cas);
+    assert(store.commit("op6").ok);
+    cas.op_id = "op7";
+    store.apply(cas);
+    assert(!store.commit("op7").ok);
+    assert(store.get("key1") == "value1d");
+
+    // INCR treats a missing key as 0 and defaults to a delta of 1
+    Message incr;
+    incr.type = MessageType::MULTICAST_OP;
+    incr.op = MessageType::INCR_REQUEST;
+    incr.key = "counter";
+    incr.op_id = "op8";
+    store.apply(incr);
+    assert(store.commit("op8").value == "1");
+    incr.op_id = "op9";
+    incr.value = "-5";
+    store.apply(incr);
+    assert(store.commit("op9").value == "-4");
+    // INCR on a non-numeric value is rejected and leaves it unchanged
+    incr.op_id = "op10";
+    incr.key = "key2";
+    store.apply(incr);
+    assert(!store.commit("op10").ok);
+    assert(store.get("key2") == "value2");
+
+    // APPEND concatenates onto the committed value
+    Message append;
+    append.type = MessageType::MULTICAST_OP;
+    append.op = MessageType::APPEND_REQUEST;
+    append.key = "key2";
+    append.value = "-tail";
+    append.op_id = "op11";
+    store.apply(append);
+    assert(store.commit("op11").value == "value2-tail");
+
+    // Unknown op_id reports not found
+    assert(!store.commit("op11").found);
+
+    // Watermark trails the oldest pending op and catches up on commit, but
+    // never passes the caller's closed timestamp
+    KVStore wm;
+    assert(wm.watermark(100) == 100);
+    Message early = msg, late = msg;
+    early.op_id = "A:50";
+    early.timestamp = 50;
+    late.op_id = "B:80";
+    late.timestamp = 80;
+    wm.apply(late);
+    wm.apply(early);
+    assert(wm.watermark(100) == 49);
+    assert(wm.watermark(20) == 20);
+    assert((wm.pending_through("A:", 100) == std::vector<std::string>{"A:50"}));
+    assert((wm.pending_through("", 100) == std::vector<std::string>{"A:50", "B:80"}));
+    assert(wm.pending_through("B:", 79).empty());
+    assert(wm.commit("B:80").timestamp == 80);
+    assert(wm.watermark(100) == 49);
+    wm.commit("A:50");
+    assert(wm.watermark(100) == 100);
+    // A committed op does not vouch for others at or below it
+    assert(wm.watermark(10) == 10);
+
+    // Readers on other threads see each commit whole: a value always
+    // matches its version, and versions never go backwards
+    KVStore shared;
+    std::atomic<bool> writing{true};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r)
+    {
+        readers.emplace_back([&shared, &writing]
+        {
+            uint64_t last = 0;
+            while (writing.load())
+            {
+                auto [value, version] = shared.get_versioned("hot");
+                assert(value == (version ? "v" + std::to_string(version) : ""));
+                assert(version >= last);
+                last = version;
+                auto both = shared.multi_get({"hot", "other"});
+                assert(both.size() == 2 && both[1].second.empty());
+            }
+        });
+    }
+    for (int i = 1; i <= 20000; ++i)
+    {
+        Message w;
+        w.type = MessageType::MULTICAST_OP;
+        w.op_id = "w" + std::to_string(i);
+        w.key = "hot";
+        w.value = "v" + std::to_string(i);
+        w.timestamp = i;
+        shared.apply(w);
+        shared.commit(w.op_id);
+    }
+    writing.store(false);
+    for (auto& t : readers) t.join();
+    assert(shared.version("hot") == 20000);
+
     return 0;
 }
@@ -0,0 +1,68 @@
+/*
+ * File: test_logger.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Asynchronous logger tests
+*/
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "../src/logger.hpp"
+
+static int evaluated = 0;
+
+static int side_effect()
+{
+    return ++evaluated;
+}
+
+int main()
+{
+    const char* path = "test_logger.log";
+    std::remove(path);
+    logging::Level level;
+    assert(logging::parse_level("debug", level) && level == logging::Level::DEBUG);
+    assert(!logging::parse_level("loud", level));
+
+    logging::init(path, logging::Level::INFO, "T");
+
+    // Disabled levels do not evaluate their arguments
+    KV_LOG(DEBUG, "hidden", {"n", side_effect()});
+    assert(evaluated == 0);
+    assert(!logging::enabled(logging::Level::TRACE) && logging::enabled(logging::Level::WARN));
+
+    // Structured fields of every type, quoted when needed
+    KV_LOG(INFO, "put", {"key", std::string("x")}, {"value", "two words"}, {"n", -3}, {"seq", 7u});
+    KV_LOG(WARN, "empty", {"v", ""});
+
+    // Records from other threads are written too
+    std::thread([] { KV_LOG(ERROR, "from_thread"); }).join();
+
+    // Rate-limited call sites drop calls beyond their budget
+    for (int i = 0; i < 10; ++i)
+    {
+        KV_LOG_RATE(INFO, 3, "limited", {"i", i});
+    }
+
+    logging::shutdown();
+
+    std::ifstream ifs(path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    std::string text = ss.str();
+    assert(text.find("hidden") == std::string::npos);
+    assert(text.find("INFO [T] put key=x value=\"two words\" n=-3 seq=7\n") != std::string::npos);
+    assert(text.find("WARN [T] empty v=\"\"\n") != std::string::npos);
+    assert(text.find("ERROR [T/1] from_thread\n") != std::string::npos);
+    size_t limited = 0;
+    for (size_t pos = text.find("limited"); pos != std::string::npos; pos = text.find("limited", pos + 1)) ++limited;
+    assert(limited == 3);
+    assert(logging::dropped() == 0);
+
+    std::remove(path);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * File: test_message.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Message round trips
+*/
+#include <cassert>
+#include <stdexcept>
+#include "../src/message.hpp"
+
+int main()
+{
+    // Single-key message round trip
+    Message put;
+    put.type = MessageType::PUT_REQUEST;
+    put.key = "x";
+    put.value = "42";
+    put.timestamp = 7;
+    put.client_id = "client1";
+    put.op_id = "client1:1";
+    Message put2 = Message::deserialize(put.serialize());
+    assert(put2.type == MessageType::PUT_REQUEST);
+    assert(put2.key == "x" && put2.value == "42");
+    assert(put2.timestamp == 7);
+    assert(put2.client_id == "client1" && put2.replica_id.empty());
+    assert(put2.op_id == "client1:1");
+    assert(put2.entries.empty());
+
+    // Multi-key message carries every entry in one frame
+    Message mput;
+    mput.type = MessageType::MULTI_PUT_REQUEST;
+    mput.client_id = "client1";
+    mput.op_id = "client1:2";
+    mput.entries = {{"a", "1"}, {"b", ""}, {"c", "3"}};
+    Message mput2 = Message::deserialize(mput.serialize());
+    assert(mput2.type == MessageType::MULTI_PUT_REQUEST);
+    assert(mput2.op_id == "client1:2");
+    assert(mput2.entries == mput.entries);
+
+    // Replicated CAS keeps the carried op, condition and outcome
+    Message cas;
+    cas.type = MessageType::MULTICAST_OP;
+    cas.op = MessageType::CAS_REQUEST;
+    cas.key = "k";
+    cas.expected = "old";
+    cas.value = "new";
+    cas.version = 9;
+    cas.ok = false;
+    Message cas2 = Message::deserialize(cas.serialize());
+    assert(cas2.type == MessageType::MULTICAST_OP);
+    assert(cas2.op == MessageType::CAS_REQUEST);
+    assert(cas2.expected == "old" && cas2.value == "new");
+    assert(cas2.version == 9 && !cas2.ok);
+
+    // Trace stamps travel with the message; the arrival stamp is local only
+    Message ack;
+    ack.type = MessageType::ACK;
+    ack.trace_ns = 123456789;
+    ack.trace_hold_ns = 4321;
+    ack.received_ns = 99;
+    Message ack2 = Message::deserialize(ack.serialize());
+    assert(ack2.trace_ns == 123456789 && ack2.trace_hold_ns == 4321);
+    assert(ack2.received_ns == 0);
+
+    Message get_resp;
+    get_resp.type = MessageType::GET_RESPONSE;
+    get_resp.hot = true;
+    assert(Message::deserialize(get_resp.serialize()).hot && !Message::deserialize(ack.serialize()).hot);
+    get_resp.error = "cross_shard";
+    assert(Message::deserialize(get_resp.serialize()).error == "cross_shard");
+
+    // Trailing empty value survives the round trip
+    Message mget;
+    mget.type = MessageType::MULTI_GET_REQUEST;
+    mget.entries = {{"a", ""}, {"b", ""}};
+    Message mget2 = Message::deserialize(mget.serialize());
+    assert(mget2.entries == mget.entries);
+
+    // A wire frame is the serialized form plus its terminating newline
+    assert(mget.frame() == mget.serialize() + "\n");
+
+    // String fields carry delimiters, newlines and backslashes; the frame
+    // still has exactly one newline, at its end
+    Message odd;
+    odd.type = MessageType::MULTI_PUT_REQUEST;
+    odd.key = "k|1";
+    odd.value = "a|b\nc\\p";
+    odd.expected = "\\";
+    odd.error = "x\n";
+    odd.entries = {{"e|k", "v\n|"}, {"\\n", ""}};
+    std::string frame = odd.frame();
+    assert(frame.find('\n') == frame.size() - 1);
+    Message odd2 = Message::deserialize(odd.serialize());
+    assert(odd2.key == odd.key && odd2.value == odd.value && odd2.expected == odd.expected);
+    assert(odd2.error == odd.error && odd2.entries == odd.entries);
+
+    // Malformed input throws instead of yielding a message
+    for (const char* bad : {"garbage", "1|k\\q|v|0", "x|y|z"})
+    {
+        bool threw = false;
+        try
+        {
+            Message::deserialize(bad);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * File: test_metrics.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Metrics registry tests
+*/
+#include <cassert>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "../src/metrics.hpp"
+#include "../src/replica.hpp"
+#include "recording_transport.hpp"
+
+static bool contains(const std::string& text, const std::string& line)
+{
+    return text.find(line) != std::string::npos;
+}
+
+// A replica counts every message type it is handed, the newest included
+static void replica_counts_received()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    Replica replica("A", {"B"}, net, registry, Replica::Options());
+    Message closed;
+    closed.type = MessageType::CLOSED;
+    closed.op_id = "B:";
+    closed.replica_id = "B";
+    closed.timestamp = 1;
+    replica.handle(closed);
+    replica.handle(closed);
+
+    std::ostringstream oss;
+    registry.write_prometheus(oss);
+    std::string text = oss.str();
+    assert(contains(text, "kv_messages_received_total{type=\"CLOSED\"} 2\n"));
+    assert(contains(text, "kv_messages_received_total{type=\"HEARTBEAT\"} 0\n"));
+}
+
+int main()
+{
+    MetricsRegistry registry;
+
+    // Counters sum increments from every thread
+    Counter& ops = registry.counter("ops_total", "Operations");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&ops] { for (int i = 0; i < 10000; ++i) ops.inc(); });
+    }
+    for (auto& t : threads) t.join();
+    assert(ops.value() == 40000);
+
+    // Registering the same series again returns the same metric
+    assert(&registry.counter("ops_total", "Operations") == &ops);
+
+    Gauge& depth = registry.gauge("queue_depth", "Queued messages");
+    depth.set(7);
+    depth.add(-2);
+    assert(depth.value() == 5);
+
+    // Labelled series of one family
+    registry.counter("msgs_total", "Messages", "type=\"PUT\"").inc(3);
+    registry.counter("msgs_total", "Messages", "type=\"GET\"").inc(5);
+
+    // Histogram buckets are cumulative upper bounds
+    MetricHistogram& lat = registry.histogram("latency_seconds", "Latency");
+    lat.observe_us(5); // <= 10us
+    lat.observe_us(15); // <= 20us
+    lat.observe_us(100000000); // beyond the last bound
+    assert(lat.count() == 3);
+    assert(lat.bucket(0) == 1 && lat.bucket(1) == 1);
+    assert(lat.bucket(MetricHistogram::BUCKETS) == 1);
+
+    std::ostringstream oss;
+    registry.write_prometheus(oss);
+    std::string text = oss.str();
+    assert(contains(text, "# TYPE ops_total counter\nops_total 40000\n"));
+    assert(contains(text, "# TYPE queue_depth gauge\nqueue_depth 5\n"));
+    assert(contains(text, "msgs_total{type=\"PUT\"} 3\nmsgs_total{type=\"GET\"} 5\n"));
+    assert(text.find("# TYPE msgs_total") == text.rfind("# TYPE msgs_total"));
+    assert(contains(text, "latency_seconds_bucket{le=\"1e-05\"} 1\n"));
+    assert(contains(text, "latency_seconds_bucket{le=\"2e-05\"} 2\n"));
+    assert(contains(text, "latency_seconds_bucket{le=\"+Inf\"} 3\n"));
+    assert(contains(text, "latency_seconds_count 3\n"));
+
+    replica_counts_received();
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * File: test_near_cache.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Client near cache tests
+*/
+#include <cassert>
+#include <string>
+#include "../src/near_cache.hpp"
+
+int main()
+{
+    NearCache cache(2, 1000);
+    std::string value;
+    uint64_t version = 0;
+
+    // Fresh until the shorter of ttl and lease runs out
+    assert(!cache.get("a", 0, value, version));
+    cache.fill("a", "1", 1, 5000, 0);
+    assert(cache.get("a", 999, value, version) && value == "1" && version == 1);
+    assert(!cache.get("a", 1000, value, version));
+    cache.fill("a", "1", 1, 200, 1000);
+    assert(cache.get("a", 1100, value, version) && !cache.get("a", 1200, value, version));
+
+    // An invalidation for a newer version drops the entry; one for the
+    // cached version (the fill overtook it) does not
+    cache.fill("a", "2", 2, 5000, 2000);
+    cache.invalidate("a", 2);
+    assert(cache.get("a", 2000, value, version) && value == "2");
+    cache.invalidate("a", 3);
+    assert(!cache.get("a", 2000, value, version));
+
+    // A reply older than an invalidation already seen is not cached, even
+    // when the key was never cached before
+    cache.fill("a", "2", 2, 5000, 2000);
+    assert(!cache.get("a", 2000, value, version));
+    cache.invalidate("b", 4);
+    cache.fill("b", "old", 3, 5000, 2000);
+    assert(!cache.get("b", 2000, value, version));
+    cache.fill("b", "new", 4, 5000, 2000);
+    assert(cache.get("b", 2000, value, version) && value == "new");
+
+    // Own write (version unknown): the cached version is no longer accepted
+    cache.invalidate("b", 0);
+    cache.fill("b", "new", 4, 5000, 2000);
+    assert(!cache.get("b", 2000, value, version));
+    cache.fill("b", "mine", 5, 5000, 2000);
+    assert(cache.get("b", 2000, value, version) && value == "mine");
+
+    // Least recently used keys are evicted past capacity
+    cache.fill("c", "1", 1, 5000, 2000);
+    assert(cache.size() == 2);
+    assert(!cache.get("a", 2000, value, version));
+    assert(cache.get("b", 2000, value, version) && cache.get("c", 2000, value, version));
+
+    NearCache::Stats stats = cache.stats();
+    assert(stats.hits == 7 && stats.invalidations == 2);
+    return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * File: test_network.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Loopback tests for the listeners and transports
+*/
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../src/network.hpp"
+#include "../src/uring.hpp"
+
+static Message numbered(int i, size_t value_bytes)
+{
+    Message msg;
+    msg.type = MessageType::PUT_REQUEST;
+    msg.client_id = "t";
+    msg.op_id = "t:" + std::to_string(i);
+    msg.key = "k" + std::to_string(i);
+    msg.value = std::string(value_bytes, 'a' + i % 26);
+    return msg;
+}
+
+// Messages from several senders all arrive, each sender's in order;
+// where is the config address, "<host> <port>" or "unix:<path>"
+static void loopback(network::IoBackend backend, const std::string& where, int port)
+{
+    const char* path = "/tmp/kv_test_network_config.txt";
+    std::ofstream(path) << "t " << where << "\n";
+    std::vector<std::string> peers;
+    int listen_port;
+    network::set_io_backend(backend);
+    network::init("t", path, peers, listen_port);
+    std::remove(path);
+    assert(listen_port == port && peers.empty());
+    std::string addr = network::get_addr("t");
+
+    // Values past the 16 KiB receive buffers split frames across reads
+    const int per_sender = 500;
+    const int senders = 4;
+    std::vector<std::thread> threads;
+    for (int s = 0; s < senders; ++s)
+    {
+        threads.emplace_back([s, &addr]
+        {
+            for (int i = 0; i < per_sender; ++i)
+            {
+                Message msg = numbered(s * per_sender + i, i % 50 == 0 ? 40000 : 100);
+                bool sent = network::send_message(addr, msg);
+                assert(sent);
+            }
+        });
+    }
+    std::vector<int> next(senders, 0);
+    for (int n = 0; n < senders * per_sender; ++n)
+    {
+        Message in;
+        bool received = network::receive_message(in, /*timeout_ms=*/5000);
+        assert(received);
+        int id = std::stoi(in.op_id.substr(2));
+        int i = id % per_sender;
+        assert(i == next[id / per_sender]);
+        ++next[id / per_sender];
+        assert(in.value == numbered(id, i % 50 == 0 ? 40000 : 100).value);
+    }
+    for (auto& t : threads) t.join();
+    Message extra;
+    assert(!network::receive_message(extra, /*timeout_ms=*/50));
+    network::shutdown();
+}
+
+// A malformed frame is dropped and the listener keeps serving the frames
+// after it, on the same connection; values may hold '|' and '\n'
+static void malformed(int port)
+{
+    const char* path = "/tmp/kv_test_network_config.txt";
+    std::ofstream(path) << "t 127.0.0.1 " << port << "\n";
+    std::vector<std::string> peers;
+    int listen_port;
+    network::set_io_backend(network::IoBackend::EPOLL);
+    network::init("t", path, peers, listen_port);
+    std::remove(path);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &sa.sin_addr);
+    assert(connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0);
+    Message good = numbered(1, 10);
+    good.value = "a|b\nc";
+    std::string bytes = "garbage\n1|k\\q|v|x\n" + good.frame();
+    assert(write(fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size()));
+
+    Message in;
+    bool received = network::receive_message(in, /*timeout_ms=*/5000);
+    assert(received && in.op_id == good.op_id && in.value == good.value);
+    assert(!network::receive_message(in, /*timeout_ms=*/50));
+    close(fd);
+    network::shutdown();
+}
+
+// Sends inside a batch arrive intact and in order, in far fewer writes
+static void coalesced(int port)
+{
+    const char* path = "/tmp/kv_test_network_batch.txt";
+    std::ofstream(path) << "t 127.0.0.1 " << port << "\n";
+    std::vector<std::string> peers;
+    int listen_port;
+    network::set_io_backend(network::IoBackend::EPOLL);
+    network::init("t", path, peers, listen_port);
+    std::remove(path);
+    std::string addr = network::get_addr("t");
+
+    // Unreachable destinations still fail inside a batch, and frames held
+    // for others go out before the connect is tried
+    network::begin_batch();
+    bool queued = network::send_message(addr, numbered(0, 10));
+    assert(queued);
+    assert(!network::send_message("127.0.0.1:1", numbered(0, 10)));
+    Message early;
+    bool flushed = network::receive_message(early, /*timeout_ms=*/5000);
+    assert(flushed && early.op_id == "t:0");
+    network::end_batch();
+
+    const int count = 200;
+    network::SendStats before = network::send_stats();
+    network::begin_batch();
+    network::begin_batch(); // nested: only the outer end_batch flushes
+    for (int i = 0; i < count; ++i)
+    {
+        bool sent = network::send_message(addr, numbered(i, i == 100 ? 40000 : 100));
+        assert(sent);
+    }
+    network::end_batch();
+    network::end_batch();
+    network::SendStats after = network::send_stats();
+    assert(after.frames - before.frames == count);
+    // Bounded by the 64 KiB / 200 us limits, never one write per frame
+    assert(after.writes - before.writes < count / 10);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Message in;
+        bool received = network::receive_message(in, /*timeout_ms=*/5000);
+        assert(received);
+        assert(in.op_id == "t:" + std::to_string(i));
+        assert(in.value == numbered(i, i == 100 ? 40000 : 100).value);
+    }
+    network::shutdown();
+}
+
+// A child process echoes every message back to its sender. The child's
+// entry is marked "shm", so once it attaches the segment the parent offers,
+// both directions leave TCP. Echoes come back in order, through full rings
+// and frames larger than a ring.
+static void shared_memory(int port)
+{
+    const char* path = "/tmp/kv_test_network_shm.txt";
+    std::ofstream(path) << "echo 127.0.0.1 " << port << " shm\n"
+                        << "t 127.0.0.1 " << port + 1 << "\n";
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0)
+    {
+        std::vector<std::string> peers;
+        int listen_port;
+        network::set_io_backend(network::IoBackend::EPOLL);
+        network::init("echo", path, peers, listen_port);
+        Message in;
+        while (network::receive_message(in, /*timeout_ms=*/5000) && in.key != "bye")
+        {
+            network::send_message(network::get_addr(in.client_id), in);
+        }
+        network::shutdown();
+        _exit(0);
+    }
+    std::vector<std::string> peers;
+    int listen_port;
+    network::set_io_backend(network::IoBackend::EPOLL);
+    network::init("t", path, peers, listen_port);
+    std::string echo = network::get_addr("echo");
+    assert(network::shm_channels() == 0);
+
+    // The first send connects (retried until the child listens) and
+    // carries the offer; everything after it goes through the rings
+    auto value_bytes = [](int i) -> size_t
+    {
+        if (i == 1000) return 3 << 20; // more than a ring holds
+        return (i % 100 == 0 ? 40000 : 100);
+    };
+    int sent = 0;
+    while (!network::send_message(echo, numbered(sent, value_bytes(sent)))) usleep(10000);
+    ++sent;
+    for (; sent < 2000; ++sent)
+    {
+        bool ok = network::send_message(echo, numbered(sent, value_bytes(sent)));
+        assert(ok);
+    }
+    for (int i = 0; i < sent; ++i)
+    {
+        Message in;
+        bool received = network::receive_message(in, /*timeout_ms=*/5000);
+        assert(received);
+        assert(in.op_id == "t:" + std::to_string(i));
+        assert(in.value == numbered(i, value_bytes(i)).value);
+    }
+    assert(network::shm_channels() >= 1);
+
+    Message bye = numbered(sent, 10);
+    bye.key = "bye";
+    bool sent_bye = network::send_message(echo, bye);
+    assert(sent_bye);
+    int status = 0;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    network::shutdown();
+    std::remove(path);
+    assert(network::shm_channels() == 0);
+}
+
+int main()
+{
+    assert(std::string(network::io_backend_name(network::IoBackend::IO_URING)) == "io_uring");
+    network::IoBackend parsed;
+    assert(network::parse_io_backend("epoll", parsed) && parsed == network::IoBackend::EPOLL);
+    assert(!network::parse_io_backend("poll", parsed));
+
+    loopback(network::IoBackend::EPOLL, "127.0.0.1 5096", 5096);
+    assert(network::io_backend() == network::IoBackend::EPOLL);
+
+    // Host names are resolved once, at init
+    loopback(network::IoBackend::EPOLL, "localhost 5095", 5095);
+
+    // Unix domain sockets; the socket file goes away on shutdown
+    const std::string sock = "/tmp/kv_test_network.sock";
+    loopback(network::IoBackend::EPOLL, "unix:" + sock, 0);
+    assert(access(sock.c_str(), F_OK) != 0);
+
+    // io_uring when the kernel has it; the fallback otherwise
+    IoUring probe;
+    bool have_uring = probe.init(8) && probe.supports(IORING_OP_SEND_ZC);
+    loopback(network::IoBackend::IO_URING, "127.0.0.1 5097", 5097);
+    assert(network::io_backend() == (have_uring ? network::IoBackend::IO_URING : network::IoBackend::EPOLL));
+    loopback(network::IoBackend::IO_URING, "unix:" + sock, 0);
+
+    malformed(5092);
+    coalesced(5093);
+    shared_memory(5094);
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * File: test_session_table.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Client request deduplication tests
+*/
+#include <cassert>
+#include "../src/session_table.hpp"
+
+int main()
+{
+    SessionTable sessions;
+
+    // Unknown client and sequence numbers are fresh
+    assert(sessions.check("client1", 1) == SessionStatus::FRESH);
+
+    // In flight under a replica op_id until committed
+    sessions.start("client1", 1, "A:100");
+    assert(sessions.check("client1", 1) == SessionStatus::IN_FLIGHT);
+    assert(sessions.inflight_op("client1", 1) == "A:100");
+    assert(sessions.check("client2", 1) == SessionStatus::FRESH);
+
+    // Completed requests are answered from the cached result
+    OpResult r;
+    r.found = r.ok = true;
+    r.key = "x";
+    r.value = "42";
+    r.version = 3;
+    sessions.complete("client1", 1, r);
+    assert(sessions.check("client1", 1) == SessionStatus::COMPLETED);
+    assert(sessions.result("client1", 1).value == "42");
+    assert(sessions.result("client1", 1).version == 3);
+
+    // A late multicast of a completed request does not reopen it
+    sessions.start("client1", 1, "B:200");
+    assert(sessions.check("client1", 1) == SessionStatus::COMPLETED);
+
+    // Pipelined requests may complete out of order
+    sessions.start("client1", 3, "A:300");
+    sessions.start("client1", 2, "A:301");
+    sessions.complete("client1", 3, r);
+    assert(sessions.check("client1", 2) == SessionStatus::IN_FLIGHT);
+    assert(sessions.check("client1", 3) == SessionStatus::COMPLETED);
+
+    // Only the newest WINDOW results are retained; older retries are stale
+    for (uint64_t seq = 10; seq < 10 + SessionTable::WINDOW; ++seq)
+    {
+        sessions.complete("client3", seq, r);
+    }
+    assert(sessions.check("client3", 10) == SessionStatus::COMPLETED);
+    sessions.complete("client3", 10 + SessionTable::WINDOW, r);
+    assert(sessions.check("client3", 10) == SessionStatus::STALE);
+    assert(sessions.check("client3", 11) == SessionStatus::COMPLETED);
+    assert(sessions.check("client3", 20 + SessionTable::WINDOW) == SessionStatus::FRESH);
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * File: test_shard_runtime.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Sharded replica runtime tests
+*/
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../src/shard_runtime.hpp"
+
+// In-memory links between two runtimes ("A", "B") and a client ("c"). Shard
+// threads send from anywhere; pump() delivers on the calling thread, which
+// is then the single producer both runtimes require.
+class TestNet : public Transport
+{
+public:
+    bool send_message(const std::string& dest_addr, const Message& msg) override
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.emplace_back(dest_addr, msg);
+        cv_.notify_all();
+        return true;
+    }
+
+    std::string get_addr(const std::string& node_id) override { return node_id; }
+
+    // Deliver until done() holds (checked on the client inbox) or timeout
+    bool pump(ShardRuntime& a, ShardRuntime& b, const std::function<bool(const std::vector<Message>&)>& done)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!done(client_))
+        {
+            if (!cv_.wait_until(lock, deadline, [this] { return !queue_.empty(); })) return false;
+            auto [dest, msg] = std::move(queue_.front());
+            queue_.pop_front();
+            if (dest == "c")
+            {
+                client_.push_back(std::move(msg));
+                continue;
+            }
+            lock.unlock();
+            (dest == "A" ? a : b).route(std::move(msg));
+            lock.lock();
+        }
+        return true;
+    }
+
+    std::vector<Message> take_client()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::vector<Message> out;
+        out.swap(client_);
+        return out;
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<std::pair<std::string, Message>> queue_;
+    std::vector<Message> client_;
+};
+
+static Message request(MessageType type, const std::string& op_id)
+{
+    Message msg;
+    msg.type = type;
+    msg.client_id = "c";
+    msg.op_id = op_id;
+    return msg;
+}
+
+static bool has_reply(const std::vector<Message>& inbox, const std::string& op_id)
+{
+    for (const auto& m : inbox)
+    {
+        if (m.op_id == op_id) return true;
+    }
+    return false;
+}
+
+int main()
+{
+    // Key placement is stable and spreads keys; op ids carry their shard
+    assert(ShardRuntime::key_shard("user42", 4) == ShardRuntime::key_shard("user42", 4));
+    assert(ShardRuntime::key_shard("anything", 1) == 0);
+    assert(Replica::op_shard("A:3:1234") == 3);
+    assert(Replica::op_shard("A:1234") == 0);
+
+    const int shards = 4;
+    std::vector<std::string> keys;
+    std::vector<bool> used(shards, false);
+    for (int i = 0; keys.size() < 8; ++i)
+    {
+        keys.push_back("k" + std::to_string(i));
+        used[ShardRuntime::key_shard(keys.back(), shards)] = true;
+    }
+    assert(std::count(used.begin(), used.end(), true) >= 2);
+
+    TestNet net;
+    MetricsRegistry registry_a, registry_b;
+    ShardRuntime::Options options;
+    options.shards = shards;
+    options.pin_threads = false;
+    ShardRuntime a("A", {"B"}, net, registry_a, Replica::Options(), options);
+    ShardRuntime b("B", {"A"}, net, registry_b, Replica::Options(), options);
+    a.start();
+    b.start();
+
+    // Single-key write: coordinated by the key's shard, replicated to B
+    Message put = request(MessageType::PUT_REQUEST, "c:1");
+    put.key = "k0";
+    put.value = "v0";
+    put.seq = 1;
+    net.send_message("A", put);
+    assert(net.pump(a, b, [](const auto& inbox) { return has_reply(inbox, "c:1"); }));
+    std::vector<Message> inbox = net.take_client();
+    assert(inbox.size() == 1 && inbox[0].type == MessageType::COMMIT && inbox[0].value == "v0");
+
+    // Multi-key write across shards: refused whole, since per-shard commits
+    // would not be atomic
+    Message mput = request(MessageType::MULTI_PUT_REQUEST, "c:2");
+    mput.seq = 2;
+    for (const auto& k : keys) mput.entries.emplace_back(k, "val-" + k);
+    net.send_message("A", mput);
+    assert(net.pump(a, b, [](const auto& inbox) { return has_reply(inbox, "c:2"); }));
+    inbox = net.take_client();
+    assert(inbox.size() == 1);
+    assert(inbox[0].type == MessageType::COMMIT && !inbox[0].ok && inbox[0].error == "cross_shard");
+    for (int s = 0; s < shards; ++s) assert(a.replica(s).store().get(keys[1]).empty());
+
+    // One MULTI_PUT per shard commits
+    uint64_t commit_ts = 0;
+    Message first_mput;
+    for (int s = 0; s < shards; ++s)
+    {
+        Message part = request(MessageType::MULTI_PUT_REQUEST, "c:2." + std::to_string(s));
+        part.seq = 3 + s;
+        for (const auto& k : keys)
+        {
+            if (ShardRuntime::key_shard(k, shards) == s) part.entries.emplace_back(k, "val-" + k);
+        }
+        if (part.entries.empty()) continue;
+        if (first_mput.entries.empty()) first_mput = part;
+        net.send_message("A", part);
+        std::string op = part.op_id;
+        assert(net.pump(a, b, [&op](const auto& inbox) { return has_reply(inbox, op); }));
+        inbox = net.take_client();
+        assert(inbox.size() == 1 && inbox[0].type == MessageType::COMMIT && inbox[0].ok && inbox[0].error.empty());
+        assert(inbox[0].key == part.entries[0].first && inbox[0].value == part.entries[0].second);
+        commit_ts = std::max(commit_ts, inbox[0].timestamp);
+    }
+    assert(commit_ts != 0);
+
+    // Multi-key read from the follower, at least at that commit: entries
+    // come back combined and in request order
+    Message mget = request(MessageType::MULTI_GET_REQUEST, "c:3");
+    mget.timestamp = commit_ts;
+    for (auto it = keys.rbegin(); it != keys.rend(); ++it) mget.entries.emplace_back(*it, "");
+    mget.entries.emplace_back("missing", "");
+    bool read_ok = false;
+    for (int attempt = 0; attempt < 100 && !read_ok; ++attempt)
+    {
+        mget.op_id = "c:3." + std::to_string(attempt);
+        net.send_message("B", mget);
+        std::string op = mget.op_id;
+        assert(net.pump(a, b, [&op](const auto& inbox) { return has_reply(inbox, op); }));
+        inbox = net.take_client();
+        assert(inbox.size() == 1 && inbox[0].type == MessageType::MULTI_GET_RESPONSE);
+        read_ok = inbox[0].ok;
+    }
+    assert(read_ok);
+    assert(inbox[0].entries.size() == keys.size() + 1);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        assert(inbox[0].entries[i].first == keys[keys.size() - 1 - i]);
+        assert(inbox[0].entries[i].second == "val-" + inbox[0].entries[i].first);
+    }
+    assert(inbox[0].entries.back().first == "missing" && inbox[0].entries.back().second.empty());
+
+    // A retried multi-key write is answered from the shard's session
+    net.send_message("B", first_mput);
+    std::string retried = first_mput.op_id;
+    assert(net.pump(a, b, [&retried](const auto& inbox) { return has_reply(inbox, retried); }));
+    inbox = net.take_client();
+    assert(inbox.size() == 1 && inbox[0].ok && inbox[0].value == first_mput.entries[0].second);
+
+    a.stop();
+    b.stop();
+
+    // Each key lives only in its own shard, on both nodes
+    for (const auto& k : keys)
+    {
+        int owner = ShardRuntime::key_shard(k, shards);
+        for (int s = 0; s < shards; ++s)
+        {
+            assert((a.replica(s).store().get(k) == "val-" + k) == (s == owner));
+            assert(b.replica(s).store().get(k) == a.replica(s).store().get(k));
+        }
+    }
+
+    // Admission control: past the client queue limit new requests get BUSY
+    // at once, requests that queued too long get BUSY when dequeued, and
+    // replication traffic is never refused
+    ShardRuntime::Options limited;
+    limited.pin_threads = false;
+    limited.client_queue_limit = 2;
+    MetricsRegistry registry_c;
+    ShardRuntime c("C", {}, net, registry_c, Replica::Options(), limited);
+    uint64_t stale_ns = PhaseTracer::now_ns() - 1000000000ULL;
+    for (int i = 0; i < 4; ++i)
+    {
+        Message get = request(MessageType::GET_REQUEST, "c:busy" + std::to_string(i));
+        get.key = "k0";
+        get.received_ns = stale_ns;
+        c.route(std::move(get));
+    }
+    Message commit = request(MessageType::COMMIT, "B:1");
+    c.route(std::move(commit));
+    assert(c.queue_depth() == 3 && c.rejected() == 2);
+    c.start();
+    assert(net.pump(a, b, [](const auto& inbox) { return inbox.size() == 4; }));
+    inbox = net.take_client();
+    for (const auto& m : inbox) assert(m.type == MessageType::BUSY && m.op_id.rfind("c:busy", 0) == 0);
+    assert(c.rejected() == 4);
+    Message fresh = request(MessageType::GET_REQUEST, "c:fresh");
+    fresh.key = "k0";
+    fresh.received_ns = PhaseTracer::now_ns();
+    c.route(std::move(fresh));
+    assert(net.pump(a, b, [](const auto& inbox) { return has_reply(inbox, "c:fresh"); }));
+    inbox = net.take_client();
+    assert(inbox.size() == 1 && inbox[0].type == MessageType::GET_RESPONSE);
+    c.stop();
+
+    // Reads go to the reader lane: a GET and a single-shard MGET queue there
+    // (counted once each) and the readers answer them
+    ShardRuntime::Options lanes;
+    lanes.pin_threads = false;
+    lanes.shards = shards;
+    lanes.readers = 2;
+    MetricsRegistry registry_d;
+    ShardRuntime d("D", {}, net, registry_d, Replica::Options(), lanes);
+    assert(d.readers() == 2);
+    Message lane_get = request(MessageType::GET_REQUEST, "c:lane1");
+    lane_get.key = "k0";
+    d.route(std::move(lane_get));
+    Message lane_mget = request(MessageType::MULTI_GET_REQUEST, "c:lane2");
+    lane_mget.entries.emplace_back("k0", "");
+    d.route(std::move(lane_mget));
+    assert(d.queue_depth() == 2);
+    d.start();
+    assert(net.pump(a, b, [](const auto& inbox) { return inbox.size() == 2; }));
+    inbox = net.take_client();
+    assert(inbox.size() == 2);
+    for (const auto& m : inbox) assert(m.ok && (m.type == MessageType::GET_RESPONSE || m.entries.size() == 1));
+    d.stop();
+
+    // Watch requests queue on a lane (a reader, else shard 0) instead of
+    // running their catch-up scan on the routing thread, and are answered there
+    for (int readers : {1, 0})
+    {
+        MetricsRegistry registry_w;
+        WatchHub hub(net, registry_w, WatchHub::Options());
+        Replica::Options with_hub;
+        with_hub.watches = &hub;
+        ShardRuntime::Options watch_lanes;
+        watch_lanes.pin_threads = false;
+        watch_lanes.shards = shards;
+        watch_lanes.readers = readers;
+        ShardRuntime w("W", {}, net, registry_w, with_hub, watch_lanes);
+        for (int i = 0; i < w.shards(); ++i) hub.add_store(w.replica(i).store());
+        Message watch = request(MessageType::WATCH_REQUEST, "c:watch" + std::to_string(readers));
+        watch.key = "k";
+        watch.value = "prefix";
+        w.route(std::move(watch));
+        assert(w.queue_depth() == 1 && hub.watches() == 0);
+        w.start();
+        assert(net.pump(a, b, [](const auto& inbox) { return inbox.size() == 1; }));
+        inbox = net.take_client();
+        assert(inbox[0].type == MessageType::WATCH_RESPONSE && inbox[0].ok);
+        assert(hub.watches() == 1);
+        w.stop();
+    }
+    return 0;
+}
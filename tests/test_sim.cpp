@@ -0,0 +1,297 @@
+/*
+ * File: test_sim.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Deterministic cluster simulator tests
+*/
+#include <cassert>
+#include <string>
+#include <vector>
+#include "../src/sim.hpp"
+
+static SimCluster::Options cluster_options(uint64_t seed, int clients)
+{
+    SimCluster::Options options;
+    options.seed = seed;
+    options.clients = clients;
+    options.link.latency_us = 200;
+    options.link.jitter_us = 300;
+    options.client.timeout_us = 20000;
+    options.client.key_space = 20;
+    return options;
+}
+
+static SimNetwork::LinkModel options_link_drop(double drop_rate)
+{
+    SimNetwork::LinkModel link = cluster_options(0, 0).link;
+    link.drop_rate = drop_rate;
+    return link;
+}
+
+int main()
+{
+    // Links deliver in FIFO order despite jitter, and only when run
+    {
+        SimNetwork::LinkModel model;
+        model.latency_us = 100;
+        model.jitter_us = 1000;
+        SimNetwork net(42, model);
+        std::vector<std::string> got;
+        Transport& a = net.add_node("a", [](Message) {});
+        net.add_node("b", [&got](Message msg) { got.push_back(msg.key); });
+        assert(a.get_addr("b") == "b" && a.get_addr("zz").empty());
+        for (int i = 0; i < 50; ++i)
+        {
+            Message msg;
+            msg.type = MessageType::PUT_REQUEST;
+            msg.key = std::to_string(i);
+            assert(a.send_message("b", msg));
+        }
+        assert(got.empty());
+        net.run();
+        assert(got.size() == 50);
+        for (int i = 0; i < 50; ++i)
+        {
+            assert(got[i] == std::to_string(i));
+        }
+        assert(net.now_us() >= 100 && net.now_us() <= 1100);
+
+        // Crashed nodes refuse; partitions and loss drop silently
+        net.crash("b");
+        assert(!a.send_message("b", Message()));
+        net.recover("b");
+        net.partition({"a"}, {"b"});
+        assert(a.send_message("b", Message()));
+        net.run();
+        assert(got.size() == 50 && net.stats().dropped == 1 && net.stats().refused == 1);
+        net.heal();
+        net.set_link("a", "b", SimNetwork::LinkModel{100, 0, 1.0});
+        assert(a.send_message("b", Message()));
+        net.run();
+        assert(got.size() == 50 && net.stats().dropped == 2);
+    }
+
+    // Virtual time drives the clock replicas stamp writes with
+    {
+        SimNetwork net(1);
+        uint64_t seen = 0;
+        net.schedule(5000, [&seen] { seen = SimNetwork::virtual_ms(); });
+        net.run();
+        assert(seen == SimNetwork::EPOCH_MS + 5);
+    }
+
+    // One client: every request completes and the replicas converge
+    {
+        SimCluster cluster(cluster_options(3, 1));
+        cluster.start(300);
+        cluster.run();
+        assert(cluster.clients_done() && cluster.completed() == 300);
+        assert(cluster.retries() == 0);
+        assert(cluster.consistent());
+        assert(cluster.replica(0).store().size() > 0);
+    }
+
+    // A replica crashing mid-run: the client fails over, retried writes are
+    // taken over by the survivors, and they converge
+    {
+        SimCluster cluster(cluster_options(5, 1));
+        SimNetwork& net = cluster.network();
+        net.schedule(20000, [&net] { net.crash("r1"); });
+        cluster.start(300);
+        cluster.run();
+        assert(cluster.clients_done() && cluster.completed() == 300);
+        assert(net.crashed("r1"));
+        assert(cluster.consistent());
+    }
+
+    // Isolating a replica stalls nothing once the client times out on it
+    {
+        SimCluster cluster(cluster_options(9, 1));
+        SimNetwork& net = cluster.network();
+        net.schedule(10000, [&net] { net.partition({"r3"}, {"r1", "r2", "c1"}); });
+        net.schedule(200000, [&net] { net.heal(); });
+        cluster.start(300);
+        cluster.run();
+        assert(cluster.clients_done() && cluster.completed() == 300);
+        assert(cluster.replica(0).store().fingerprint() == cluster.replica(1).store().fingerprint());
+    }
+
+    // Closed timestamps: a replica that lost a COMMIT commits the op once
+    // the coordinator's CLOSED covers it, and one that missed a write during
+    // a partition declines bounded reads afterwards instead of serving them
+    // stale
+    {
+        SimCluster::Options options = cluster_options(13, 0);
+        options.link.jitter_us = 0;
+        SimCluster cluster(options);
+        SimNetwork& net = cluster.network();
+        std::vector<Message> replies;
+        Transport& x = net.add_node("x", [&replies](Message msg) { replies.push_back(std::move(msg)); });
+        Message put;
+        put.type = MessageType::PUT_REQUEST;
+        put.client_id = "x";
+        put.op_id = "x:1";
+        put.seq = 1;
+        put.key = "a";
+        put.value = "1";
+        // Multicast reaches r3 at 400us, the ACKs r1 at 600us, the COMMIT
+        // would reach r3 at 800us
+        x.send_message("r1", put);
+        net.schedule(700, [&net] { net.partition({"r3"}, {"r1", "r2", "x"}); });
+        net.schedule(20000, [&x, put]() mutable
+        {
+            put.op_id = "x:2";
+            put.seq = 2;
+            put.key = "b";
+            x.send_message("r1", put);
+        });
+        net.schedule(100000, [&net] { net.heal(); });
+        cluster.run();
+        assert(replies.size() == 2 && replies[0].ok && replies[1].ok);
+        const KVStore& r3 = cluster.replica(2).store();
+        assert(r3.pending_count() == 0 && r3.get("a") == "1" && r3.get("b").empty());
+
+        replies.clear();
+        Message get;
+        get.type = MessageType::GET_REQUEST;
+        get.client_id = "x";
+        get.key = "b";
+        get.max_staleness_ms = 50;
+        get.op_id = "x:get3";
+        x.send_message("r3", get);
+        get.op_id = "x:get1";
+        x.send_message("r1", get);
+        cluster.run();
+        assert(replies.size() == 2);
+        for (const auto& reply : replies)
+        {
+            assert(reply.type == MessageType::GET_RESPONSE);
+            if (reply.op_id == "x:get3") assert(!reply.ok);
+            else assert(reply.ok && reply.value == "1");
+        }
+    }
+
+    // Concurrent CAS through different coordinators: for every key, both
+    // clients race to create it and every replica picks the same winner
+    {
+        SimCluster cluster(cluster_options(12, 0));
+        SimNetwork& net = cluster.network();
+        int won = 0, lost = 0;
+        auto count = [&won, &lost](Message msg)
+        {
+            if (msg.type == MessageType::COMMIT) ++(msg.ok ? won : lost);
+        };
+        Transport& x = net.add_node("x", count);
+        Transport& y = net.add_node("y", count);
+        for (int i = 0; i < 100; ++i)
+        {
+            Message cas;
+            cas.type = MessageType::CAS_REQUEST;
+            cas.key = "k" + std::to_string(i);
+            cas.seq = i + 1;
+            cas.client_id = "x";
+            cas.op_id = "x:" + std::to_string(i);
+            cas.value = "x";
+            x.send_message("r1", cas);
+            cas.client_id = "y";
+            cas.op_id = "y:" + std::to_string(i);
+            cas.value = "y";
+            y.send_message("r2", cas);
+        }
+        cluster.run();
+        assert(won == 100 && lost == 100);
+        assert(cluster.consistent());
+
+        // INCR past INT64_MAX is refused, not wrapped
+        Message incr;
+        incr.type = MessageType::INCR_REQUEST;
+        incr.client_id = "x";
+        incr.op_id = "x:incr";
+        incr.seq = 1000;
+        incr.key = "n";
+        incr.value = "9223372036854775807";
+        x.send_message("r1", incr);
+        incr.op_id = "x:incr2";
+        incr.seq = 1001;
+        incr.value = "1";
+        x.send_message("r1", incr);
+        cluster.run();
+        assert(won == 101 && lost == 101);
+        assert(cluster.replica(2).store().get("n") == "9223372036854775807");
+
+        // A retry reaching the sequencer through another replica resends a
+        // multicast that was lost, instead of waiting for ACKs forever
+        SimNetwork::LinkModel cut = options_link_drop(1.0), fixed = options_link_drop(0.0);
+        net.set_link("r1", "r2", cut);
+        net.set_link("r1", "r3", cut);
+        Message put;
+        put.type = MessageType::PUT_REQUEST;
+        put.client_id = "x";
+        put.op_id = "x:put";
+        put.seq = 1002;
+        put.key = "p";
+        put.value = "1";
+        x.send_message("r1", put);
+        cluster.run();
+        assert(won == 101);
+        net.set_link("r1", "r2", fixed);
+        net.set_link("r1", "r3", fixed);
+        x.send_message("r2", put);
+        cluster.run();
+        assert(won == 102 && cluster.consistent());
+    }
+
+    // A retry older than the session window is refused, not dropped
+    {
+        SimCluster cluster(cluster_options(14, 0));
+        SimNetwork& net = cluster.network();
+        std::vector<Message> replies;
+        Transport& z = net.add_node("z", [&replies](Message msg) { replies.push_back(std::move(msg)); });
+        Message put;
+        put.type = MessageType::PUT_REQUEST;
+        put.client_id = "z";
+        put.key = "k";
+        for (uint64_t seq = 1; seq <= SessionTable::WINDOW + 1; ++seq)
+        {
+            put.seq = seq;
+            put.op_id = "z:" + std::to_string(seq);
+            z.send_message("r1", put);
+        }
+        cluster.run();
+        assert(replies.size() == SessionTable::WINDOW + 1);
+        replies.clear();
+        put.seq = 1;
+        put.op_id = "z:1";
+        z.send_message("r2", put);
+        cluster.run();
+        assert(replies.size() == 1 && replies[0].op_id == "z:1");
+        assert(!replies[0].ok && replies[0].error == "stale_retry");
+    }
+
+    // The same seed replays the same execution, many clients included
+    {
+        uint64_t end_us[2], fingerprint[2][3];
+        for (int run = 0; run < 2; ++run)
+        {
+            SimCluster::Options options = cluster_options(11, 6);
+            options.link.drop_rate = 0.01;
+            SimCluster cluster(options);
+            cluster.start(200);
+            cluster.run();
+            assert(cluster.clients_done());
+            end_us[run] = cluster.network().now_us();
+            for (int i = 0; i < 3; ++i)
+            {
+                fingerprint[run][i] = cluster.replica(i).store().fingerprint();
+            }
+        }
+        assert(end_us[0] == end_us[1]);
+        for (int i = 0; i < 3; ++i)
+        {
+            assert(fingerprint[0][i] == fingerprint[1][i]);
+        }
+    }
+
+    return 0;
+}
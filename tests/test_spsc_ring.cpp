@@ -0,0 +1,70 @@
+/*
+ * File: test_spsc_ring.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: SPSC ring tests
+*/
+#include <cassert>
+#include <string>
+#include <thread>
+#include "../src/spsc_ring.hpp"
+
+int main()
+{
+    // Capacity rounds up to a power of two; full and empty are reported
+    SpscRing<std::string> ring(5);
+    assert(ring.capacity() == 8 && ring.empty());
+    for (int i = 0; i < 8; ++i)
+    {
+        assert(ring.try_push(std::to_string(i)));
+    }
+    std::string extra = "x";
+    assert(!ring.try_push(std::move(extra)) && extra == "x");
+    assert(ring.size() == 8);
+    std::string out;
+    for (int i = 0; i < 8; ++i)
+    {
+        assert(ring.try_pop(out) && out == std::to_string(i));
+    }
+    assert(!ring.try_pop(out) && ring.empty());
+
+    // Wrap-around keeps FIFO order
+    for (int round = 0; round < 100; ++round)
+    {
+        assert(ring.try_push(std::to_string(round)));
+        assert(ring.try_push("b"));
+        assert(ring.try_pop(out) && out == std::to_string(round));
+        assert(ring.try_pop(out) && out == "b");
+    }
+
+    // One producer and one consumer thread: nothing lost, nothing reordered
+    SpscRing<uint64_t> numbers(64);
+    const uint64_t count = 1000000;
+    std::thread producer([&numbers]
+    {
+        for (uint64_t i = 1; i <= count;)
+        {
+            uint64_t v = i;
+            if (numbers.try_push(std::move(v))) ++i;
+            else std::this_thread::yield();
+        }
+    });
+    uint64_t expected = 1;
+    while (expected <= count)
+    {
+        uint64_t v;
+        if (numbers.try_pop(v))
+        {
+            assert(v == expected);
+            ++expected;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    assert(numbers.empty());
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * File: test_trace.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Per-phase tracing tests
+*/
+#include <cassert>
+#include <sstream>
+#include "../src/trace.hpp"
+
+int main()
+{
+    using Mark = PhaseTracer::Mark;
+    PhaseTracer tracer(/*chrome_events=*/true, /*sample_every=*/2);
+
+    // Stamps become phase durations (in microseconds) when the op finishes
+    uint64_t t = PhaseTracer::now_ns();
+    for (int i = 0; i < 4; ++i)
+    {
+        std::string op = "A:" + std::to_string(i);
+        tracer.mark(op, Mark::RECEIVED, t);
+        tracer.mark(op, Mark::DEQUEUED, t + 10000);
+        tracer.mark(op, Mark::SEQUENCED, t + 15000);
+        tracer.mark(op, Mark::MULTICAST, t + 20000);
+        tracer.mark(op, Mark::QUORUM, t + 120000);
+        tracer.mark(op, Mark::COMMITTED, t + 125000);
+        tracer.mark(op, Mark::REPLIED, t + 130000);
+        assert(tracer.stamp(op, Mark::QUORUM) == t + 120000);
+        tracer.finish(op);
+    }
+    assert(tracer.open_spans() == 0);
+    assert(tracer.histogram(Phase::QUEUE).count() == 4);
+    assert(tracer.histogram(Phase::QUEUE).max() == 10);
+    assert(tracer.histogram(Phase::QUORUM).percentile(50) == 100);
+    assert(tracer.histogram(Phase::TOTAL).max() == 130);
+
+    // Ops missing a milestone only record the phases they completed
+    tracer.mark("B:1", Mark::QUORUM, t);
+    tracer.mark("B:1", Mark::COMMITTED, t + 3000);
+    tracer.finish("B:1");
+    assert(tracer.histogram(Phase::COMMIT).count() == 5);
+    assert(tracer.histogram(Phase::TOTAL).count() == 4);
+
+    // Per-ACK phases are recorded directly
+    tracer.record(Phase::NETWORK_RTT, 250000);
+    assert(tracer.histogram(Phase::NETWORK_RTT).max() == 250);
+
+    // Discarded ops record nothing
+    tracer.mark("C:1", Mark::RECEIVED);
+    tracer.discard("C:1");
+    assert(tracer.open_spans() == 0);
+
+    // Spans older than the horizon expire unrecorded; newer ones stay
+    tracer.mark("D:1", Mark::RECEIVED, t);
+    tracer.mark("D:2", Mark::RECEIVED, t + 50000);
+    assert(tracer.expire(t + 1) == 1);
+    assert(tracer.open_spans() == 1);
+    assert(tracer.stamp("D:2", Mark::RECEIVED) == t + 50000);
+    tracer.discard("D:2");
+
+    std::ostringstream summary;
+    tracer.write_summary(summary);
+    assert(summary.str().find("quorum,4,") != std::string::npos);
+
+    // Every other op is sampled into the Chrome trace
+    std::ostringstream chrome;
+    tracer.write_chrome_trace(chrome, "node A");
+    std::string json = chrome.str();
+    assert(json.find("\"traceEvents\"") == 1);
+    assert(json.find("\"op\":\"A:0\"") != std::string::npos);
+    assert(json.find("\"op\":\"A:1\"") == std::string::npos);
+    assert(json.find("\"op\":\"A:2\"") != std::string::npos);
+
+    return 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * File: test_watch_hub.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: Key-change watch tests
+*/
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/replica.hpp"
+#include "../src/watch_hub.hpp"
+#include "recording_transport.hpp"
+
+static Message watch(const std::string& client, const std::string& key, bool prefix, uint64_t from = 0)
+{
+    Message msg;
+    msg.type = MessageType::WATCH_REQUEST;
+    msg.client_id = client;
+    msg.op_id = client + ":w";
+    msg.key = key;
+    msg.value = (prefix ? "prefix" : "");
+    msg.version = from;
+    return msg;
+}
+
+static void commit(KVStore& store, const std::string& op_id, const std::string& key, const std::string& value)
+{
+    Message op;
+    op.type = MessageType::MULTICAST_OP;
+    op.op_id = op_id;
+    op.key = key;
+    op.value = value;
+    store.apply(op);
+    store.commit(op_id);
+}
+
+// Registration catches up from the requested version; commits reach key
+// and prefix watchers once each
+static void catch_up_and_push()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub hub(net, registry, WatchHub::Options());
+    KVStore shard0, shard1;
+    hub.add_store(shard0);
+    hub.add_store(shard1);
+    commit(shard0, "1", "user:1", "a");
+    commit(shard0, "2", "user:1", "b");
+    commit(shard1, "3", "user:2", "c");
+    commit(shard1, "4", "item:1", "d");
+    assert(!hub.active());
+
+    // Key watch from version 1: only the newer value; from 2: nothing
+    hub.handle(watch("c1", "user:1", false, 1), 0);
+    assert((net.events("c1") == std::vector<std::string>{"user:1=b@2"}));
+    hub.handle(watch("c2", "user:1", false, 2), 0);
+    assert(net.events("c2").empty());
+    assert(net.sent.back().type == MessageType::WATCH_RESPONSE && net.sent.back().ok);
+
+    // Prefix watch: every matching key in every shard
+    hub.handle(watch("c3", "user:", true), 0);
+    std::vector<std::string> caught = net.events("c3");
+    assert(std::set<std::string>(caught.begin(), caught.end()) ==
+           (std::set<std::string>{"user:1=b@2", "user:2=c@1"}));
+    assert(hub.watches() == 3 && hub.active());
+
+    // Renewing an existing watch does not catch up again
+    net.clear();
+    hub.handle(watch("c3", "user:", true), 0);
+    assert(net.events("c3").empty() && hub.watches() == 3);
+
+    // c1 watches the key and the prefix too: one event per change
+    hub.handle(watch("c1", "us", true, 5), 0);
+    net.clear();
+    hub.committed("user:1", "e", 3, 77);
+    hub.committed("item:1", "f", 2, 78);
+    assert((net.events("c1") == std::vector<std::string>{"user:1=e@3"}));
+    assert((net.events("c2") == std::vector<std::string>{"user:1=e@3"}));
+    assert((net.events("c3") == std::vector<std::string>{"user:1=e@3"}));
+    assert(net.sent.size() == 3 && net.sent[0].timestamp == 77);
+
+    // Unwatch drops only that watch
+    Message un = watch("c1", "us", true);
+    un.type = MessageType::UNWATCH_REQUEST;
+    hub.handle(un, 0);
+    assert(hub.watches() == 3);
+}
+
+// Leases run out unless renewed; unreachable clients and a full table
+// lose or refuse watches
+static void leases_and_limits()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub::Options options;
+    options.lease_ms = 1000;
+    options.max_watches = 2;
+    WatchHub hub(net, registry, options);
+    hub.handle(watch("c1", "a", false), 0);
+    hub.handle(watch("c2", "b", true), 0);
+    hub.handle(watch("c3", "c", false), 0);
+    assert(!net.sent.back().ok && hub.watches() == 2);
+
+    hub.handle(watch("c1", "a", false), 800);
+    hub.tick(1200);
+    assert(hub.watches() == 1);
+    net.clear();
+    hub.committed("b1", "x", 1, 1);
+    assert(net.events("c2").empty());
+
+    net.down.insert("c1");
+    hub.committed("a", "x", 1, 1);
+    assert(hub.watches() == 0 && !hub.active());
+}
+
+static Message put(const std::string& op_id, const std::string& key)
+{
+    Message msg;
+    msg.type = MessageType::PUT_REQUEST;
+    msg.client_id = "writer";
+    msg.op_id = op_id;
+    msg.key = key;
+    msg.value = "v";
+    return msg;
+}
+
+// A write coordinated by replica, committed once B's ACK arrives
+static void replicate(Replica& replica, RecordingTransport& net, Message msg)
+{
+    replica.handle(std::move(msg));
+    Message ack;
+    ack.type = MessageType::ACK;
+    ack.op_id = net.sent.back().op_id;
+    ack.replica_id = "B";
+    replica.handle(ack);
+}
+
+// A replica tells the hub about every key its commits change
+static void replica_commits()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub hub(net, registry, WatchHub::Options());
+    Replica::Options options;
+    options.watches = &hub;
+    Replica replica("A", {"B"}, net, registry, options);
+    hub.add_store(replica.store());
+    hub.handle(watch("c", "k", true), 0);
+
+    replicate(replica, net, put("writer:1", "k1"));
+    Message mput = put("writer:2", "");
+    mput.type = MessageType::MULTI_PUT_REQUEST;
+    mput.entries = {{"k1", "w"}, {"other", "w"}, {"k2", "w"}};
+    replicate(replica, net, mput);
+    assert((net.events("c") == std::vector<std::string>{"k1=v@1", "k1=w@2", "k2=w@1"}));
+}
+
+// A leased GET is invalidated by the key's next commit only; leases expire
+// and are not granted past the limit
+static void cache_leases()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub::Options options;
+    options.cache_lease_ms = 500;
+    options.max_leases = 2;
+    WatchHub hub(net, registry, options);
+    Replica::Options replica_options;
+    replica_options.watches = &hub;
+    Replica replica("A", {"B"}, net, registry, replica_options);
+
+    Message get;
+    get.type = MessageType::GET_REQUEST;
+    get.client_id = "c";
+    get.op_id = "c:1";
+    get.key = "k1";
+    get.value = "lease";
+    replica.handle(get);
+    assert(net.sent.back().type == MessageType::GET_RESPONSE && net.sent.back().max_staleness_ms == 500);
+    get.value = "";
+    get.key = "k2";
+    replica.handle(get);
+    assert(net.sent.back().max_staleness_ms == 0 && hub.leases() == 1);
+
+    assert(hub.lease("d", "k1") == 500 && hub.lease("d", "k1") == 500);
+    assert(hub.lease("e", "k1") == 0 && hub.leases() == 2);
+
+    net.clear();
+    replicate(replica, net, put("writer:1", "k1"));
+    replicate(replica, net, put("writer:2", "k1"));
+    int invalidations = 0;
+    for (const auto& m : net.sent)
+    {
+        if (m.type != MessageType::CACHE_INVALIDATE) continue;
+        assert(m.key == "k1" && m.version == 1);
+        ++invalidations;
+    }
+    assert(invalidations == 2 && hub.leases() == 0);
+
+    hub.lease("c", "k2");
+    hub.tick(400);
+    assert(hub.leases() == 1);
+    hub.tick(600);
+    assert(hub.leases() == 0 && !hub.active());
+}
+
+static Message follower_op(const std::string& op_id, const std::string& key, const std::string& value)
+{
+    Message op;
+    op.type = MessageType::MULTICAST_OP;
+    op.op = MessageType::PUT_REQUEST;
+    op.op_id = op_id;
+    op.replica_id = "B";
+    op.client_id = "writer";
+    op.key = key;
+    op.value = value;
+    return op;
+}
+
+static Message commit_of(const std::string& op_id)
+{
+    Message commit;
+    commit.type = MessageType::COMMIT;
+    commit.op_id = op_id;
+    return commit;
+}
+
+// Two threads running a(i) and b(i) for i = 1..rounds, released together
+// each round so that they overlap; check(i) runs between rounds
+template <typename A, typename B, typename Check>
+static void race(int rounds, A a, B b, Check check)
+{
+    std::atomic<int> round{0}, done{0};
+    std::thread other([&]
+    {
+        for (int i = 1; i <= rounds; ++i)
+        {
+            while (round.load() < i) std::this_thread::yield();
+            b(i);
+            done.fetch_add(1);
+        }
+    });
+    for (int i = 1; i <= rounds; ++i)
+    {
+        round.store(i);
+        a(i);
+        while (done.load() < i) std::this_thread::yield();
+        check(i);
+    }
+    other.join();
+}
+
+// A first watch registered while a shard commits to its key: the catch-up
+// scan or the commit's event (or both) carries the new version, whichever
+// order the two threads run in
+static void watch_races_commit()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub hub(net, registry, WatchHub::Options());
+    Replica::Options options;
+    options.watches = &hub;
+    Replica replica("A", {"B"}, net, registry, options);
+    hub.add_store(replica.store());
+
+    replica.handle(follower_op("B:1", "k", "v1"));
+    race(5000,
+         [&](int i) { replica.handle(commit_of("B:" + std::to_string(i))); },
+         [&](int i) { hub.handle(watch("w" + std::to_string(i), "k", false), 0); },
+         [&](int i)
+         {
+             std::string client = "w" + std::to_string(i);
+             std::vector<std::string> seen = net.events(client);
+             assert(std::find(seen.begin(), seen.end(), "k=v" + std::to_string(i) + "@" + std::to_string(i)) !=
+                    seen.end());
+             Message unwatch = watch(client, "k", false);
+             unwatch.type = MessageType::UNWATCH_REQUEST;
+             hub.handle(unwatch, 0);
+             assert(!hub.active());
+             net.clear();
+             std::string next = std::to_string(i + 1);
+             replica.handle(follower_op("B:" + next, "k", "v" + next));
+         });
+}
+
+// A leased GET served while a shard commits to its key: the reply carries
+// the new version, or the client is sent a CACHE_INVALIDATE for it (or both),
+// whichever order the two threads run in
+static void lease_races_commit()
+{
+    RecordingTransport net;
+    MetricsRegistry registry;
+    WatchHub hub(net, registry, WatchHub::Options());
+    Replica::Options options;
+    options.watches = &hub;
+    Replica replica("A", {"B"}, net, registry, options);
+
+    replica.handle(follower_op("B:1", "k", "v1"));
+    race(5000,
+         [&](int i) { replica.handle(commit_of("B:" + std::to_string(i))); },
+         [&](int i)
+         {
+             Message get;
+             get.type = MessageType::GET_REQUEST;
+             get.client_id = "c" + std::to_string(i);
+             get.op_id = get.client_id + ":1";
+             get.key = "k";
+             get.value = "lease";
+             replica.handle_read(get);
+         },
+         [&](int i)
+         {
+             std::string client = "c" + std::to_string(i);
+             uint64_t read = 0;
+             bool invalidated = false;
+             for (size_t j = 0; j < net.sent.size(); ++j)
+             {
+                 const Message& m = net.sent[j];
+                 if (net.dests[j] != client) continue;
+                 if (m.type == MessageType::GET_RESPONSE && m.ok && m.max_staleness_ms > 0) read = m.version;
+                 if (m.type == MessageType::CACHE_INVALIDATE && m.version == static_cast<uint64_t>(i))
+                     invalidated = true;
+             }
+             assert(read > 0 && (read == static_cast<uint64_t>(i) || invalidated));
+             // The lease ran out before the next round
+             hub.tick(static_cast<uint64_t>(i) * 10000);
+             assert(!hub.active());
+             net.clear();
+             std::string next = std::to_string(i + 1);
+             replica.handle(follower_op("B:" + next, "k", "v" + next));
+         });
+}
+
+int main()
+{
+    assert(std::string(message_type_name(MessageType::WATCH_EVENT)) == "WATCH_EVENT");
+    catch_up_and_push();
+    leases_and_limits();
+    replica_commits();
+    cache_leases();
+    watch_races_commit();
+    lease_races_commit();
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * File: test_ycsb.cpp
+ * Creator: Yuesong Huang
+ * Email (NetID): yhu116@u.rochester.edu
+ * Date: 2025/4/30
+ * Contributor: kvbench workload generator tests
+*/
+#include <cassert>
+#include <random>
+#include <vector>
+#include "../src/ycsb.hpp"
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    // Every core workload is defined and its mix sums to 1
+    for (char name : std::string("ABCDEF"))
+    {
+        ycsb::Workload w;
+        assert(ycsb::workload(name, w));
+        double sum = w.read + w.update + w.insert + w.scan + w.rmw;
+        assert(sum > 0.999 && sum < 1.001);
+    }
+    ycsb::Workload w;
+    assert(!ycsb::workload('G', w));
+
+    // Operation mix follows the proportions (workload B: 95% reads)
+    ycsb::workload('B', w);
+    int reads = 0;
+    for (int i = 0; i < 10000; ++i) reads += (ycsb::choose_op(w, rng) == ycsb::OpKind::READ);
+    assert(reads > 9300 && reads < 9700);
+
+    // Zipfian ranks stay in range and are heavily skewed towards rank 0
+    ycsb::ZipfianGenerator zipf(1000);
+    std::vector<int> hits(1000);
+    for (int i = 0; i < 100000; ++i)
+    {
+        uint64_t r = zipf.next(rng);
+        assert(r < 1000);
+        ++hits[r];
+    }
+    assert(hits[0] > hits[1] && hits[1] > hits[10] && hits[10] > hits[500]);
+    assert(hits[0] > 100000 / 20);
+
+    // Key choosers stay within the loaded records
+    ycsb::KeyChooser uniform(ycsb::Distribution::UNIFORM, 100);
+    ycsb::KeyChooser scrambled(ycsb::Distribution::ZIPFIAN, 100);
+    for (int i = 0; i < 1000; ++i)
+    {
+        assert(uniform.next(rng) < 100);
+        assert(scrambled.next(rng) < 100);
+    }
+
+    // "latest" favours the most recent insert
+    ycsb::KeyChooser latest(ycsb::Distribution::LATEST, 100);
+    assert(latest.next_insert() == 100);
+    assert(latest.records() == 101);
+    int newest = 0;
+    for (int i = 0; i < 1000; ++i) newest += (latest.next(rng) == 100);
+    assert(newest > 100);
+
+    return 0;
+}